@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <new>
+
+#include "Bench.h"
+
+static size_t heapAllocations = 0;
+static size_t heapAllocatedBytes = 0;
+
+void *operator new(size_t size) {
+  void *ptr = malloc(size ? size : 1);
+
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  heapAllocations++;
+  heapAllocatedBytes += size;
+  return ptr;
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+  free(ptr);
+}
+
+size_t benchAllocations() {
+  return heapAllocations;
+}
+
+size_t benchAllocatedBytes() {
+  return heapAllocatedBytes;
+}
+
+struct bench_entry {
+  const char *name;
+  bench_fn fn;
+};
+
+static std::vector<bench_entry> &registry() {
+  static std::vector<bench_entry> entries;
+  return entries;
+}
+
+static std::vector<std::string> positionalArgs;
+
+const std::vector<std::string> &benchArgs() {
+  return positionalArgs;
+}
+
+BenchRegistration::BenchRegistration(const char *name, bench_fn fn) {
+  registry().push_back({name, fn});
+}
+
+void BenchState::start() {
+  _allocationsFrom = heapAllocations;
+  _allocatedBytesFrom = heapAllocatedBytes;
+  _from = std::chrono::steady_clock::now();
+  _running = true;
+}
+
+void BenchState::stop() {
+  _elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - _from).count();
+  _allocations += heapAllocations - _allocationsFrom;
+  _allocatedBytes += heapAllocatedBytes - _allocatedBytesFrom;
+  _running = false;
+}
+
+bool BenchState::keepRunning() {
+  if (!_started) {
+    _started = true;
+    start();
+  }
+  if (_done++ < _iterations) {
+    return true;
+  }
+  if (_running) {
+    stop();
+  }
+  return false;
+}
+
+void BenchState::pauseTiming() {
+  if (_running)
+    stop();
+}
+
+void BenchState::resumeTiming() {
+  if (!_running)
+    start();
+}
+
+static void report(const char *name, const BenchState &state) {
+  double perIteration = state.seconds() / state.iterations();
+  char rate[64] = "";
+
+  if (state.skipped()) {
+    printf("%-32s SKIPPED: %s\n", name, state.label().c_str());
+    return;
+  }
+
+  if (state.items()) {
+    snprintf(rate, sizeof(rate), "%10.3fM items/s", state.items() / state.seconds() / 1e6);
+  }
+  if (state.bytes()) {
+    snprintf(rate + strlen(rate), sizeof(rate) - strlen(rate), " %8.1f MB/s", state.bytes() / state.seconds() / 1e6);
+  }
+
+  printf("%-32s %10zu %12.0f ns %8.1f allocs %10.0f B/it %s", name, state.iterations(), perIteration * 1e9,
+         (double)state.allocations() / state.iterations(), (double)state.allocatedBytes() / state.iterations(), rate);
+  for (const auto &counter : state.counters()) {
+    printf(" %s=%.4g", counter.first.c_str(), counter.second);
+  }
+  if (!state.label().empty()) {
+    printf(" [%s]", state.label().c_str());
+  }
+  printf("\n");
+}
+
+int main(int argc, char **argv) {
+  const char *filter = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strncmp(argv[i], "--filter=", 9))
+      filter = argv[i] + 9;
+    else
+      positionalArgs.push_back(argv[i]);
+  }
+
+  printf("%-32s %10s %15s %15s %14s\n", "benchmark", "iterations", "time/it", "heap/it", "");
+
+  for (const bench_entry &entry : registry()) {
+    size_t iterations = 1;
+
+    if (filter && !strstr(entry.name, filter)) {
+      continue;
+    }
+
+    for (;;) {
+      BenchState state(iterations);
+
+      entry.fn(state);
+
+      if (state.skipped() || state.seconds() >= BENCH_MIN_TIME || iterations >= 1000000000) {
+        report(entry.name, state);
+        break;
+      }
+
+      double grow = state.seconds() > 0 ? BENCH_MIN_TIME * 1.4 / state.seconds() : 100;
+      iterations = (size_t)(iterations * std::min(std::max(grow, 2.0), 100.0));
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,93 @@
+/*
+  Bench.h - tiny benchmark runner in the manner of Google Benchmark
+
+    void BM_Something(BenchState &state) {
+      ...setup, not measured...
+      while (state.keepRunning()) {
+        ...measured...
+      }
+      state.setItemsProcessed(state.iterations() * itemsPerIteration);
+    }
+    BENCH(BM_Something);
+
+  Iteration count grows until a run takes BENCH_MIN_TIME. Heap allocations
+  (operator new) are counted only while timing runs.
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#define BENCH_MIN_TIME 0.2
+
+class BenchState {
+ public:
+  explicit BenchState(size_t iterations) : _iterations(iterations) {}
+
+  bool keepRunning();
+  void pauseTiming();
+  void resumeTiming();
+
+  size_t iterations() const { return _iterations; }
+  void setItemsProcessed(size_t items) { _items = items; }
+  void setBytesProcessed(size_t bytes) { _bytes = bytes; }
+  void setLabel(const std::string &label) { _label = label; }
+  // Extra value reported per iteration, like Google Benchmark user counters
+  void setCounter(const char *name, double value) { _counters.push_back(std::make_pair(std::string(name), value)); }
+  void skip(const std::string &reason) {
+    _skipped = true;
+    _label = reason;
+  }
+
+  double seconds() const { return _elapsed; }
+  size_t items() const { return _items; }
+  size_t bytes() const { return _bytes; }
+  size_t allocations() const { return _allocations; }
+  size_t allocatedBytes() const { return _allocatedBytes; }
+  const std::string &label() const { return _label; }
+  bool skipped() const { return _skipped; }
+  const std::vector<std::pair<std::string, double>> &counters() const { return _counters; }
+
+ protected:
+  void start();
+  void stop();
+
+  size_t _iterations;
+  size_t _done = 0;
+  bool _started = false;
+  bool _running = false;
+  bool _skipped = false;
+  std::chrono::steady_clock::time_point _from;
+  double _elapsed = 0;
+  size_t _items = 0;
+  size_t _bytes = 0;
+  size_t _allocations = 0;
+  size_t _allocatedBytes = 0;
+  size_t _allocationsFrom = 0;
+  size_t _allocatedBytesFrom = 0;
+  std::string _label;
+  std::vector<std::pair<std::string, double>> _counters;
+};
+
+typedef void (*bench_fn)(BenchState &state);
+
+struct BenchRegistration {
+  BenchRegistration(const char *name, bench_fn fn);
+};
+
+#define BENCH(fn) static BenchRegistration bench_registration_##fn(#fn, fn)
+
+// Positional command line arguments (options stripped), e.g. corpus paths
+const std::vector<std::string> &benchArgs();
+
+// Heap allocations made since program start
+size_t benchAllocations();
+size_t benchAllocatedBytes();
+
+#endif
@@ -0,0 +1,47 @@
+/*
+  Firmware.h - parts of src/main.cpp the benchmarks drive directly
+*/
+
+#ifndef BENCH_FIRMWARE_H
+#define BENCH_FIRMWARE_H
+
+#include <ESP8266WebServer.h>
+
+#include "DataManifest.h"
+#include "EventStream.h"
+#include "FileStream.h"
+#include "LogFormat.h"
+
+extern ESP8266WebServer server;
+extern event_record curSensors;
+extern time_t nowTime;
+extern time_t start;
+extern String currentFileName;
+extern long currentFileSize;
+extern uint32_t currentFileVerified;
+extern int sensorsCount;
+extern DataManifest dataManifest;
+extern bool fsUsageStale;
+extern EventStream events;
+extern FileStream downloads;
+
+void setup(void);
+void loop(void);
+void readSensors(void);
+void putSensorsIntoDataLog(void);
+void flushLogIntoFile(void);
+bool checkFile(String *fileName, uint32_t *verified);
+void dataFileCommit(void);
+void dataFileDiscard(void);
+void monthsLoad(void);
+
+// Boots firmware once on a fresh temporary file system with time synced
+void firmwareBoot();
+// Removes every file, firmware starts a new data file on the next flush
+void firmwareResetData();
+// Logs count readings ("t" each reading, relay event every 20th) flushing them on the way
+void firmwareLogRecords(int count);
+// Spins loop() for ms of the fake clock, due jobs run on the way
+void firmwareRun(unsigned long ms);
+
+#endif
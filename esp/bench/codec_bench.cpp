@@ -0,0 +1,289 @@
+/*
+  codec_bench.cpp - data file codecs over JSON log dumps
+
+  Reads dumps with [stamp,t0,..,"ev"] fragments as pulled from the controller
+  (stored-data/ by default, or files/dirs given on the command line) and
+  reports the size they take as JSON text, as fixed-width records (format v1)
+  and as delta compressed chunks (format v2), and throughput of the codecs.
+*/
+
+#include <ctype.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include "Bench.h"
+#include "LogCodec.h"
+#include "LogFormat.h"
+
+#define DEFAULT_CORPUS "../stored-data/txt0321"
+
+struct corpus_file {
+  std::string name;
+  size_t jsonSize;
+  uint8_t sensors;
+  std::vector<event_record> records;
+};
+
+static bool parseFile(const std::string &path, corpus_file *out) {
+  FILE *f = fopen(path.c_str(), "rb");
+  std::string text;
+  char buf[4096];
+  size_t len;
+  event_record record = {};
+  int temps = -1;
+
+  if (!f) {
+    return false;
+  }
+  while ((len = fread(buf, 1, sizeof(buf), f)) > 0) {
+    text.append(buf, len);
+  }
+  fclose(f);
+
+  out->name = path;
+  out->jsonSize = text.size();
+  out->sensors = 0;
+
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] != '[' || i + 1 >= text.size() || !(isdigit(text[i + 1]) || text[i + 1] == '-')) {
+      continue;
+    }
+
+    const char *p = text.c_str() + i + 1;
+    char *end;
+    int k = 0;
+
+    record.stamp = strtol(p, &end, 10);
+    record.event = 't';
+    p = end;
+
+    while (*p == ',' || *p == ' ') {
+      p++;
+      while (*p == ' ')
+        p++;
+      if (*p == '"') {
+        record.event = !strncmp(p, "\"on\"", 4) ? 'n' : !strncmp(p, "\"off\"", 5) ? 'f' : 'b';
+        p = strchr(p + 1, '"') + 1;
+      } else {
+        long t = strtol(p, &end, 10);
+
+        if (end == p)
+          break;
+        if (k < MAX_SENSORS_COUNT)
+          record.t[k++] = (int)t;
+        p = end;
+      }
+    }
+
+    if (temps < 0 && k > 0) {
+      temps = k;
+      out->sensors = k;
+    }
+    out->records.push_back(record);
+  }
+
+  return !out->records.empty();
+}
+
+static void collect(const std::string &path, std::vector<std::string> *files) {
+  struct stat st;
+
+  if (stat(path.c_str(), &st) != 0) {
+    return;
+  }
+  if (S_ISDIR(st.st_mode)) {
+    DIR *dir = opendir(path.c_str());
+    struct dirent *entry;
+
+    while (dir && (entry = readdir(dir))) {
+      if (entry->d_name[0] != '.') {
+        collect(path + "/" + entry->d_name, files);
+      }
+    }
+    if (dir)
+      closedir(dir);
+  } else if (st.st_size > 0) {
+    files->push_back(path);
+  }
+}
+
+// Encodes records into chunks the same way flushLogIntoFile() does, returns total size
+static size_t encodeChunks(const corpus_file &file, std::vector<uint8_t> *out) {
+  uint8_t chunk[LOG_CHUNK_MAX];
+  LogChunkEncoder encoder;
+
+  out->clear();
+  encoder.begin(chunk, LOG_CHUNK_MAX, file.sensors);
+
+  for (const event_record &record : file.records) {
+    if (!encoder.add(&record)) {
+      size_t len = encoder.finish();
+
+      out->insert(out->end(), chunk, chunk + len);
+      encoder.begin(chunk, LOG_CHUNK_MAX, file.sensors);
+      encoder.add(&record);
+    }
+  }
+  if (encoder.count()) {
+    size_t len = encoder.finish();
+
+    out->insert(out->end(), chunk, chunk + len);
+  }
+
+  return LOG_HEADER_SIZE + out->size();
+}
+
+static size_t decodeChunks(const std::vector<uint8_t> &data, uint8_t sensors, event_record *records) {
+  LogChunkDecoder decoder;
+  log_chunk_header header;
+  size_t pos = 0, count = 0;
+
+  while (pos + LOG_CHUNK_HEADER_SIZE <= data.size() && logChunkHeaderDecode(data.data() + pos, &header) &&
+         logChunkVerify(data.data() + pos, &header)) {
+    decoder.begin(&header, data.data() + pos + LOG_CHUNK_HEADER_SIZE, sensors);
+    while (decoder.next(records + count))
+      count++;
+    if (!decoder.done()) {
+      break;
+    }
+    pos += logChunkSize(&header);
+  }
+
+  return count;
+}
+
+static bool sameRecords(const event_record &a, const event_record &b, uint8_t sensors) {
+  if (a.stamp != b.stamp || a.event != b.event) {
+    return false;
+  }
+  for (uint8_t k = 0; a.event != 'b' && k < sensors; k++) {
+    if (a.t[k] != b.t[k])
+      return false;
+  }
+  return true;
+}
+
+static const std::vector<corpus_file> &corpus() {
+  static std::vector<corpus_file> files;
+  static bool loaded = false;
+  std::vector<std::string> paths;
+
+  if (loaded) {
+    return files;
+  }
+  loaded = true;
+
+  for (const std::string &arg : benchArgs()) {
+    collect(arg, &paths);
+  }
+  if (paths.empty()) {
+    collect(DEFAULT_CORPUS, &paths);
+  }
+
+  for (const std::string &path : paths) {
+    corpus_file file;
+
+    if (parseFile(path, &file)) {
+      files.push_back(file);
+    }
+  }
+  return files;
+}
+
+static size_t corpusRecords() {
+  size_t total = 0;
+
+  for (const corpus_file &file : corpus()) {
+    total += file.records.size();
+  }
+  return total;
+}
+
+void BM_CodecCorpusSize(BenchState &state) {
+  size_t json = 0, fixed = 0, chunked = 0;
+  std::vector<uint8_t> data;
+  std::vector<event_record> decoded(corpusRecords());
+
+  if (corpus().empty()) {
+    state.skip("no corpus found at " DEFAULT_CORPUS);
+    return;
+  }
+
+  for (const corpus_file &file : corpus()) {
+    size_t count;
+
+    json += file.jsonSize;
+    fixed += LOG_HEADER_SIZE + file.records.size() * logRecordSize(file.sensors);
+    chunked += encodeChunks(file, &data);
+    count = decodeChunks(data, file.sensors, decoded.data());
+
+    for (size_t i = 0; i < file.records.size(); i++) {
+      if (count != file.records.size() || !sameRecords(file.records[i], decoded[i], file.sensors)) {
+        state.skip("round trip mismatch in " + file.name);
+        return;
+      }
+    }
+  }
+
+  while (state.keepRunning()) {
+  }
+
+  state.setCounter("json_B", json);
+  state.setCounter("fixed_B", fixed);
+  state.setCounter("chunked_B", chunked);
+  state.setCounter("vs_json", (double)json / chunked);
+  state.setCounter("vs_fixed", (double)fixed / chunked);
+  state.setCounter("B/record", (double)chunked / corpusRecords());
+}
+BENCH(BM_CodecCorpusSize);
+
+void BM_ChunkEncode(BenchState &state) {
+  std::vector<std::vector<uint8_t>> encoded(corpus().size());
+  size_t bytes = 0;
+
+  if (corpus().empty()) {
+    state.skip("no corpus found at " DEFAULT_CORPUS);
+    return;
+  }
+
+  while (state.keepRunning()) {
+    for (size_t i = 0; i < corpus().size(); i++) {
+      bytes += encodeChunks(corpus()[i], &encoded[i]);
+    }
+  }
+
+  state.setItemsProcessed(state.iterations() * corpusRecords());
+  state.setBytesProcessed(bytes);
+}
+BENCH(BM_ChunkEncode);
+
+void BM_ChunkDecode(BenchState &state) {
+  std::vector<std::vector<uint8_t>> encoded(corpus().size());
+  std::vector<event_record> decoded(corpusRecords());
+  size_t bytes = 0, records = 0;
+
+  if (corpus().empty()) {
+    state.skip("no corpus found at " DEFAULT_CORPUS);
+    return;
+  }
+
+  for (size_t i = 0; i < corpus().size(); i++) {
+    bytes += encodeChunks(corpus()[i], &encoded[i]);
+  }
+
+  while (state.keepRunning()) {
+    for (size_t i = 0; i < corpus().size(); i++) {
+      records += decodeChunks(encoded[i], corpus()[i].sensors, decoded.data());
+    }
+  }
+
+  state.setItemsProcessed(records);
+  state.setBytesProcessed(state.iterations() * bytes);
+}
+BENCH(BM_ChunkDecode);
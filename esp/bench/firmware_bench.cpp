@@ -0,0 +1,818 @@
+/*
+  firmware_bench.cpp - hot paths of src/main.cpp running on the native HAL
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+
+#include "Bench.h"
+#include "Firmware.h"
+#include "LittleFS.h"
+#include "Metrics.h"
+#include "NativeHal.h"
+
+#define BENCH_SENSORS 4
+#define BENCH_DATA_FILES 30
+#define BENCH_FS_BYTES (3 * 1024 * 1024)  // data files with their archives stay below the low mark of retention
+
+static time_t loggedStamp = 0;
+
+void firmwareBoot() {
+  static bool booted = false;
+  static char root[] = "/tmp/esp-bench-XXXXXX";
+  std::vector<std::vector<int>> rows;
+
+  if (booted) {
+    return;
+  }
+  booted = true;
+
+  for (int i = 0; i < 64; i++) {  // slow heating/cooling wave, like stored-data readings
+    int wave = (i < 32 ? i : 64 - i) * 3;
+
+    rows.push_back({90 + wave, 100 + wave * 2, 80 + wave / 2, 78 + wave / 4});
+  }
+
+  hal::mountFs(mkdtemp(root), BENCH_FS_BYTES);
+  hal::scriptSensors(BENCH_SENSORS, rows);
+  setup();
+  hal::syncTime();
+  loggedStamp = start;
+}
+
+void firmwareResetData() {
+  dataFileDiscard();
+  LittleFS.format();
+  dataManifest.clear();
+  monthsLoad();
+  fsUsageStale = true;
+  currentFileName = "";
+  currentFileSize = 0;
+}
+
+void firmwareRun(unsigned long ms) {
+  unsigned long until = millis() + ms;
+
+  while ((long)(until - millis()) > 0) {
+    loop();
+  }
+}
+
+void firmwareLogRecords(int count) {
+  for (int i = 0; i < count; i++) {
+    loggedStamp += 180;
+    curSensors.stamp = loggedStamp;
+    curSensors.event = i % 20 == 19 ? (i % 40 == 39 ? 'f' : 'n') : 't';
+    for (int k = 0; k < BENCH_SENSORS; k++) {
+      curSensors.t[k] = 90 + (i * 7 + k * 13) % 40;
+    }
+    putSensorsIntoDataLog();
+
+    if (i % 64 == 63) {
+      flushLogIntoFile();
+    }
+  }
+  flushLogIntoFile();
+}
+
+static int dataFilesCount() {
+  Dir dir = LittleFS.openDir("/d");
+  int count = 0;
+
+  while (dir.next())
+    count++;
+  return count;
+}
+
+void BM_RecordToJson(BenchState &state) {
+  event_record record = {1615162255, 'n', {72, 92, 36, 24}};
+  packed_date_cache cache;
+  char out[LOG_JSON_RECORD_MAX];
+  size_t bytes = 0;
+
+  packedDateReset(&cache);
+
+  while (state.keepRunning()) {
+    record.stamp += 180;
+    bytes += logRecordToJson(&record, BENCH_SENSORS, &cache, out);
+  }
+
+  state.setItemsProcessed(state.iterations());
+  state.setBytesProcessed(bytes);
+}
+BENCH(BM_RecordToJson);
+
+void BM_FlushLogIntoFile(BenchState &state) {
+  const int perFlush = 64;
+
+  firmwareBoot();
+  firmwareResetData();
+
+  while (state.keepRunning()) {
+    state.pauseTiming();
+    if (state.iterations() > 1 && currentFileSize == 0 && dataFilesCount() > BENCH_DATA_FILES) {
+      firmwareResetData();
+    }
+    for (int i = 0; i < perFlush; i++) {
+      loggedStamp += 180;
+      curSensors.stamp = loggedStamp;
+      curSensors.event = 't';
+      for (int k = 0; k < BENCH_SENSORS; k++) {
+        curSensors.t[k] = 90 + (i * 7 + k * 13) % 40;
+      }
+      putSensorsIntoDataLog();
+    }
+    state.resumeTiming();
+
+    flushLogIntoFile();
+  }
+
+  state.setItemsProcessed(state.iterations() * perFlush);
+  state.setLabel("allocs/it = per flush of 64 records");
+}
+BENCH(BM_FlushLogIntoFile);
+
+// Relay switch flushes the data log at once, a record or two each time. Commit counters are left out in a
+// build with METRICS 0
+void BM_FlushRelayEvent(BenchState &state) {
+#if METRICS
+  uint32_t bytes, commits, programmed;
+#endif
+
+  firmwareBoot();
+  firmwareResetData();
+
+#if METRICS
+  bytes = metricCounter(METRIC_DATA_BYTES);
+  commits = metricCounter(METRIC_DATA_COMMITS);
+  programmed = metricCounter(METRIC_DATA_PROGRAMMED);
+#endif
+
+  while (state.keepRunning()) {
+    state.pauseTiming();
+    if (state.iterations() > 1 && currentFileSize == 0 && dataFilesCount() > BENCH_DATA_FILES) {
+      firmwareResetData();
+    }
+    loggedStamp += 180;
+    curSensors.stamp = loggedStamp;
+    curSensors.event = state.iterations() % 2 ? 'n' : 'f';
+    for (int k = 0; k < BENCH_SENSORS; k++) {
+      curSensors.t[k] = 90 + (int)(state.iterations() * 7 + k * 13) % 40;
+    }
+    putSensorsIntoDataLog();
+    state.resumeTiming();
+
+    flushLogIntoFile();
+  }
+
+  state.setItemsProcessed(state.iterations());
+
+#if METRICS
+  bytes = metricCounter(METRIC_DATA_BYTES) - bytes;
+  commits = metricCounter(METRIC_DATA_COMMITS) - commits;
+  programmed = metricCounter(METRIC_DATA_PROGRAMMED) - programmed;
+
+  state.setCounter("commits_per_flush", (double)commits / state.iterations());
+  state.setCounter("write_amp", bytes ? (double)programmed / bytes : 0);
+#endif
+}
+BENCH(BM_FlushRelayEvent);
+
+void BM_CheckFile(BenchState &state) {
+  String name;
+  size_t size;
+
+  firmwareBoot();
+  firmwareResetData();
+  firmwareLogRecords(2000);  // first file is full by then
+
+  Dir dir = LittleFS.openDir("/d");
+
+  dir.next();
+  name = "/d/" + dir.fileName();
+  size = dir.fileSize();
+
+  while (state.keepRunning()) {
+    uint32_t verified = 0;
+
+    if (!checkFile(&name, &verified)) {
+      state.skip("check failed for " + name.std());
+      return;
+    }
+  }
+
+  state.setBytesProcessed(state.iterations() * size);
+}
+BENCH(BM_CheckFile);
+
+// Periodic check of the current file, only the part written since the previous check is read
+void BM_CheckFileTail(BenchState &state) {
+  size_t bytes = 0;
+
+  firmwareBoot();
+  firmwareResetData();
+  firmwareLogRecords(500);
+  dataFileCommit();
+
+  currentFileVerified = 0;
+  checkFile(&currentFileName, &currentFileVerified);
+
+  while (state.keepRunning()) {
+    state.pauseTiming();
+    if (currentFileSize > 7000) {
+      firmwareResetData();
+      firmwareLogRecords(10);
+    }
+    firmwareLogRecords(20);  // a check period worth of records
+    dataFileCommit();  // check reads what is on flash
+    bytes += currentFileSize - currentFileVerified;
+    state.resumeTiming();
+
+    if (!checkFile(&currentFileName, &currentFileVerified)) {
+      state.skip("check failed for " + currentFileName.std());
+      return;
+    }
+  }
+
+  state.setBytesProcessed(bytes);
+}
+BENCH(BM_CheckFileTail);
+
+static void prepareDataFiles() {
+  firmwareBoot();
+  if (dataFilesCount() < BENCH_DATA_FILES) {
+    firmwareResetData();
+    while (dataFilesCount() < BENCH_DATA_FILES)
+      firmwareLogRecords(1000);
+  }
+}
+
+// Reply written to the connection by downloads, parsed back into response. Chunked body is joined
+static void parseStreamed(const std::string &raw, native_response *response) {
+  size_t headEnd = raw.find("\r\n\r\n"), pos;
+  std::string head = raw.substr(0, headEnd), body = raw.substr(headEnd + 4);
+
+  response->code = atoi(head.c_str() + 9);  // "HTTP/1.1 200 OK"
+  for (pos = head.find("\r\n"); pos != std::string::npos; pos = head.find("\r\n", pos + 2)) {
+    size_t next = head.find("\r\n", pos + 2);
+    std::string line = head.substr(pos + 2, next == std::string::npos ? std::string::npos : next - pos - 2);
+    size_t colon = line.find(':');
+
+    response->headers.push_back(std::make_pair(line.substr(0, colon), line.substr(colon + 2)));
+  }
+
+  response->chunked = head.find("Transfer-Encoding: chunked") != std::string::npos;
+  if (!response->chunked) {
+    response->body = body;
+    return;
+  }
+  for (pos = 0; pos < body.size();) {
+    size_t len = strtoul(body.c_str() + pos, nullptr, 16);
+
+    pos = body.find("\r\n", pos) + 2;
+    response->body += body.substr(pos, len);
+    pos += len + 2;
+    response->finished = len == 0;
+  }
+}
+
+// Request as the client sees it: when the handler hands the connection to downloads, the reply is pumped
+// out like loop() does and read back, sends counts the pump() calls
+static native_response fetch(const char *uri, const std::vector<std::pair<std::string, std::string>> &headers = {}) {
+  native_response response = hal::request(server, uri, headers);
+  std::string raw;
+
+  if (response.code != 0) {
+    return response;
+  }
+  while (response.socket->open) {
+    downloads.pump();
+    raw += hal::receive(response);
+    response.sends++;
+  }
+  parseStreamed(raw, &response);
+  return response;
+}
+
+// Gzip archives of sealed data files turned on or off through /conf, as the UI does
+static void archivesEnable(bool on) {
+  fetch(on ? "/conf?set=%7B%22gz%22:1%7D" : "/conf?set=%7B%22gz%22:0%7D");
+}
+
+static void requestBench(BenchState &state, const char *uri, const std::vector<std::pair<std::string, std::string>> &headers = {},
+                         int code = 200) {
+  size_t bytes = 0;
+  native_response response;
+
+  prepareDataFiles();
+
+  while (state.keepRunning()) {
+    response = fetch(uri, headers);
+    bytes += response.body.size();
+  }
+
+  if (response.code != code) {
+    state.skip("HTTP " + std::to_string(response.code));
+    return;
+  }
+  state.setItemsProcessed(state.iterations());
+  state.setBytesProcessed(bytes);
+  state.setCounter("reply_B", response.body.size());
+  state.setCounter("sends", response.sends);
+}
+
+void BM_InfoRequest(BenchState &state) {
+  requestBench(state, "/info");
+  state.setLabel(std::to_string(BENCH_DATA_FILES) + " data files");
+}
+BENCH(BM_InfoRequest);
+
+void BM_InfoCurRequest(BenchState &state) {
+  requestBench(state, "/info?cur=1");
+}
+BENCH(BM_InfoCurRequest);
+
+void BM_InfoLastRequest(BenchState &state) {
+  requestBench(state, "/info?last=1");
+}
+BENCH(BM_InfoLastRequest);
+
+void BM_StatsRequest(BenchState &state) {
+  requestBench(state, "/stats");
+}
+BENCH(BM_StatsRequest);
+
+// Partial update: parsed onto the current config, saved in binary form. Malformed JSON gets 400 first,
+// trailing commas included
+void BM_ConfSetRequest(BenchState &state) {
+  const char *malformed[] = {
+      "/conf?set=%7B%22tl%22:200,%7D",            // {"tl":200,}
+      "/conf?set=%7B%22res%22:%5B1,%5D%7D",       // {"res":[1,]}
+      "/conf?set=%7B%22x%22:%7B%22a%22:1,%7D%7D",  // {"x":{"a":1,}}
+      "/conf?set=%7B%22x%22:%5B1,%5D%7D",         // {"x":[1,]}
+      "/conf?set=%7B,%7D",                        // {,}
+      "/conf?set=%7B%22tl%22:200",                // {"tl":200
+  };
+
+  firmwareBoot();
+  for (const char *uri : malformed) {
+    if (fetch(uri).code != 400) {
+      state.skip(std::string("not rejected: ") + uri);
+      return;
+    }
+  }
+  requestBench(state, "/conf?set=%7B%22tl%22:200,%22th%22:%22230%22%7D");
+}
+BENCH(BM_ConfSetRequest);
+
+// Skipped in a build with METRICS 0
+void BM_MetricsRequest(BenchState &state) {
+  requestBench(state, "/metrics");
+}
+BENCH(BM_MetricsRequest);
+
+void BM_DataFileRequest(BenchState &state) {
+  std::string uri;
+
+  prepareDataFiles();
+
+  Dir dir = LittleFS.openDir("/d");
+  dir.next();
+  uri = "/data?f=" + dir.fileName().std();
+
+  requestBench(state, uri.c_str());
+}
+BENCH(BM_DataFileRequest);
+
+// Reload of a dashboard: sealed file is asked again with the ETag of the first reply
+void BM_DataFileNotModified(BenchState &state) {
+  std::string uri, etag;
+
+  prepareDataFiles();
+
+  Dir dir = LittleFS.openDir("/d");
+  dir.next();
+  uri = "/data?f=" + dir.fileName().std();
+
+  for (const auto &header : fetch(uri.c_str()).headers) {
+    if (header.first == "ETag")
+      etag = header.second;
+  }
+
+  requestBench(state, uri.c_str(), {{"If-None-Match", etag}}, 304);
+}
+BENCH(BM_DataFileNotModified);
+
+// Gzipped download cut halfway by Wi-Fi and resumed: Range of the rest, If-Range with the ETag of the first
+// reply. The archive is read from the range on, the rest is checked against the first reply
+void BM_DataFileResume(BenchState &state) {
+  std::string uri, etag, range;
+  native_response first, response;
+  size_t bytes = 0;
+
+  prepareDataFiles();
+
+  Dir dir = LittleFS.openDir("/d");
+  dir.next();
+  uri = "/data?f=" + dir.fileName().std();
+  archivesEnable(true);
+  while (!LittleFS.exists(("/z/" + dir.fileName().std()).c_str())) {
+    firmwareRun(1);
+  }
+
+  first = fetch(uri.c_str(), {{"Accept-Encoding", "gzip"}});
+  for (const auto &header : first.headers) {
+    if (header.first == "ETag")
+      etag = header.second;
+  }
+  range = "bytes=" + std::to_string(first.body.size() / 2) + "-";
+
+  while (state.keepRunning()) {
+    response = fetch(uri.c_str(), {{"Accept-Encoding", "gzip"}, {"Range", range}, {"If-Range", etag}});
+    bytes += response.body.size();
+  }
+  archivesEnable(false);
+
+  if (response.code != 206 || response.body != first.body.substr(first.body.size() / 2)) {
+    state.skip(response.code != 206 ? "HTTP " + std::to_string(response.code) : "range differs from the reply");
+    return;
+  }
+  state.setItemsProcessed(state.iterations());
+  state.setBytesProcessed(bytes);
+  state.setCounter("reply_B", response.body.size());
+  state.setCounter("sends", response.sends);
+  state.setLabel("second half of " + std::to_string(first.body.size()) + " B");
+}
+BENCH(BM_DataFileResume);
+
+// Name and size of every data file, oldest first
+static std::vector<std::pair<std::string, size_t>> dataFiles() {
+  std::vector<std::pair<std::string, size_t>> files;
+
+  Dir dir = LittleFS.openDir("/d");
+  while (dir.next())
+    files.push_back(std::make_pair(dir.fileName().std(), (size_t)dir.fileSize()));
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+// Cold load of a dashboard: every data file, one request each
+void BM_DataFilesOneByOne(BenchState &state) {
+  std::vector<std::pair<std::string, size_t>> files;
+  size_t bytes = 0;
+
+  prepareDataFiles();
+  files = dataFiles();
+
+  while (state.keepRunning()) {
+    for (const auto &file : files)
+      bytes += fetch(("/data?f=" + file.first).c_str()).body.size();
+  }
+  state.setItemsProcessed(state.iterations() * files.size());
+  state.setBytesProcessed(bytes);
+  state.setLabel(std::to_string(files.size()) + " requests");
+}
+BENCH(BM_DataFilesOneByOne);
+
+// The same files in one /data?f=a,b,c reply. Frames are checked against the replies of single files
+void BM_DataBatchRequest(BenchState &state) {
+  std::vector<std::pair<std::string, size_t>> files;
+  std::string uri = "/data?f=", expected = "[";
+  native_response response;
+  size_t bytes = 0;
+
+  prepareDataFiles();
+  files = dataFiles();
+  for (const auto &file : files) {
+    const char *comma = expected.size() > 1 ? "," : "";
+
+    uri += comma + file.first;
+    expected += comma + ("{\"n\":\"" + file.first) + "\",\"s\":" + std::to_string(file.second) +
+                ",\"d\":" + fetch(("/data?f=" + file.first).c_str()).body + "}";
+  }
+  expected += "]";
+
+  while (state.keepRunning()) {
+    response = fetch(uri.c_str());
+    bytes += response.body.size();
+  }
+
+  if (response.code != 200 || response.body != expected) {
+    state.skip(response.code != 200 ? "HTTP " + std::to_string(response.code) : "frames differ from single replies");
+    return;
+  }
+  state.setItemsProcessed(state.iterations() * files.size());
+  state.setBytesProcessed(bytes);
+  state.setCounter("reply_B", response.body.size());
+  state.setCounter("sends", response.sends);
+  state.setLabel("1 request");
+}
+BENCH(BM_DataBatchRequest);
+
+// Background compression of a sealed data file into /z/, slice by slice from loop()
+void BM_ArchiveDataFile(BenchState &state) {
+  std::string name, path;
+  size_t plain = 0;
+
+  prepareDataFiles();
+
+  Dir dir = LittleFS.openDir("/d");
+  dir.next();
+  name = dir.fileName().std();
+  path = "/z/" + name;
+  archivesEnable(true);
+
+  while (state.keepRunning()) {
+    state.pauseTiming();
+    LittleFS.remove(path.c_str());
+    state.resumeTiming();
+
+    while (!LittleFS.exists(path.c_str())) {
+      firmwareRun(1);
+    }
+  }
+
+  plain = fetch(("/data?f=" + name).c_str()).body.size();
+  state.setBytesProcessed(plain * state.iterations());
+  state.setCounter("ratio", (double)plain / LittleFS.open(path.c_str(), "r").size());
+  archivesEnable(false);
+}
+BENCH(BM_ArchiveDataFile);
+
+void BM_DataFileGzipRequest(BenchState &state) {
+  std::string uri;
+
+  prepareDataFiles();
+
+  Dir dir = LittleFS.openDir("/d");
+  dir.next();
+  uri = "/data?f=" + dir.fileName().std();
+  archivesEnable(true);
+  while (!LittleFS.exists(("/z/" + dir.fileName().std()).c_str())) {
+    firmwareRun(1);
+  }
+
+  requestBench(state, uri.c_str(), {{"Accept-Encoding", "gzip"}});
+  archivesEnable(false);
+}
+BENCH(BM_DataFileGzipRequest);
+
+// Three data files downloaded at once, a fourth request is turned away. pump_us is the time loop() is held
+// by downloads in one pass
+void BM_DataFileConcurrent(BenchState &state) {
+  native_response replies[FILE_STREAM_SLOTS];
+  std::string uris[FILE_STREAM_SLOTS];
+  double pumpUs = 0;
+  size_t bytes = 0, pumps = 0;
+  int busy = 0;
+
+  prepareDataFiles();
+
+  Dir dir = LittleFS.openDir("/d");
+  for (int i = 0; i < FILE_STREAM_SLOTS && dir.next(); i++) {
+    uris[i] = "/data?f=" + dir.fileName().std();
+  }
+
+  while (state.keepRunning()) {
+    bool open = true;
+
+    for (int i = 0; i < FILE_STREAM_SLOTS; i++) {
+      replies[i] = hal::request(server, uris[i].c_str());
+    }
+    busy = hal::request(server, uris[0].c_str()).code;
+
+    while (open) {
+      auto before = std::chrono::steady_clock::now();
+
+      downloads.pump();
+      pumpUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - before).count();
+      pumps++;
+
+      open = false;
+      for (int i = 0; i < FILE_STREAM_SLOTS; i++) {
+        bytes += hal::receive(replies[i]).size();
+        open = open || replies[i].socket->open;
+      }
+    }
+  }
+
+  state.setItemsProcessed(state.iterations() * FILE_STREAM_SLOTS);
+  state.setBytesProcessed(bytes);
+  state.setCounter("pump_us", pumpUs / pumps);
+  state.setCounter("busy_code", busy);
+}
+BENCH(BM_DataFileConcurrent);
+
+// Records of the whole range must come in time order: the directory lists "_10" before "_2" of a day
+static bool stampsAscend(const std::string &body) {
+  long last = 0;
+
+  for (size_t pos = body.find('[', 1); pos != std::string::npos; pos = body.find('[', pos + 1)) {
+    long stamp = atol(body.c_str() + pos + 1);
+
+    if (stamp < last) {
+      return false;
+    }
+    last = stamp;
+  }
+  return true;
+}
+
+void BM_DataRangeRequest(BenchState &state) {
+  std::string uri;
+
+  prepareDataFiles();
+
+  if (!stampsAscend(fetch(("/data?from=0&to=" + std::to_string(loggedStamp)).c_str()).body)) {
+    state.skip("records of data files out of time order");
+    return;
+  }
+  uri = "/data?from=" + std::to_string(loggedStamp - 6 * 3600) + "&to=" + std::to_string(loggedStamp);
+  requestBench(state, uri.c_str());
+  state.setLabel("last 6 hours of " + std::to_string(BENCH_DATA_FILES) + " data files");
+}
+BENCH(BM_DataRangeRequest);
+
+// Cursor past the last record, a cursor too far gets it back with "reset"
+static long dataSeqEnd() {
+  long seq = 0;
+
+  sscanf(hal::request(server, "/data?since=999999999").body.c_str(), "{\"seq\":%ld", &seq);
+  return seq;
+}
+
+// Poll of a client which is up to date: only the records logged since its last poll
+void BM_DataSincePoll(BenchState &state) {
+  std::string uri;
+
+  prepareDataFiles();
+  for (int i = 0; i < 3; i++) {
+    curSensors.stamp = ++loggedStamp;
+    putSensorsIntoDataLog();
+  }
+
+  uri = "/data?since=" + std::to_string(dataSeqEnd() - 3);
+  requestBench(state, uri.c_str());
+  state.setLabel("3 new records");
+}
+BENCH(BM_DataSincePoll);
+
+void BM_DataSinceBehind(BenchState &state) {
+  std::string uri;
+
+  prepareDataFiles();
+
+  uri = "/data?since=" + std::to_string(dataSeqEnd() - 100);
+  requestBench(state, uri.c_str());
+  state.setLabel("100 records behind, " + std::to_string(BENCH_DATA_FILES) + " data files");
+}
+BENCH(BM_DataSinceBehind);
+
+void BM_DataAggRequest(BenchState &state) {
+  std::string uri;
+
+  prepareDataFiles();
+
+  uri = "/data/agg?points=200&from=" + std::to_string(loggedStamp - 30 * 24 * 3600) + "&to=" + std::to_string(loggedStamp);
+  requestBench(state, uri.c_str());
+  state.setLabel("30 days into 200 buckets");
+}
+BENCH(BM_DataAggRequest);
+
+void BM_DataLttbRequest(BenchState &state) {
+  std::string uri;
+
+  prepareDataFiles();
+
+  uri = "/data/agg?points=200&mode=lttb&from=" + std::to_string(loggedStamp - 30 * 24 * 3600) + "&to=" + std::to_string(loggedStamp);
+  requestBench(state, uri.c_str());
+  state.setLabel("30 days into 200 points");
+}
+BENCH(BM_DataLttbRequest);
+
+// /info?cur=1&f=1 starts a sensors scan, stall_ms is the fake clock time the request held the main loop
+void BM_InfoScanRequest(BenchState &state) {
+  unsigned long stalled = 0;
+
+  prepareDataFiles();
+
+  while (state.keepRunning()) {
+    unsigned long before = millis();
+
+    hal::request(server, "/info?cur=1&f=1");
+    stalled += millis() - before;
+
+    state.pauseTiming();
+    firmwareRun(1000);  // conversion is over and read by then
+    state.resumeTiming();
+  }
+
+  state.setItemsProcessed(state.iterations());
+  state.setCounter("stall_ms", (double)stalled / state.iterations());
+}
+BENCH(BM_InfoScanRequest);
+
+// Reading pushed to /events: two subscribers drained after every event, a third never reads and gets
+// dropped once its TCP window and slot buffer are full, then subscribes again. Drops are not counted in a
+// build with METRICS 0
+void BM_EventsFanout(BenchState &state) {
+  native_response fast[2], slow;
+  size_t bytes = 0;
+#if METRICS
+  uint32_t dropped;
+#endif
+
+  prepareDataFiles();
+
+  fast[0] = hal::request(server, "/events");
+  fast[1] = hal::request(server, "/events");
+  slow = hal::request(server, "/events");
+  hal::receive(fast[0]);
+  hal::receive(fast[1]);
+#if METRICS
+  dropped = metricCounter(METRIC_EVENTS_DROPPED);
+#endif
+
+  while (state.keepRunning()) {
+    readSensors();
+    events.pump();
+
+    state.pauseTiming();
+    bytes += hal::receive(fast[0]).size();
+    hal::receive(fast[1]);
+    if (events.subscribers() < 3) {
+      slow = hal::request(server, "/events");
+    }
+    state.resumeTiming();
+  }
+
+#if METRICS
+  dropped = metricCounter(METRIC_EVENTS_DROPPED) - dropped;
+#endif
+
+  fast[0].socket->open = fast[1].socket->open = slow.socket->open = false;  // peers go away, slots are free again
+  events.pump();
+
+  state.setItemsProcessed(state.iterations());
+  state.setCounter("event_bytes", (double)bytes / state.iterations());
+#if METRICS
+  state.setCounter("drops_per_1k", 1000.0 * dropped / state.iterations());
+#endif
+}
+BENCH(BM_EventsFanout);
+
+static size_t dirBytes(const char *path) {
+  Dir dir = LittleFS.openDir(path);
+  size_t bytes = 0;
+
+  while (dir.next())
+    bytes += dir.fileSize();
+  return bytes;
+}
+
+static uint32_t fsUsedPercent() {
+  FSInfo fs;
+
+  LittleFS.info(fs);
+  return (uint64_t)fs.usedBytes * 100 / fs.totalBytes;
+}
+
+// File system is shrunk so data files fill 85% of it, time is till retention brings
+// use below 70%. Includes the wait for the next check of the retention job
+void BM_RetentionCompact(BenchState &state) {
+  size_t files = 0, monthBytes = 0, dataBytes = 0;
+
+  while (state.keepRunning()) {
+    FSInfo fs;
+    int before;
+
+    state.pauseTiming();
+    prepareDataFiles();
+    LittleFS.info(fs);
+    hal::resizeFs(fs.usedBytes * 100 / 85);
+    fsUsageStale = true;
+    before = dataFilesCount();
+    dataBytes = dirBytes("/d");
+    state.resumeTiming();
+
+    while (fsUsedPercent() >= 70) {
+      firmwareRun(1000);
+    }
+
+    state.pauseTiming();
+    files += before - dataFilesCount();
+    monthBytes = dirBytes("/m");
+    dataBytes -= dirBytes("/d");
+    hal::resizeFs(BENCH_FS_BYTES);
+    fsUsageStale = true;
+    state.resumeTiming();
+  }
+
+  state.setItemsProcessed(files);
+  state.setCounter("files", (double)files / state.iterations());
+  state.setCounter("data_kb", dataBytes / 1024.0);
+  state.setCounter("month_kb", monthBytes / 1024.0);
+}
+BENCH(BM_RetentionCompact);
@@ -0,0 +1,268 @@
+/*
+  history_bench.cpp - column archive of controller history (tools/ColumnArchive.h)
+
+  Dumps of stored-data/ (or files/dirs given on the command line) are
+  replayed back to back with a reading every 3 minutes until there are
+  HISTORY_READINGS of them, about 6 years, and the later half is dumped
+  twice as overlapping exports are. Before timing, aggregates of random
+  ranges are checked against a plain loop over the rows and events kept.
+*/
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "Bench.h"
+#include "ColumnArchive.h"
+
+#define DEFAULT_CORPUS "../stored-data"
+#define HISTORY_READINGS (1 << 20)
+#define HISTORY_START 1600000000
+#define HISTORY_STEP 180
+#define HISTORY_QUERIES 1024
+
+static void collect(const std::string &path, std::vector<std::string> *files) {
+  struct stat st;
+
+  if (stat(path.c_str(), &st) != 0) {
+    return;
+  }
+  if (S_ISDIR(st.st_mode)) {
+    DIR *dir = opendir(path.c_str());
+    struct dirent *entry;
+
+    while (dir && (entry = readdir(dir))) {
+      if (entry->d_name[0] != '.') {
+        collect(path + "/" + entry->d_name, files);
+      }
+    }
+    if (dir)
+      closedir(dir);
+  } else if (st.st_size > 0) {
+    files->push_back(path);
+  }
+}
+
+// Rows of the dumps in the order they were found
+static const std::vector<dump_row> &corpus() {
+  static std::vector<dump_row> rows;
+  static bool loaded = false;
+  std::vector<std::string> paths;
+
+  if (loaded) {
+    return rows;
+  }
+  loaded = true;
+
+  for (const std::string &arg : benchArgs()) {
+    collect(arg, &paths);
+  }
+  if (paths.empty()) {
+    collect(DEFAULT_CORPUS, &paths);
+  }
+  for (const std::string &path : paths) {
+    columnParseFile(path.c_str(), 0, &rows);
+  }
+  return rows;
+}
+
+// Corpus readings restamped HISTORY_STEP apart, an event gets the stamp of the reading before it
+static const std::vector<dump_row> &dumps() {
+  static std::vector<dump_row> rows;
+  size_t readings = 0, half;
+
+  if (!rows.empty() || corpus().empty()) {
+    return rows;
+  }
+
+  for (size_t i = 0; readings < HISTORY_READINGS; i++) {
+    dump_row row = corpus()[i % corpus().size()];
+
+    readings += row.count > 0;
+    row.stamp = HISTORY_START + (uint32_t)readings * HISTORY_STEP;
+    rows.push_back(row);
+  }
+  half = rows.size() / 2;
+  rows.insert(rows.end(), rows.begin() + half, rows.begin() + rows.size());
+  return rows;
+}
+
+// Archive of dumps(), mapped and unlinked, so nothing is left behind
+static const ColumnArchive *archive() {
+  static ColumnArchive mapped;
+  static bool written = false;
+  static char root[] = "/tmp/esp-bench-XXXXXX";
+
+  if (!written && !dumps().empty() && mkdtemp(root)) {
+    std::vector<dump_row> rows = dumps();
+    std::string path = std::string(root) + "/history.thca";
+    column_write_stats stats;
+
+    written = columnArchiveWrite(path.c_str(), &rows, &stats) && mapped.open(path.c_str());
+    unlink(path.c_str());
+    rmdir(root);
+  }
+  return written ? &mapped : nullptr;
+}
+
+static uint32_t seed = 12345;
+
+static uint32_t nextRandom(uint32_t below) {
+  seed = seed * 1103515245 + 12345;
+  return ((seed >> 8) ^ (seed << 13)) % below;
+}
+
+// A day to a month somewhere in the archive
+static void randomRange(const ColumnArchive *a, uint32_t *from, uint32_t *to) {
+  uint32_t first = a->stamps()[0], last = a->stamps()[a->rows() - 1];
+
+  *from = first + nextRandom(last - first);
+  *to = *from + 86400 + nextRandom(29 * 86400);
+}
+
+static bool check(const ColumnArchive *a, std::string *error) {
+  for (int q = 0; q < HISTORY_QUERIES; q++) {
+    uint32_t from, to;
+    column_agg fast, slow;
+
+    randomRange(a, &from, &to);
+    a->aggregate(from, to, &fast);
+    columnAggReset(&slow, a->sensors());
+    for (uint64_t i = 0; i < a->rows(); i++) {
+      if (a->stamps()[i] < from || a->stamps()[i] > to) {
+        continue;
+      }
+      slow.rows++;
+      for (uint16_t k = 0; k < a->sensors(); k++) {
+        int16_t v = a->column(k)[i];
+
+        if (v != COLUMN_MISSING && v != COLUMN_DISCONNECTED) {
+          slow.count[k]++;
+          slow.sum[k] += v;
+          slow.min[k] = v < slow.min[k] ? v : slow.min[k];
+          slow.max[k] = v > slow.max[k] ? v : slow.max[k];
+        }
+      }
+    }
+
+    for (uint64_t e = 0; e < a->eventCount(); e++) {
+      const column_event &ev = a->events()[e];
+      uint32_t last = a->stamps()[a->rows() - 1] > ev.stamp ? a->stamps()[a->rows() - 1] : ev.stamp;
+      uint32_t until = e + 1 < a->eventCount() ? a->events()[e + 1].stamp : last;
+      uint32_t lo = ev.stamp > from ? ev.stamp : from, hi = until < to ? until : to;
+
+      slow.on += ev.kind == 'n' && hi > lo ? hi - lo : 0;
+    }
+
+    if (fast.rows != slow.rows || fast.on != slow.on) {
+      *error = "rows/on " + std::to_string(fast.rows) + "/" + std::to_string(fast.on) + " != " + std::to_string(slow.rows) +
+               "/" + std::to_string(slow.on);
+      return false;
+    }
+    for (uint16_t k = 0; k < a->sensors(); k++) {
+      if (fast.count[k] != slow.count[k] || fast.sum[k] != slow.sum[k] || fast.min[k] != slow.min[k] ||
+          fast.max[k] != slow.max[k]) {
+        *error = "sensor " + std::to_string(k) + " of [" + std::to_string(from) + "," + std::to_string(to) + "] differs";
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void BM_HistoryIngest(BenchState &state) {
+  std::vector<dump_row> rows;
+  column_write_stats stats = {};
+  static char root[] = "/tmp/esp-bench-XXXXXX";
+  std::string path;
+
+  if (dumps().empty()) {
+    state.skip("no corpus found at " DEFAULT_CORPUS);
+    return;
+  }
+  if (!mkdtemp(root)) {
+    state.skip("no temp dir");
+    return;
+  }
+  path = std::string(root) + "/history.thca";
+
+  while (state.keepRunning()) {
+    state.pauseTiming();
+    rows = dumps();
+    state.resumeTiming();
+    if (!columnArchiveWrite(path.c_str(), &rows, &stats)) {
+      state.skip("write failed");
+      break;
+    }
+  }
+  unlink(path.c_str());
+  rmdir(root);
+
+  state.setItemsProcessed(state.iterations() * dumps().size());
+  state.setBytesProcessed(state.iterations() * stats.bytes);
+  state.setCounter("rows", stats.rows);
+  state.setCounter("dup", stats.duplicates);
+  state.setCounter("repeated", stats.repeated);
+  state.setCounter("bytes_per_row", (double)stats.bytes / stats.rows);
+}
+BENCH(BM_HistoryIngest);
+
+// Every reading of the archive through scan(), items are rows
+void BM_HistoryScanRows(BenchState &state) {
+  const ColumnArchive *a = archive();
+  column_agg agg;
+
+  if (!a) {
+    state.skip("no corpus found at " DEFAULT_CORPUS);
+    return;
+  }
+
+  while (state.keepRunning()) {
+    columnAggReset(&agg, a->sensors());
+    a->scan(0, a->rows(), &agg);
+  }
+
+  state.setItemsProcessed(state.iterations() * a->rows());
+  state.setBytesProcessed(state.iterations() * a->rows() * (sizeof(uint32_t) + a->sensors() * sizeof(int16_t)));
+  state.setCounter("readings", (double)a->rows() * a->sensors());
+  state.setCounter("avg0", agg.count[0] ? (double)agg.sum[0] / agg.count[0] : 0);
+}
+BENCH(BM_HistoryScanRows);
+
+// A day to a month ranges through aggregate(), items are queries
+void BM_HistoryAggregate(BenchState &state) {
+  const ColumnArchive *a = archive();
+  std::vector<std::pair<uint32_t, uint32_t>> ranges(HISTORY_QUERIES);
+  std::string error;
+  column_agg agg;
+  uint64_t rows = 0;
+  size_t i = 0;
+
+  if (!a) {
+    state.skip("no corpus found at " DEFAULT_CORPUS);
+    return;
+  }
+  if (!check(a, &error)) {
+    state.skip(error);
+    return;
+  }
+  for (std::pair<uint32_t, uint32_t> &range : ranges) {
+    randomRange(a, &range.first, &range.second);
+  }
+
+  while (state.keepRunning()) {
+    const std::pair<uint32_t, uint32_t> &range = ranges[i++ % HISTORY_QUERIES];
+
+    a->aggregate(range.first, range.second, &agg);
+    rows += agg.rows;
+  }
+
+  state.setItemsProcessed(state.iterations());
+  state.setCounter("rows_per_query", (double)rows / state.iterations());
+}
+BENCH(BM_HistoryAggregate);
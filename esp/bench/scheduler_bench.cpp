@@ -0,0 +1,38 @@
+/*
+  scheduler_bench.cpp - cost of the loop() timer dispatch
+
+  A full set of periodic jobs with co-prime periods is run over the fake
+  clock, every pass sleeps idleMs() till the nearest deadline and runs what
+  is due, as loop() does; items are the jobs run.
+*/
+
+#include "Arduino.h"
+#include "Bench.h"
+#include "Scheduler.h"
+
+static uint32_t fired;
+
+static void countJob() {
+  fired++;
+}
+
+void BM_SchedulerDispatch(BenchState &state) {
+  static const uint32_t periods[] = {3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41};
+  Scheduler scheduler;
+
+  for (uint8_t i = 0; i < SCHEDULER_JOBS_MAX; i++) {
+    scheduler.start(scheduler.add("job", countJob), periods[i], periods[i]);
+  }
+
+  fired = 0;
+  while (state.keepRunning()) {
+    uint32_t nap = scheduler.idleMs(1000);
+
+    delay(nap);
+    scheduler.run();
+  }
+
+  state.setItemsProcessed(fired);
+  state.setCounter("jobs_per_it", (double)fired / state.iterations());
+}
+BENCH(BM_SchedulerDispatch);
@@ -0,0 +1,151 @@
+/*
+  stats_bench.cpp - cost of the rolling statistics update
+
+  A month of synthetic readings, every 3 minutes from 4 sensors with a daily
+  swing and noise, drives a thermostat with hysteresis. Items are readings
+  added. Before timing, the same month is checked against brute force over
+  all readings kept: window extremes and relay on-time must match exactly.
+*/
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "Bench.h"
+#include "RollingStats.h"
+
+#define SENSORS 4
+#define READ_EACH_SEC 180
+#define READINGS (30 * 24 * 3600 / READ_EACH_SEC)
+
+struct reading {
+  uint32_t at;
+  int t[SENSORS];
+};
+
+struct relay_span {
+  uint32_t from;
+  uint32_t to;
+};
+
+static uint32_t seed = 12345;
+
+static int noise() {
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 16) % 21) - 10;
+}
+
+// Relay switches on below 19.0 and off above 21.0 on sensor 0
+static void makeReading(uint32_t at, bool *relay, reading *out) {
+  int swing = (int)(at / 60 % 1440);
+
+  swing = swing < 720 ? swing : 1440 - swing;
+  out->at = at;
+  for (int k = 0; k < SENSORS; k++) {
+    out->t[k] = 150 + swing / 8 + k * 10 + noise() + (*relay ? 20 : 0);
+  }
+  if (!*relay && out->t[0] < 190) {
+    *relay = true;
+  } else if (*relay && out->t[0] > 210) {
+    *relay = false;
+  }
+}
+
+static bool check(std::string *error) {
+  std::vector<reading> readings;
+  std::vector<relay_span> spans;
+  RollingStats stats;
+  bool relay = false;
+  uint32_t start = 1000;
+
+  stats.begin(SENSORS);
+  for (int i = 0; i < READINGS; i++) {
+    reading r;
+    bool was = relay;
+
+    makeReading(start + i * READ_EACH_SEC, &relay, &r);
+    stats.addReading(r.at, r.t);
+    readings.push_back(r);
+    if (relay != was) {
+      stats.relaySwitched(r.at, relay);
+      if (relay) {
+        spans.push_back({r.at, 0});
+      } else {
+        spans.back().to = r.at;
+      }
+    }
+    if (i % 97) {
+      continue;
+    }
+
+    for (uint8_t w = 0; w < STATS_WINDOWS; w++) {
+      uint32_t len = RollingStats::windowSec(w) / STATS_SLOTS;
+      uint32_t edge = (r.at / len + 1 > STATS_SLOTS ? r.at / len + 1 - STATS_SLOTS : 0) * len;
+      uint32_t on = 0;
+
+      for (const relay_span &span : spans) {
+        uint32_t from = span.from > edge ? span.from : edge;
+        uint32_t to = span.to ? span.to : r.at;
+
+        on += to > from ? to - from : 0;
+      }
+      if (on != stats.onSec(w)) {
+        *error = "on " + std::to_string(stats.onSec(w)) + " != " + std::to_string(on);
+        return false;
+      }
+
+      for (int k = 0; k < SENSORS; k++) {
+        int lo = 10000, hi = -10000, min, max;
+
+        for (const reading &old : readings) {
+          if (old.at >= edge) {
+            lo = old.t[k] < lo ? old.t[k] : lo;
+            hi = old.t[k] > hi ? old.t[k] : hi;
+          }
+        }
+        if (!stats.min(w, k, &min) || !stats.max(w, k, &max) || min != lo || max != hi) {
+          *error = "window " + std::to_string(w) + " extremes differ";
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+void BM_StatsReading(BenchState &state) {
+  std::vector<reading> readings(READINGS);
+  std::string error;
+  RollingStats stats;
+  bool relay = false, was;
+  size_t i = 0;
+
+  if (!check(&error)) {
+    state.skip(error);
+    return;
+  }
+
+  for (int n = 0; n < READINGS; n++) {
+    makeReading(1000 + n * READ_EACH_SEC, &relay, &readings[n]);
+  }
+  relay = false;
+
+  stats.begin(SENSORS);
+  while (state.keepRunning()) {
+    const reading &r = readings[i % READINGS];
+
+    stats.addReading(r.at + i / READINGS * READINGS * READ_EACH_SEC, r.t);
+    was = relay;
+    relay = r.t[0] < 190 || (relay && r.t[0] <= 210);
+    if (relay != was) {
+      stats.relaySwitched(r.at + i / READINGS * READINGS * READ_EACH_SEC, relay);
+    }
+    i++;
+  }
+
+  state.setItemsProcessed(state.iterations());
+  state.setCounter("state_B", sizeof(RollingStats));
+  state.setCounter("week_cycles", stats.cycles(2));
+}
+BENCH(BM_StatsReading);
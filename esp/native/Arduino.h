@@ -0,0 +1,83 @@
+/*
+  Arduino.h - host stand-in for the Arduino core, see NativeHal.h
+
+  Time is the fake clock of the HAL: millis() only moves by delay() and
+  hal::advance(). Pin functions only remember the last written value.
+*/
+
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <functional>
+
+#include "WString.h"
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define LED_BUILTIN 2
+
+typedef uint8_t byte;
+typedef uint8_t uint8;
+typedef bool boolean;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+
+void configTime(int timezone, int daylightOffset_sec, const char *server1, const char *server2 = nullptr, const char *server3 = nullptr);
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(const uint8_t *buf, size_t len) = 0;
+
+  size_t print(const String &s) { return write((const uint8_t *)s.c_str(), s.length()); }
+  size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  size_t print(char c) { return write((const uint8_t *)&c, 1); }
+  size_t print(int v) { return print(String(v)); }
+  size_t print(unsigned int v) { return print(String(v)); }
+  size_t print(long v) { return print(String(v)); }
+  size_t print(unsigned long v) { return print(String(v)); }
+  size_t print(long long v) { return print(String(v)); }
+  size_t print(double v) { return print(String(v)); }
+
+  template <typename T>
+  size_t println(const T &v) { return print(v) + print("\r\n"); }
+  size_t println() { return print("\r\n"); }
+};
+
+class HardwareSerial : public Print {
+ public:
+  void begin(unsigned long baud) { (void)baud; }
+  size_t write(const uint8_t *buf, size_t len) override;
+};
+
+extern HardwareSerial Serial;
+
+// Heap figures are constants, host heap says nothing about the controller one
+class EspClass {
+ public:
+  uint32_t getFreeHeap() { return 40960; }
+  uint32_t getMaxFreeBlockSize() { return 36864; }
+  uint8_t getHeapFragmentation() { return 10; }
+};
+
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,43 @@
+/*
+  DallasTemperature.h - host stand-in reading the scripted sensor bus, see
+  hal::scriptSensors(). Every requestTemperatures() moves to the next row.
+  Conversion takes the time of the datasheet on the fake clock, which the
+  blocking mode (setWaitForConversion(true), the default) spends at once.
+*/
+
+#ifndef NATIVE_DALLAS_TEMPERATURE_H
+#define NATIVE_DALLAS_TEMPERATURE_H
+
+#include "OneWire.h"
+
+#define DEVICE_DISCONNECTED_C -127
+
+typedef uint8_t DeviceAddress[8];
+
+class DallasTemperature {
+ public:
+  explicit DallasTemperature(OneWire *wire) : _wire(wire) {}
+
+  void begin() {}
+  uint8_t getDeviceCount();
+  bool getAddress(uint8_t *address, uint8_t index);
+  bool validAddress(const uint8_t *address);
+  bool validFamily(const uint8_t *address);
+  void requestTemperatures();
+  bool isConversionComplete();
+  void setWaitForConversion(bool wait) { _wait = wait; }
+  bool getWaitForConversion() const { return _wait; }
+  bool setResolution(const uint8_t *address, uint8_t resolution, bool skipGlobalBitResolutionCalculation = false);
+  uint8_t getResolution(const uint8_t *address);
+  int16_t millisToWaitForConversion(uint8_t resolution);
+  float getTempCByIndex(uint8_t index);
+  float getTempC(const uint8_t *address);
+
+ protected:
+  OneWire *_wire;
+  bool _wait = true;
+  uint8_t _resolution[8] = {12, 12, 12, 12, 12, 12, 12, 12};
+  unsigned long _readyAt = 0;
+};
+
+#endif
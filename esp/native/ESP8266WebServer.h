@@ -0,0 +1,71 @@
+/*
+  ESP8266WebServer.h - in-process stand-in of the web server
+
+  No socket is opened: hal::request() (see NativeHal.h) runs the registered
+  handler for an URI and collects everything it sends into native_response.
+*/
+
+#ifndef NATIVE_ESP8266_WEB_SERVER_H
+#define NATIVE_ESP8266_WEB_SERVER_H
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ESP8266WiFi.h"
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+#define CONTENT_LENGTH_NOT_SET ((size_t)-2)
+
+struct native_response {
+  int code = 0;
+  std::string contentType;
+  std::vector<std::pair<std::string, std::string>> headers;
+  std::string body;
+  size_t contentLength = CONTENT_LENGTH_NOT_SET;
+  bool chunked = false;
+  bool finished = false;  // chunked reply got its terminating chunk
+  size_t sends = 0;       // calls reaching the "socket"
+  std::shared_ptr<native_socket> socket;  // connection of the request, see hal::receive()
+};
+
+class ESP8266WebServer {
+ public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  explicit ESP8266WebServer(int port) : _port(port) {}
+
+  void on(const String &uri, THandlerFunction handler) { _handlers.push_back(std::make_pair(uri, handler)); }
+  void begin() {}
+  void handleClient() {}
+
+  String uri() const { return _uri; }
+  String arg(const String &name) const;
+  bool hasArg(const String &name) const;
+  int args() const { return _args.size(); }
+  void collectHeaders(const char *headerKeys[], const size_t headerKeysCount) { (void)headerKeys, (void)headerKeysCount; }
+  String header(const String &name) const;
+  bool hasHeader(const String &name) const;
+  WiFiClient client() { return WiFiClient(_response.socket); }
+
+  void sendHeader(const String &name, const String &value, bool first = false);
+  void setContentLength(size_t contentLength) { _response.contentLength = contentLength; }
+  void send(int code, const char *contentType, const String &content);
+  void send(int code, const String &contentType, const String &content) { send(code, contentType.c_str(), content); }
+  void sendContent(const char *content, size_t size);
+  void sendContent(const String &content) { sendContent(content.c_str(), content.length()); }
+
+  // Runs the handler of "path?query" with extra request headers, false when no handler found
+  bool dispatch(const char *uri, const std::vector<std::pair<std::string, std::string>> &headers, native_response *response);
+
+ protected:
+  int _port;
+  String _uri;
+  std::vector<std::pair<String, THandlerFunction>> _handlers;
+  std::vector<std::pair<String, String>> _args;
+  std::vector<std::pair<String, String>> _headers;
+  native_response _response;
+};
+
+#endif
@@ -0,0 +1,28 @@
+/*
+  ESP8266WiFi.h - host stand-in, station is always connected to 127.0.0.1
+*/
+
+#ifndef NATIVE_ESP8266_WIFI_H
+#define NATIVE_ESP8266_WIFI_H
+
+#include "Arduino.h"
+#include "WiFiClient.h"
+
+#define WIFI_STA 1
+
+class IPAddress {
+ public:
+  String toString() const { return "127.0.0.1"; }
+};
+
+class ESP8266WiFiClass {
+ public:
+  bool mode(int mode) { return mode == WIFI_STA; }
+  String SSID() const { return "native"; }
+  IPAddress localIP() const { return IPAddress(); }
+  void printDiag(Print &out) { out.println("native wifi"); }
+};
+
+extern ESP8266WiFiClass WiFi;
+
+#endif
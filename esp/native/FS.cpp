@@ -0,0 +1,279 @@
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "FS.h"
+#include "LittleFS.h"
+#include "NativeHal.h"
+
+#define NATIVE_FS_BLOCK 8192
+#define NATIVE_FS_PAGE 256
+
+fs::FS LittleFS;
+
+static std::string fsRoot = ".native_fs";
+static size_t fsTotal = 1024 * 1024;
+
+namespace fs {
+
+struct FileImpl {
+  FILE *fp;
+  std::string path;
+  std::string fullName;
+
+  ~FileImpl() {
+    if (fp)
+      fclose(fp);
+  }
+};
+
+}  // namespace fs
+
+static void makeParents(const std::string &path) {
+  for (size_t pos = fsRoot.size() + 1; (pos = path.find('/', pos)) != std::string::npos; pos++) {
+    ::mkdir(path.substr(0, pos).c_str(), 0755);
+  }
+}
+
+static void removeTree(const std::string &path, bool keepRoot) {
+  DIR *dir = opendir(path.c_str());
+  struct dirent *entry;
+
+  while (dir && (entry = readdir(dir))) {
+    std::string name = entry->d_name;
+    struct stat st;
+
+    if (name == "." || name == "..")
+      continue;
+    if (stat((path + "/" + name).c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+      removeTree(path + "/" + name, false);
+    else
+      unlink((path + "/" + name).c_str());
+  }
+  if (dir)
+    closedir(dir);
+  if (!keepRoot)
+    ::rmdir(path.c_str());
+}
+
+static size_t usedTree(const std::string &path) {
+  DIR *dir = opendir(path.c_str());
+  struct dirent *entry;
+  size_t used = 0;
+
+  while (dir && (entry = readdir(dir))) {
+    std::string name = entry->d_name;
+    struct stat st;
+
+    if (name == "." || name == ".." || stat((path + "/" + name).c_str(), &st) != 0)
+      continue;
+    if (S_ISDIR(st.st_mode))
+      used += NATIVE_FS_BLOCK + usedTree(path + "/" + name);
+    else
+      used += (st.st_size + NATIVE_FS_BLOCK - 1) / NATIVE_FS_BLOCK * NATIVE_FS_BLOCK;
+  }
+  if (dir)
+    closedir(dir);
+  return used;
+}
+
+namespace hal {
+
+void mountFs(const char *root, size_t totalBytes) {
+  fsRoot = root;
+  fsTotal = totalBytes;
+  ::mkdir(fsRoot.c_str(), 0755);
+}
+
+void resizeFs(size_t totalBytes) {
+  fsTotal = totalBytes;
+}
+
+std::string fsPath(const char *path) {
+  return fsRoot + (path[0] == '/' ? "" : "/") + path;
+}
+
+}  // namespace hal
+
+namespace fs {
+
+size_t File::write(const uint8_t *buf, size_t len) {
+  return _impl ? fwrite(buf, 1, len, _impl->fp) : 0;
+}
+
+int File::read() {
+  return _impl ? fgetc(_impl->fp) : -1;
+}
+
+size_t File::read(uint8_t *buf, size_t len) {
+  return _impl ? fread(buf, 1, len, _impl->fp) : 0;
+}
+
+String File::readString() {
+  std::string res;
+  char buf[256];
+  size_t len;
+
+  while ((len = read((uint8_t *)buf, sizeof(buf))) > 0) {
+    res.append(buf, len);
+  }
+  return String(res);
+}
+
+int File::available() {
+  return _impl ? (int)(size() - position()) : 0;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  return _impl && fseek(_impl->fp, pos, mode == SeekSet ? SEEK_SET : mode == SeekCur ? SEEK_CUR : SEEK_END) == 0;
+}
+
+size_t File::position() const {
+  return _impl ? ftell(_impl->fp) : 0;
+}
+
+size_t File::size() const {
+  struct stat st;
+
+  if (!_impl) {
+    return 0;
+  }
+  fflush(_impl->fp);
+  return fstat(fileno(_impl->fp), &st) == 0 ? st.st_size : 0;
+}
+
+bool File::truncate(uint32_t size) {
+  if (!_impl) {
+    return false;
+  }
+  fflush(_impl->fp);
+  return ftruncate(fileno(_impl->fp), size) == 0;
+}
+
+void File::flush() {
+  if (_impl)
+    fflush(_impl->fp);
+}
+
+void File::close() {
+  _impl.reset();
+}
+
+const char *File::name() const {
+  if (!_impl)
+    return "";
+  size_t slash = _impl->fullName.rfind('/');
+  return _impl->fullName.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+
+const char *File::fullName() const {
+  return _impl ? _impl->fullName.c_str() : "";
+}
+
+Dir::Dir(const std::string &path) : _path(path) {
+  DIR *dir = opendir(path.c_str());
+  struct dirent *entry;
+
+  while (dir && (entry = readdir(dir))) {
+    if (entry->d_name[0] != '.')
+      _names.push_back(entry->d_name);
+  }
+  if (dir)
+    closedir(dir);
+  std::sort(_names.begin(), _names.end());  // LittleFS lists entries ordered by name
+}
+
+bool Dir::next() {
+  return ++_index < (int)_names.size();
+}
+
+String Dir::fileName() {
+  return _index >= 0 && _index < (int)_names.size() ? String(_names[_index]) : String();
+}
+
+size_t Dir::fileSize() {
+  struct stat st;
+
+  return _index >= 0 && stat((_path + "/" + _names[_index]).c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+time_t Dir::fileTime() {
+  struct stat st;
+
+  return _index >= 0 && stat((_path + "/" + _names[_index]).c_str(), &st) == 0 ? st.st_mtime : 0;
+}
+
+bool FS::begin() {
+  return ::mkdir(fsRoot.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+bool FS::format() {
+  removeTree(fsRoot, true);
+  return true;
+}
+
+bool FS::info(FSInfo &info) {
+  info.totalBytes = fsTotal;
+  info.usedBytes = 2 * NATIVE_FS_BLOCK + usedTree(fsRoot);
+  info.blockSize = NATIVE_FS_BLOCK;
+  info.pageSize = NATIVE_FS_PAGE;
+  info.maxOpenFiles = 5;
+  info.maxPathLength = 32;
+  return true;
+}
+
+File FS::open(const char *path, const char *mode) {
+  std::string full = hal::fsPath(path);
+  std::string fmode = std::string(mode) + "b";
+  FILE *fp;
+
+  if (mode[0] != 'r') {
+    makeParents(full);
+  }
+  fp = fopen(full.c_str(), fmode.c_str());
+  if (!fp) {
+    return File();
+  }
+
+  std::shared_ptr<FileImpl> impl = std::make_shared<FileImpl>();
+  impl->fp = fp;
+  impl->path = full;
+  impl->fullName = path[0] == '/' ? path + 1 : path;
+
+  return File(impl);
+}
+
+bool FS::exists(const char *path) {
+  struct stat st;
+
+  return stat(hal::fsPath(path).c_str(), &st) == 0;
+}
+
+Dir FS::openDir(const char *path) {
+  return Dir(hal::fsPath(path));
+}
+
+bool FS::remove(const char *path) {
+  return unlink(hal::fsPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char *from, const char *to) {
+  std::string target = hal::fsPath(to);
+
+  makeParents(target);
+  return ::rename(hal::fsPath(from).c_str(), target.c_str()) == 0;
+}
+
+bool FS::mkdir(const char *path) {
+  return ::mkdir(hal::fsPath(path).c_str(), 0755) == 0;
+}
+
+bool FS::rmdir(const char *path) {
+  return ::rmdir(hal::fsPath(path).c_str()) == 0;
+}
+
+}  // namespace fs
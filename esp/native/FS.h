@@ -0,0 +1,112 @@
+/*
+  FS.h - host stand-in for the ESP8266 file system API, backed by a directory
+  of the host (see hal::mountFs()). Paths are mapped below the mount point
+  as is, "conf2" and "/conf2" being the same file like on LittleFS.
+*/
+
+#ifndef NATIVE_FS_H
+#define NATIVE_FS_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+struct FSInfo {
+  size_t totalBytes;
+  size_t usedBytes;
+  size_t blockSize;
+  size_t pageSize;
+  size_t maxOpenFiles;
+  size_t maxPathLength;
+};
+
+struct FileImpl;
+
+class File : public Print {
+ public:
+  File() {}
+  explicit File(std::shared_ptr<FileImpl> impl) : _impl(impl) {}
+
+  size_t write(const uint8_t *buf, size_t len) override;
+  size_t write(uint8_t ch) { return write(&ch, 1); }
+  using Print::print;
+  using Print::println;
+  int read();
+  size_t read(uint8_t *buf, size_t len);
+  size_t readBytes(char *buf, size_t len) { return read((uint8_t *)buf, len); }
+  String readString();
+  int available();
+  bool seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position() const;
+  size_t size() const;
+  bool truncate(uint32_t size);
+  void flush();
+  void close();
+  const char *name() const;
+  const char *fullName() const;
+  operator bool() const { return (bool)_impl; }
+
+ protected:
+  std::shared_ptr<FileImpl> _impl;
+};
+
+class Dir {
+ public:
+  Dir() {}
+  Dir(const std::string &path);
+
+  bool next();
+  String fileName();
+  size_t fileSize();
+  time_t fileTime();
+  bool isFile() const { return true; }
+  bool isDirectory() const { return false; }
+  bool rewind() {
+    _index = -1;
+    return true;
+  }
+
+ protected:
+  std::string _path;
+  std::vector<std::string> _names;
+  int _index = -1;
+};
+
+class FS {
+ public:
+  bool begin();
+  void end() {}
+  bool format();
+  bool info(FSInfo &info);
+  File open(const char *path, const char *mode);
+  File open(const String &path, const char *mode) { return open(path.c_str(), mode); }
+  bool exists(const char *path);
+  bool exists(const String &path) { return exists(path.c_str()); }
+  Dir openDir(const char *path);
+  Dir openDir(const String &path) { return openDir(path.c_str()); }
+  bool remove(const char *path);
+  bool remove(const String &path) { return remove(path.c_str()); }
+  bool rename(const char *from, const char *to);
+  bool rename(const String &from, const String &to) { return rename(from.c_str(), to.c_str()); }
+  bool mkdir(const char *path);
+  bool rmdir(const char *path);
+};
+
+}  // namespace fs
+
+using fs::Dir;
+using fs::File;
+using fs::FS;
+using fs::FSInfo;
+using fs::SeekCur;
+using fs::SeekEnd;
+using fs::SeekMode;
+using fs::SeekSet;
+
+#endif
@@ -0,0 +1,12 @@
+/*
+  LittleFS.h - host stand-in, see FS.h
+*/
+
+#ifndef NATIVE_LITTLEFS_H
+#define NATIVE_LITTLEFS_H
+
+#include "FS.h"
+
+extern fs::FS LittleFS;
+
+#endif
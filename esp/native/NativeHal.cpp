@@ -0,0 +1,380 @@
+#include <stdio.h>
+
+#include <list>
+
+#include "DallasTemperature.h"
+#include "ESP8266WebServer.h"
+#include "ESP8266WiFi.h"
+#include "NativeHal.h"
+#include "Ticker.h"
+#include "coredecls.h"
+
+HardwareSerial Serial;
+EspClass ESP;
+ESP8266WiFiClass WiFi;
+
+static unsigned long fakeMillis = 0;
+static bool serialEcho = false;
+static uint8_t pins[32];
+static std::function<void(void)> timeSyncCallback;
+// Never destroyed: firmware globals detach their tickers from static destructors
+static std::list<Ticker *> &activeTickers = *new std::list<Ticker *>;
+
+static uint8_t sensorsCount = 0;
+static std::vector<std::vector<int>> sensorsScript;
+static size_t sensorsRow = 0;
+
+unsigned long millis() {
+  return fakeMillis;
+}
+
+unsigned long micros() {
+  return fakeMillis * 1000;
+}
+
+void delay(unsigned long ms) {
+  hal::advance(ms);
+}
+
+void yield() {
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  (void)pin, (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  pins[pin % 32] = value;
+}
+
+int digitalRead(uint8_t pin) {
+  return pins[pin % 32];
+}
+
+void analogWrite(uint8_t pin, int value) {
+  pins[pin % 32] = value > 0;
+}
+
+void configTime(int timezone, int daylightOffset_sec, const char *server1, const char *server2, const char *server3) {
+  (void)timezone, (void)daylightOffset_sec, (void)server1, (void)server2, (void)server3;
+}
+
+void settimeofday_cb(std::function<void(void)> cb) {
+  timeSyncCallback = cb;
+}
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t len) {
+  if (serialEcho) {
+    fwrite(buf, 1, len, stderr);
+  }
+  return len;
+}
+
+void Ticker::_arm(uint32_t ms, bool repeat, callback_function_t callback) {
+  detach();
+  _callback = callback;
+  _period = ms ? ms : 1;
+  _repeat = repeat;
+  _next = fakeMillis + _period;
+  _active = true;
+  activeTickers.push_back(this);
+}
+
+void Ticker::detach() {
+  if (_active) {
+    activeTickers.remove(this);
+    _active = false;
+  }
+}
+
+void Ticker::fireDue(unsigned long now) {
+  bool fired = true;
+
+  while (fired) {  // callbacks may re-arm or detach tickers, so restart the scan after each one
+    fired = false;
+    for (Ticker *ticker : activeTickers) {
+      if (ticker->_next <= now) {
+        callback_function_t callback = ticker->_callback;
+
+        if (ticker->_repeat) {
+          ticker->_next += ticker->_period;
+        } else {
+          ticker->detach();
+        }
+        callback();
+        fired = true;
+        break;
+      }
+    }
+  }
+}
+
+uint8_t DallasTemperature::getDeviceCount() {
+  return sensorsCount;
+}
+
+bool DallasTemperature::getAddress(uint8_t *address, uint8_t index) {
+  if (index >= sensorsCount) {
+    return false;
+  }
+  memset(address, 0, 8);
+  address[0] = 0x28;  // DS18B20 family code
+  address[1] = index + 1;
+  address[7] = OneWire::crc8(address, 7);
+  return true;
+}
+
+bool DallasTemperature::validAddress(const uint8_t *address) {
+  return OneWire::crc8(address, 7) == address[7];
+}
+
+bool DallasTemperature::validFamily(const uint8_t *address) {
+  return address[0] == 0x28 || address[0] == 0x10 || address[0] == 0x22 || address[0] == 0x3b || address[0] == 0x42;
+}
+
+bool OneWire::search(uint8_t *address, bool searchMode) {
+  (void)searchMode;
+  return _searchAt < sensorsCount && DallasTemperature(this).getAddress(address, _searchAt++);
+}
+
+uint8_t OneWire::crc8(const uint8_t *data, uint8_t len) {
+  uint8_t crc = 0;
+
+  while (len--) {
+    uint8_t in = *data++;
+
+    for (uint8_t i = 0; i < 8; i++, in >>= 1) {
+      crc = ((crc ^ in) & 1) ? (crc >> 1) ^ 0x8c : crc >> 1;
+    }
+  }
+  return crc;
+}
+
+void DallasTemperature::requestTemperatures() {
+  uint8_t resolution = 9;
+
+  if (!sensorsScript.empty()) {
+    sensorsRow = (sensorsRow + 1) % sensorsScript.size();
+  }
+  for (uint8_t i = 0; i < sensorsCount && i < 8; i++) {
+    resolution = std::max(resolution, _resolution[i]);
+  }
+  _readyAt = fakeMillis + millisToWaitForConversion(resolution);
+  if (_wait) {  // blocking mode stalls the caller like the library does, timers don't run meanwhile
+    fakeMillis = _readyAt;
+  }
+}
+
+bool DallasTemperature::isConversionComplete() {
+  return fakeMillis >= _readyAt;
+}
+
+bool DallasTemperature::setResolution(const uint8_t *address, uint8_t resolution, bool skipGlobalBitResolutionCalculation) {
+  (void)skipGlobalBitResolutionCalculation;
+  if (address[0] != 0x28 || address[1] == 0 || address[1] > 8) {
+    return false;
+  }
+  _resolution[address[1] - 1] = std::min<uint8_t>(12, std::max<uint8_t>(9, resolution));
+  return true;
+}
+
+uint8_t DallasTemperature::getResolution(const uint8_t *address) {
+  return address[0] == 0x28 && address[1] > 0 && address[1] <= 8 ? _resolution[address[1] - 1] : 0;
+}
+
+int16_t DallasTemperature::millisToWaitForConversion(uint8_t resolution) {
+  switch (resolution) {
+    case 9:
+      return 94;
+    case 10:
+      return 188;
+    case 11:
+      return 375;
+  }
+  return 750;
+}
+
+float DallasTemperature::getTempCByIndex(uint8_t index) {
+  if (index >= sensorsCount || sensorsScript.empty() || index >= sensorsScript[sensorsRow].size()) {
+    return DEVICE_DISCONNECTED_C;
+  }
+  return sensorsScript[sensorsRow][index] / 10.0;
+}
+
+float DallasTemperature::getTempC(const uint8_t *address) {
+  return address[0] == 0x28 && address[1] > 0 ? getTempCByIndex(address[1] - 1) : DEVICE_DISCONNECTED_C;
+}
+
+String ESP8266WebServer::arg(const String &name) const {
+  for (const auto &arg : _args) {
+    if (arg.first == name)
+      return arg.second;
+  }
+  return String();
+}
+
+bool ESP8266WebServer::hasArg(const String &name) const {
+  for (const auto &arg : _args) {
+    if (arg.first == name)
+      return true;
+  }
+  return false;
+}
+
+String ESP8266WebServer::header(const String &name) const {
+  for (const auto &header : _headers) {
+    if (strcasecmp(header.first.c_str(), name.c_str()) == 0)
+      return header.second;
+  }
+  return String();
+}
+
+bool ESP8266WebServer::hasHeader(const String &name) const {
+  for (const auto &header : _headers) {
+    if (strcasecmp(header.first.c_str(), name.c_str()) == 0)
+      return true;
+  }
+  return false;
+}
+
+void ESP8266WebServer::sendHeader(const String &name, const String &value, bool first) {
+  auto header = std::make_pair(name.std(), value.std());
+
+  if (first)
+    _response.headers.insert(_response.headers.begin(), header);
+  else
+    _response.headers.push_back(header);
+}
+
+void ESP8266WebServer::send(int code, const char *contentType, const String &content) {
+  _response.code = code;
+  _response.contentType = contentType;
+  _response.chunked = _response.contentLength == CONTENT_LENGTH_UNKNOWN;
+  if (_response.contentLength == CONTENT_LENGTH_NOT_SET) {
+    _response.contentLength = content.length();
+  }
+  _response.body += content.std();
+  _response.sends++;
+}
+
+void ESP8266WebServer::sendContent(const char *content, size_t size) {
+  if (_response.chunked && size == 0) {
+    _response.finished = true;
+  }
+  _response.body.append(content, size);
+  _response.sends++;
+}
+
+static std::string urlDecode(const std::string &text) {
+  std::string res;
+
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] == '%' && i + 2 < text.size()) {
+      res += (char)strtol(text.substr(i + 1, 2).c_str(), nullptr, 16);
+      i += 2;
+    } else {
+      res += text[i] == '+' ? ' ' : text[i];
+    }
+  }
+  return res;
+}
+
+bool ESP8266WebServer::dispatch(const char *uri, const std::vector<std::pair<std::string, std::string>> &headers,
+                                native_response *response) {
+  std::string full(uri);
+  size_t query = full.find('?');
+
+  _uri = full.substr(0, query).c_str();
+  _args.clear();
+  _headers.clear();
+  _response = native_response();
+  _response.socket = std::make_shared<native_socket>();
+
+  if (query != std::string::npos) {
+    std::string rest = full.substr(query + 1);
+    size_t pos = 0;
+
+    while (pos <= rest.size()) {
+      size_t amp = rest.find('&', pos);
+      std::string pair = rest.substr(pos, amp == std::string::npos ? std::string::npos : amp - pos);
+      size_t eq = pair.find('=');
+
+      if (!pair.empty()) {
+        _args.push_back(std::make_pair(String(urlDecode(pair.substr(0, eq))),
+                                       String(eq == std::string::npos ? "" : urlDecode(pair.substr(eq + 1)))));
+      }
+      if (amp == std::string::npos)
+        break;
+      pos = amp + 1;
+    }
+  }
+
+  for (const auto &header : headers) {
+    _headers.push_back(std::make_pair(String(header.first), String(header.second)));
+  }
+
+  for (const auto &handler : _handlers) {
+    if (handler.first == _uri) {
+      handler.second();
+      *response = _response;
+      return true;
+    }
+  }
+
+  response->code = 404;
+  return false;
+}
+
+namespace hal {
+
+void scriptSensors(uint8_t count, const std::vector<std::vector<int>> &rows) {
+  sensorsCount = count;
+  sensorsScript = rows;
+  sensorsRow = 0;
+}
+
+void advance(unsigned long ms) {
+  unsigned long target = fakeMillis + ms;
+
+  for (;;) {  // step deadline by deadline so callbacks see the clock at their own time
+    unsigned long next = target;
+
+    for (Ticker *ticker : activeTickers) {
+      next = std::min(next, ticker->nextAt());
+    }
+    fakeMillis = std::max(fakeMillis, next);
+    Ticker::fireDue(fakeMillis);
+    if (fakeMillis >= target)
+      break;
+  }
+}
+
+void syncTime() {
+  if (timeSyncCallback) {
+    timeSyncCallback();
+  }
+}
+
+native_response request(ESP8266WebServer &server, const char *uri,
+                        const std::vector<std::pair<std::string, std::string>> &headers) {
+  native_response response;
+
+  server.dispatch(uri, headers, &response);
+  return response;
+}
+
+std::string receive(native_response &response) {
+  std::string data;
+
+  if (response.socket) {
+    data.swap(response.socket->sent);
+    response.socket->window = NATIVE_TCP_WINDOW;
+  }
+  return data;
+}
+
+void echoSerial(bool echo) {
+  serialEcho = echo;
+}
+
+}  // namespace hal
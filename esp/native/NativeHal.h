@@ -0,0 +1,48 @@
+/*
+  NativeHal.h - controls of the host platform the firmware runs on in env:native
+
+  The firmware keeps calling the Arduino/ESP8266 API. On the host that API is
+  implemented by the headers of this directory and driven from here:
+    - file system is a directory of the host (mountFs);
+    - sensor bus plays back scripted readings (scriptSensors);
+    - millis() is a fake clock moved only by advance()/delay(), due Tickers
+      fire while it moves; NTP sync is simulated by syncTime();
+    - web server is an in-process stub, request() runs a handler and returns
+      everything it sent.
+*/
+
+#ifndef NATIVE_HAL_H
+#define NATIVE_HAL_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ESP8266WebServer.h"
+
+namespace hal {
+
+// Mounts host directory as LittleFS, FS capacity is reported by FSInfo
+void mountFs(const char *root, size_t totalBytes = 1024 * 1024);
+// Capacity reported from now on, files are kept. Nothing stops writes past it
+void resizeFs(size_t totalBytes);
+std::string fsPath(const char *path);
+
+// Readings in tenths of degree, row per requestTemperatures(), played in a loop
+void scriptSensors(uint8_t count, const std::vector<std::vector<int>> &rows);
+
+void advance(unsigned long ms);
+void syncTime();
+
+native_response request(ESP8266WebServer &server, const char *uri,
+                        const std::vector<std::pair<std::string, std::string>> &headers = {});
+// Bytes written to the connection of a request since the last call (by a handler which took the
+// client over), send window of the connection is free again
+std::string receive(native_response &response);
+
+// Serial output goes to stderr when set, dropped otherwise
+void echoSerial(bool echo);
+
+}  // namespace hal
+
+#endif
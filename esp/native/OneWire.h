@@ -0,0 +1,24 @@
+/*
+  OneWire.h - host stand-in, the bus is scripted through DallasTemperature
+  (see hal::scriptSensors()), search() walks the scripted probes in order.
+*/
+
+#ifndef NATIVE_ONEWIRE_H
+#define NATIVE_ONEWIRE_H
+
+#include "Arduino.h"
+
+class OneWire {
+ public:
+  explicit OneWire(uint8_t pin) : _pin(pin) {}
+
+  void reset_search() { _searchAt = 0; }
+  bool search(uint8_t *address, bool searchMode = true);
+  static uint8_t crc8(const uint8_t *data, uint8_t len);
+
+ protected:
+  uint8_t _pin;
+  uint8_t _searchAt = 0;
+};
+
+#endif
@@ -0,0 +1,2 @@
+// host stand-in: nothing of the SDK header is used by the firmware
+#include "Arduino.h"
@@ -0,0 +1,37 @@
+/*
+  Ticker.h - host stand-in, tickers are fired by the fake clock (hal::advance())
+*/
+
+#ifndef NATIVE_TICKER_H
+#define NATIVE_TICKER_H
+
+#include "Arduino.h"
+
+class Ticker {
+ public:
+  typedef std::function<void(void)> callback_function_t;
+
+  ~Ticker() { detach(); }
+
+  void attach(float seconds, callback_function_t callback) { _arm(seconds * 1000, true, callback); }
+  void attach_ms(uint32_t ms, callback_function_t callback) { _arm(ms, true, callback); }
+  void once(float seconds, callback_function_t callback) { _arm(seconds * 1000, false, callback); }
+  void once_ms(uint32_t ms, callback_function_t callback) { _arm(ms, false, callback); }
+  void detach();
+  bool active() const { return _active; }
+  unsigned long nextAt() const { return _next; }
+
+  // Fires every ticker due at the given fake clock time
+  static void fireDue(unsigned long now);
+
+ protected:
+  void _arm(uint32_t ms, bool repeat, callback_function_t callback);
+
+  callback_function_t _callback;
+  uint32_t _period = 0;
+  unsigned long _next = 0;
+  bool _repeat = false;
+  bool _active = false;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "WString.h"
+
+static std::string formatInteger(unsigned long long value, bool negative, unsigned char base) {
+  char buf[68];
+  int pos = sizeof(buf);
+
+  buf[--pos] = 0;
+  do {
+    int digit = value % base;
+    buf[--pos] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= base;
+  } while (value);
+  if (negative)
+    buf[--pos] = '-';
+
+  return std::string(buf + pos);
+}
+
+static std::string formatFloat(double value, unsigned char decimals) {
+  char buf[48];
+
+  snprintf(buf, sizeof(buf), "%.*f", decimals, value);
+  return buf;
+}
+
+String::String(unsigned char value, unsigned char base) : _s(formatInteger(value, false, base)) {}
+String::String(int value, unsigned char base) : _s(formatInteger(value < 0 && base == 10 ? -(long long)value : (unsigned)value, value < 0 && base == 10, base)) {}
+String::String(unsigned int value, unsigned char base) : _s(formatInteger(value, false, base)) {}
+String::String(long value, unsigned char base) : _s(formatInteger(value < 0 && base == 10 ? -(long long)value : (unsigned long)value, value < 0 && base == 10, base)) {}
+String::String(unsigned long value, unsigned char base) : _s(formatInteger(value, false, base)) {}
+String::String(long long value, unsigned char base) : _s(formatInteger(value < 0 && base == 10 ? -(unsigned long long)value : (unsigned long long)value, value < 0 && base == 10, base)) {}
+String::String(float value, unsigned char decimals) : _s(formatFloat(value, decimals)) {}
+String::String(double value, unsigned char decimals) : _s(formatFloat(value, decimals)) {}
+
+int String::indexOf(char ch, unsigned int from) const {
+  size_t pos = _s.find(ch, from);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::indexOf(const String &str, unsigned int from) const {
+  size_t pos = _s.find(str._s, from);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+  if (from > to) {
+    unsigned int tmp = from;
+    from = to;
+    to = tmp;
+  }
+  if (from >= _s.size()) {
+    return String();
+  }
+  return String(_s.substr(from, to - from));
+}
+
+bool String::endsWith(const String &suffix) const {
+  return _s.size() >= suffix._s.size() && _s.compare(_s.size() - suffix._s.size(), suffix._s.size(), suffix._s) == 0;
+}
+
+long String::toInt() const {
+  return strtol(_s.c_str(), nullptr, 10);
+}
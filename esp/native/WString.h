@@ -0,0 +1,82 @@
+/*
+  WString.h - host stand-in for Arduino String (subset used by the firmware)
+*/
+
+#ifndef NATIVE_WSTRING_H
+#define NATIVE_WSTRING_H
+
+#include <stddef.h>
+
+#include <string>
+
+class String {
+ public:
+  String() {}
+  String(const char *cstr) : _s(cstr ? cstr : "") {}
+  String(const std::string &s) : _s(s) {}
+  explicit String(char c) : _s(1, c) {}
+  explicit String(unsigned char value, unsigned char base = 10);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(long long value, unsigned char base = 10);
+  explicit String(float value, unsigned char decimals = 2);
+  explicit String(double value, unsigned char decimals = 2);
+
+  unsigned int length() const { return _s.size(); }
+  const char *c_str() const { return _s.c_str(); }
+  char charAt(unsigned int index) const { return index < _s.size() ? _s[index] : 0; }
+  char operator[](unsigned int index) const { return charAt(index); }
+  int indexOf(char ch, unsigned int from = 0) const;
+  int indexOf(const String &str, unsigned int from = 0) const;
+  String substring(unsigned int from) const { return from < _s.size() ? String(_s.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const;
+  bool startsWith(const String &prefix) const { return _s.compare(0, prefix._s.size(), prefix._s) == 0; }
+  bool endsWith(const String &suffix) const;
+  long toInt() const;
+  void reserve(unsigned int size) { _s.reserve(size); }
+
+  String &operator+=(const String &rhs) { _s += rhs._s; return *this; }
+  String &operator+=(const char *rhs) { _s += rhs; return *this; }
+  String &operator+=(char rhs) { _s += rhs; return *this; }
+  String &operator+=(int rhs) { return *this += String(rhs); }
+  String &operator+=(unsigned int rhs) { return *this += String(rhs); }
+  String &operator+=(long rhs) { return *this += String(rhs); }
+  String &operator+=(unsigned long rhs) { return *this += String(rhs); }
+  String &operator+=(unsigned char rhs) { return *this += String(rhs); }
+
+  bool operator==(const String &rhs) const { return _s == rhs._s; }
+  bool operator==(const char *rhs) const { return _s == rhs; }
+  bool operator!=(const String &rhs) const { return _s != rhs._s; }
+  bool operator!=(const char *rhs) const { return _s != rhs; }
+  bool operator<(const String &rhs) const { return _s < rhs._s; }
+
+  const std::string &std() const { return _s; }
+
+ protected:
+  std::string _s;
+};
+
+inline String operator+(const String &lhs, const String &rhs) {
+  String res(lhs);
+  res += rhs;
+  return res;
+}
+inline String operator+(const String &lhs, const char *rhs) {
+  String res(lhs);
+  res += rhs;
+  return res;
+}
+inline String operator+(const char *lhs, const String &rhs) {
+  String res(lhs);
+  res += rhs;
+  return res;
+}
+inline String operator+(const String &lhs, char rhs) {
+  String res(lhs);
+  res += rhs;
+  return res;
+}
+
+#endif
@@ -0,0 +1,52 @@
+/*
+  WiFiClient.h - host stand-in, a connection is a native_socket in memory
+
+  Whatever is written stays in the socket till the test reads it with
+  hal::receive(). Send window stands for the free TCP send buffer: write()
+  takes no more than it and the window is given back when the peer reads.
+*/
+
+#ifndef NATIVE_WIFI_CLIENT_H
+#define NATIVE_WIFI_CLIENT_H
+
+#include <memory>
+#include <string>
+
+#include "Arduino.h"
+
+#define NATIVE_TCP_WINDOW 2920  // lwIP send buffer of ESP8266, 2 * MSS
+
+struct native_socket {
+  std::string sent;
+  size_t window = NATIVE_TCP_WINDOW;
+  bool open = true;
+};
+
+class WiFiClient : public Print {
+ public:
+  WiFiClient() {}
+  explicit WiFiClient(std::shared_ptr<native_socket> socket) : _socket(socket) {}
+
+  size_t write(const uint8_t *buf, size_t len) override {
+    if (!connected()) {
+      return 0;
+    }
+    len = std::min(len, _socket->window);  // real write() would wait for the peer instead
+    _socket->sent.append((const char *)buf, len);
+    _socket->window -= len;
+    return len;
+  }
+  size_t availableForWrite() { return connected() ? _socket->window : 0; }
+  uint8_t connected() { return _socket && _socket->open; }
+  void setNoDelay(bool nodelay) { (void)nodelay; }
+  void stop() {
+    if (_socket) {
+      _socket->open = false;
+    }
+  }
+
+ protected:
+  std::shared_ptr<native_socket> _socket;
+};
+
+#endif
@@ -0,0 +1,19 @@
+/*
+  WiFiManager.h - host stand-in, connects at once
+*/
+
+#ifndef NATIVE_WIFI_MANAGER_H
+#define NATIVE_WIFI_MANAGER_H
+
+#include "ESP8266WiFi.h"
+
+class WiFiManager {
+ public:
+  void setConfigPortalTimeout(unsigned long seconds) { (void)seconds; }
+  bool autoConnect(const char *apName) {
+    (void)apName;
+    return true;
+  }
+};
+
+#endif
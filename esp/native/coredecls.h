@@ -0,0 +1,12 @@
+/*
+  coredecls.h - host stand-in, time sync callback is fired by hal::syncTime()
+*/
+
+#ifndef NATIVE_COREDECLS_H
+#define NATIVE_COREDECLS_H
+
+#include "Arduino.h"
+
+void settimeofday_cb(std::function<void(void)> cb);
+
+#endif
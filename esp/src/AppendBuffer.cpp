@@ -0,0 +1,73 @@
+#include <string.h>
+
+#include "AppendBuffer.h"
+#include "LittleFS.h"
+
+AppendBuffer::AppendBuffer(uint8_t *buf, size_t size) : _buf(buf), _bufSize(size), _page(size), _block(size), _flashed(0), _staged(0) {
+}
+
+void AppendBuffer::setGeometry(size_t page, size_t block) {
+  commit();
+  _page = page && page < _bufSize ? page : _bufSize;
+  _block = block ? block : _page;
+}
+
+bool AppendBuffer::open(const String &path) {
+  close();
+
+  _file = LittleFS.open(path, "a");
+  if (!_file) {
+    return false;
+  }
+  _path = path;
+  _flashed = _file.size();
+  return true;
+}
+
+void AppendBuffer::close() {
+  if (_file) {
+    commit();
+    _file.close();
+  }
+  _path = "";
+  _flashed = 0;
+}
+
+void AppendBuffer::discard() {
+  _staged = 0;
+  close();
+}
+
+size_t AppendBuffer::append(const uint8_t *data, size_t len) {
+  if (!_file) {
+    return 0;
+  }
+
+  if (_staged + len < _page) {
+    memcpy(_buf + _staged, data, len);
+    _staged += len;
+    return 0;
+  }
+
+  return write(data, len);
+}
+
+size_t AppendBuffer::commit() {
+  return _file && _staged ? write(nullptr, 0) : 0;
+}
+
+// Staged bytes and data in one commit. Cost: partial last block is copied, new pages are programmed,
+// plus a metadata page.
+size_t AppendBuffer::write(const uint8_t *data, size_t len) {
+  size_t tail = _flashed % _block;
+  size_t written = _file.write(_buf, _staged);
+
+  if (len) {
+    written += _file.write(data, len);
+  }
+  _file.flush();
+
+  _flashed += written;
+  _staged = 0;
+  return (tail + written + _page - 1) / _page * _page + _page;
+}
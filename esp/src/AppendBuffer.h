@@ -0,0 +1,57 @@
+/*
+  AppendBuffer.h - write-back staging of appends to one file
+
+  The file is opened once and kept open across appends, its size is tracked
+  in RAM. Appended bytes are collected in the buffer and go out together in
+  one write and one commit (File::flush()) as soon as a program page worth
+  of them is collected, so the file always ends on an append boundary.
+
+  Each commit of a LittleFS file updates its metadata and copies the partial
+  last block into a fresh one, whatever the amount of new data. Commits are
+  what wears flash and stalls the loop, so append() reports an estimate of
+  bytes programmed by the commit it made.
+*/
+
+#ifndef APPEND_BUFFER_H
+#define APPEND_BUFFER_H
+
+#include "FS.h"
+
+class AppendBuffer {
+ public:
+  AppendBuffer(uint8_t *buf, size_t size);
+
+  // Program page and erase block of the file system, page is capped by the buffer size
+  void setGeometry(size_t page, size_t block);
+  // Opens path for append, anything open before is committed and closed
+  bool open(const String &path);
+  // Commits staged bytes and closes the file
+  void close();
+  // Closes the file, staged bytes are dropped (file is removed or cut behind our back)
+  void discard();
+  // Stages data, when a page is collected it goes out with the staged bytes in one commit.
+  // Returns estimated flash bytes programmed, 0 if data is only staged or the file is not open.
+  size_t append(const uint8_t *data, size_t len);
+  // Writes staged bytes out, same return as append()
+  size_t commit();
+
+  bool isOpen() const { return (bool)_file; }
+  const String &path() const { return _path; }
+  // Bytes in file, staged ones included
+  size_t size() const { return _flashed + _staged; }
+  size_t staged() const { return _staged; }
+
+ protected:
+  size_t write(const uint8_t *data, size_t len);
+
+  File _file;
+  String _path;
+  uint8_t *_buf;
+  size_t _bufSize;
+  size_t _page;
+  size_t _block;
+  size_t _flashed;
+  size_t _staged;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "DataManifest.h"
+
+uint32_t dataFileKey(const String &name) {
+  unsigned long date = 0, n = 0;
+  char back[16];
+
+  if (sscanf(name.c_str(), "%6lu_%3lu", &date, &n) < 1) {
+    return 0;
+  }
+  snprintf(back, sizeof(back), n ? "%06lu_%lu" : "%06lu", date, n);
+  return name == back ? date * 1000 + n : 0;
+}
+
+String dataFileName(uint32_t key) {
+  char name[16];
+
+  snprintf(name, sizeof(name), key % 1000 ? "%06lu_%lu" : "%06lu", (unsigned long)(key / 1000), (unsigned long)(key % 1000));
+  return name;
+}
+
+DataManifest::DataManifest() : _files(nullptr), _count(0), _capacity(0) {
+}
+
+DataManifest::~DataManifest() {
+  free(_files);
+}
+
+bool DataManifest::reserve(size_t capacity) {
+  data_file_info *files;
+
+  if (capacity < _count) {
+    return false;
+  }
+  files = (data_file_info *)realloc(_files, capacity * sizeof(data_file_info));
+  if (!files && capacity) {
+    return false;
+  }
+  _files = files;
+  _capacity = capacity;
+  return true;
+}
+
+void DataManifest::clear() {
+  _count = 0;
+}
+
+bool DataManifest::put(const data_file_info &info) {
+  size_t i = lowerBound(info.key);
+
+  if (i < _count && _files[i].key == info.key) {
+    _files[i] = info;
+    return true;
+  }
+
+  if (_count == _capacity) {
+    if (i == 0) {
+      return false;
+    }
+    memmove(_files, _files + 1, (i - 1) * sizeof(data_file_info));  // the oldest one gives way
+    _files[i - 1] = info;
+    return true;
+  }
+
+  memmove(_files + i + 1, _files + i, (_count - i) * sizeof(data_file_info));
+  _files[i] = info;
+  _count++;
+  return true;
+}
+
+bool DataManifest::remove(uint32_t key) {
+  size_t i = lowerBound(key);
+
+  if (i == _count || _files[i].key != key) {
+    return false;
+  }
+  memmove(_files + i, _files + i + 1, (_count - i - 1) * sizeof(data_file_info));
+  _count--;
+  return true;
+}
+
+data_file_info *DataManifest::find(uint32_t key) {
+  size_t i = lowerBound(key);
+
+  return i < _count && _files[i].key == key ? &_files[i] : nullptr;
+}
+
+size_t DataManifest::lowerBound(uint32_t key) const {
+  size_t lo = 0, hi = _count;
+
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+
+    if (_files[mid].key < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
@@ -0,0 +1,67 @@
+/*
+  DataManifest.h - what is known about data files, kept in RAM
+
+  Entries are built from directory, file headers and indexes once at boot,
+  then kept up to date by the code which creates, appends to and removes
+  data files. Listing, newest file lookup, name generation and searches by
+  stamp or record number are served from here without touching flash.
+
+  Data files are named YYMMDD[_n] (see genFilename()), an entry keeps that
+  name as a number which sorts like the files were started. Entries go in
+  ascending key order. Room is reserved for a file per block of the file
+  system, every data file takes a block of its own at least; if it is
+  still short, the oldest entry gives way.
+*/
+
+#ifndef DATA_MANIFEST_H
+#define DATA_MANIFEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "WString.h"
+
+struct data_file_info {
+  uint32_t key;
+  uint32_t size;     // bytes, staged ones of the current file included
+  uint32_t first;    // stamp of the first record, 0 when there is no record or file is of text era
+  uint32_t last;     // stamp of the last record
+  uint32_t seq;      // number of the first record, see LogFormat.h
+  uint16_t records;
+  uint8_t sealed;    // no more records go there
+  uint8_t binary;    // binary log, stamps and numbers are known
+};
+
+// YYMMDD[_n] name as a key, 0 for other names. Directory lists "_10" before "_2", keys don't
+uint32_t dataFileKey(const String &name);
+String dataFileName(uint32_t key);
+
+class DataManifest {
+ public:
+  DataManifest();
+  ~DataManifest();
+
+  // Room for capacity entries (24 bytes each), entries kept. False when memory is short, room stays as it was
+  bool reserve(size_t capacity);
+  void clear();
+  // Adds entry or replaces the one of the same key, false when it is older than all and there is no room
+  bool put(const data_file_info &info);
+  bool remove(uint32_t key);
+  // nullptr when there is no entry of key. Pointer is good till the next put() or remove()
+  data_file_info *find(uint32_t key);
+
+  size_t count() const { return _count; }
+  // i-th oldest
+  data_file_info *at(size_t i) { return &_files[i]; }
+  data_file_info *newest() { return _count ? &_files[_count - 1] : nullptr; }
+
+ protected:
+  // Position of key, or where it goes
+  size_t lowerBound(uint32_t key) const;
+
+  data_file_info *_files;
+  size_t _count;
+  size_t _capacity;
+};
+
+#endif
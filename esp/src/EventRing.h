@@ -0,0 +1,65 @@
+/*
+  EventRing.h - single-producer/single-consumer ring of fixed capacity
+
+  Producer only calls push() and newest(), consumer calls pop(), peek() and
+  size(). Each side writes its own index only, so producer may run in
+  timer callback context while consumer drains the ring from loop().
+  Capacity must be a power of two.
+*/
+
+#ifndef EVENT_RING_H
+#define EVENT_RING_H
+
+#include <stdint.h>
+
+template <typename T, uint16_t N>
+class EventRing {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "EventRing capacity must be a power of two");
+
+ public:
+  EventRing() : _head(0), _tail(0) {}
+
+  bool push(const T &item) {
+    uint16_t head = _head;
+
+    if ((uint16_t)(head - _tail) >= N) {
+      return false;
+    }
+    _items[head & (N - 1)] = item;
+    __asm__ __volatile__("" ::: "memory");  // item is stored before it is published
+    _head = head + 1;
+    return true;
+  }
+
+  bool pop(T *item) {
+    uint16_t tail = _tail;
+
+    if (tail == _head) {
+      return false;
+    }
+    *item = _items[tail & (N - 1)];
+    __asm__ __volatile__("" ::: "memory");
+    _tail = tail + 1;
+    return true;
+  }
+
+  // i-th oldest item, nullptr when there are fewer items
+  const T *peek(uint16_t i) const {
+    return i < size() ? &_items[(_tail + i) & (N - 1)] : nullptr;
+  }
+
+  // Last pushed item, nullptr for empty ring
+  const T *newest() const {
+    return _head != _tail ? &_items[(_head - 1) & (N - 1)] : nullptr;
+  }
+
+  uint16_t size() const { return _head - _tail; }
+  uint16_t capacity() const { return N; }
+
+ protected:
+  T _items[N];
+  volatile uint16_t _head;
+  volatile uint16_t _tail;
+};
+
+#endif
@@ -0,0 +1,119 @@
+#include <string.h>
+
+#include "EventStream.h"
+
+static const char responseHead[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/event-stream\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: keep-alive\r\n"
+    "Access-Control-Allow-Origin: *\r\n"
+    "\r\n"
+    "retry: 5000\n\n";
+
+EventStream::EventStream() {
+  for (uint8_t i = 0; i < EVENT_STREAM_SLOTS; i++) {
+    _slots[i].used = false;
+    _slots[i].len = 0;
+  }
+}
+
+bool EventStream::subscribe(WiFiClient client) {
+  for (uint8_t i = 0; i < EVENT_STREAM_SLOTS; i++) {
+    slot *s = &_slots[i];
+
+    if (!s->used) {
+      s->client = client;
+      s->client.setNoDelay(true);
+      s->used = true;
+      s->len = 0;
+      queue(s, responseHead, sizeof(responseHead) - 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+uint8_t EventStream::publish(const char *event, const char *data, size_t len) {
+  size_t eventLen = strlen(event);
+  uint8_t dropped = 0;
+
+  for (uint8_t i = 0; i < EVENT_STREAM_SLOTS; i++) {
+    slot *s = &_slots[i];
+
+    if (!s->used) {
+      continue;
+    }
+    if (s->len + 7 + eventLen + 7 + len + 2 > EVENT_STREAM_BUFFER) {  // whole event or nothing
+      drop(s);
+      dropped++;
+      continue;
+    }
+    queue(s, "event: ", 7);
+    queue(s, event, eventLen);
+    queue(s, "\ndata: ", 7);
+    queue(s, data, len);
+    queue(s, "\n\n", 2);
+  }
+  return dropped;
+}
+
+uint8_t EventStream::keepAlive() {
+  uint8_t dropped = 0;
+
+  for (uint8_t i = 0; i < EVENT_STREAM_SLOTS; i++) {
+    if (_slots[i].used && !queue(&_slots[i], ":\n\n", 3)) {
+      drop(&_slots[i]);
+      dropped++;
+    }
+  }
+  return dropped;
+}
+
+void EventStream::pump() {
+  for (uint8_t i = 0; i < EVENT_STREAM_SLOTS; i++) {
+    slot *s = &_slots[i];
+    size_t len;
+
+    if (!s->used) {
+      continue;
+    }
+    if (!s->client.connected()) {
+      drop(s);
+      continue;
+    }
+
+    len = s->client.availableForWrite();
+    len = len < s->len ? len : s->len;
+    if (len > 0) {
+      len = s->client.write(s->buf, len);
+      memmove(s->buf, s->buf + len, s->len - len);
+      s->len -= len;
+    }
+  }
+}
+
+uint8_t EventStream::subscribers() const {
+  uint8_t count = 0;
+
+  for (uint8_t i = 0; i < EVENT_STREAM_SLOTS; i++) {
+    count += _slots[i].used;
+  }
+  return count;
+}
+
+bool EventStream::queue(slot *s, const char *data, size_t len) {
+  if (s->len + len > EVENT_STREAM_BUFFER) {
+    return false;
+  }
+  memcpy(s->buf + s->len, data, len);
+  s->len += len;
+  return true;
+}
+
+void EventStream::drop(slot *s) {
+  s->client.stop();
+  s->client = WiFiClient();
+  s->used = false;
+  s->len = 0;
+}
@@ -0,0 +1,51 @@
+/*
+  EventStream.h - Server-Sent Events to a few subscribers at once
+
+  A subscriber is a slot holding the TCP client taken over from the web
+  server and a buffer of what is not sent to it yet. publish() only copies
+  the event into the buffers, pump() is called from loop() and gives every
+  client as much as its TCP send buffer takes, without waiting. A client
+  whose buffer can't take the next event is too slow and gets dropped,
+  EventSource in the browser reconnects by itself.
+*/
+
+#ifndef EVENT_STREAM_H
+#define EVENT_STREAM_H
+
+#include <WiFiClient.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define EVENT_STREAM_SLOTS 3
+#define EVENT_STREAM_BUFFER 512  // per slot, some events worth
+
+class EventStream {
+ public:
+  EventStream();
+
+  // Takes client of the current request over and queues response head, false when all slots are busy
+  bool subscribe(WiFiClient client);
+  // Queues "event: <event>\ndata: <data>\n\n" to every subscriber, returns how many were dropped
+  uint8_t publish(const char *event, const char *data, size_t len);
+  // Comment line, a dead connection shows up when it is written
+  uint8_t keepAlive();
+  // Sends what clients take without blocking, forgets disconnected ones
+  void pump();
+
+  uint8_t subscribers() const;
+
+ protected:
+  struct slot {
+    WiFiClient client;
+    bool used;
+    uint16_t len;
+    uint8_t buf[EVENT_STREAM_BUFFER];
+  };
+
+  bool queue(slot *s, const char *data, size_t len);
+  void drop(slot *s);
+
+  slot _slots[EVENT_STREAM_SLOTS];
+};
+
+#endif
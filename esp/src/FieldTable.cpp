@@ -0,0 +1,284 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "FieldTable.h"
+
+static long fieldGet(const field_desc *field, const void *object, uint8_t i) {
+  const uint8_t *at = (const uint8_t *)object + field->offset + i * fieldTypeSize(field->type);
+
+  if (field->type == FIELD_I32) {
+    int v;
+    memcpy(&v, at, sizeof(v));
+    return v;
+  }
+  if (field->type == FIELD_U32) {
+    unsigned int v;
+    memcpy(&v, at, sizeof(v));
+    return v;
+  }
+  return *at;
+}
+
+// Value out of the range of the member is clamped to it
+static void fieldSet(const field_desc *field, void *object, uint8_t i, long value) {
+  uint8_t *at = (uint8_t *)object + field->offset + i * fieldTypeSize(field->type);
+
+  if (field->type == FIELD_I32) {
+    int v = value;
+    memcpy(at, &v, sizeof(v));
+  } else if (field->type == FIELD_U32) {
+    unsigned int v = value < 0 ? 0 : value;
+    memcpy(at, &v, sizeof(v));
+  } else {
+    *at = value < 0 ? 0 : value > 255 ? 255 : value;
+  }
+}
+
+static long getValue(const uint8_t *buf, uint8_t type) {
+  uint32_t v = buf[0];
+
+  if (type == FIELD_U8) {
+    return v;
+  }
+  v |= (uint32_t)buf[1] << 8 | (uint32_t)buf[2] << 16 | (uint32_t)buf[3] << 24;
+  return type == FIELD_I32 ? (long)(int32_t)v : (long)v;
+}
+
+static void putValue(uint8_t *buf, uint8_t type, long value) {
+  buf[0] = value & 0xff;
+  if (type != FIELD_U8) {
+    buf[1] = (value >> 8) & 0xff;
+    buf[2] = (value >> 16) & 0xff;
+    buf[3] = (value >> 24) & 0xff;
+  }
+}
+
+size_t fieldsEncode(const field_desc *fields, size_t count, const void *object, uint8_t *buf, size_t size) {
+  size_t len = FIELD_HEADER_SIZE;
+
+  if (size < fieldsEncodedMax(fields, count)) {
+    return 0;
+  }
+
+  buf[0] = FIELD_MAGIC_0;
+  buf[1] = FIELD_MAGIC_1;
+  buf[2] = FIELD_FORMAT_VERSION;
+  for (size_t i = 0; i < count; i++) {
+    const field_desc *field = &fields[i];
+
+    buf[len++] = field->id;
+    buf[len++] = field->type;
+    buf[len++] = field->count;
+    for (uint8_t k = 0; k < field->count; k++) {
+      putValue(buf + len, field->type, fieldGet(field, object, k));
+      len += fieldTypeSize(field->type);
+    }
+  }
+  return len;
+}
+
+bool fieldsDecode(const field_desc *fields, size_t count, void *object, const uint8_t *buf, size_t len) {
+  size_t pos = FIELD_HEADER_SIZE;
+
+  if (len < FIELD_HEADER_SIZE || buf[0] != FIELD_MAGIC_0 || buf[1] != FIELD_MAGIC_1 || buf[2] != FIELD_FORMAT_VERSION) {
+    return false;
+  }
+
+  while (pos + 3 <= len) {
+    uint8_t id = buf[pos], type = buf[pos + 1], values = buf[pos + 2];
+    size_t size = fieldTypeSize(type);
+
+    pos += 3;
+    if (type > FIELD_U8 || pos + values * size > len) {
+      return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+      if (fields[i].id == id) {
+        for (uint8_t k = 0; k < values && k < fields[i].count; k++) {
+          fieldSet(&fields[i], object, k, getValue(buf + pos + k * size, type));
+        }
+        break;
+      }
+    }
+    pos += values * size;
+  }
+  return pos == len;
+}
+
+static const char *skipSpace(const char *p) {
+  while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+    p++;
+  }
+  return p;
+}
+
+// p is at the opening quote, returns past the closing one. Escapes are stepped over, not decoded
+static const char *scanString(const char *p, const char **start, size_t *len) {
+  *start = ++p;
+  while (*p && *p != '"') {
+    p += *p == '\\' && p[1] ? 2 : 1;
+  }
+  if (!*p) {
+    return nullptr;
+  }
+  *len = p - *start;
+  return p + 1;
+}
+
+static const char *skipValue(const char *p, uint8_t depth) {
+  const char *start;
+  size_t len;
+
+  p = skipSpace(p);
+  if (*p == '"') {
+    return scanString(p, &start, &len);
+  }
+  if (*p == '{' || *p == '[') {
+    char close = *p == '{' ? '}' : ']';
+
+    if (depth >= FIELD_JSON_DEPTH_MAX) {
+      return nullptr;
+    }
+    p = skipSpace(p + 1);
+    while (p && *p != close) {
+      if (close == '}') {
+        p = *p == '"' ? scanString(p, &start, &len) : nullptr;
+        p = p ? skipSpace(p) : nullptr;
+        p = p && *p == ':' ? p + 1 : nullptr;
+      }
+      p = p ? skipValue(p, depth + 1) : nullptr;
+      p = p ? skipSpace(p) : nullptr;
+      if (p && *p == ',') {
+        p = skipSpace(p + 1);
+        p = *p != close ? p : nullptr;  // a value must follow the comma
+      } else if (p && *p != close) {
+        return nullptr;
+      }
+    }
+    return p ? p + 1 : nullptr;
+  }
+
+  start = p;
+  while ((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'z') || *p == '-' || *p == '+' || *p == '.' || *p == 'E') {
+    p++;
+  }
+  return p > start ? p : nullptr;
+}
+
+// Number, true/false or a string of a number. *found is false for other values, they are skipped
+static const char *scanScalar(const char *p, long *value, bool *found) {
+  const char *start, *end;
+  size_t len;
+  char *parsed;
+
+  *found = false;
+  p = skipSpace(p);
+  if (strncmp(p, "true", 4) == 0 || strncmp(p, "false", 5) == 0) {
+    *found = true;
+    *value = *p == 't';
+    return p + (*p == 't' ? 4 : 5);
+  }
+  if (*p == '"') {
+    end = scanString(p, &start, &len);
+    if (end && len > 0) {
+      *value = (long)strtod(start, &parsed);
+      *found = parsed == start + len;
+    }
+    return end;
+  }
+  if (*p == '-' || (*p >= '0' && *p <= '9')) {
+    *value = (long)strtod(p, &parsed);
+    *found = parsed > p;
+    return parsed > p ? parsed : nullptr;
+  }
+  return skipValue(p, 0);
+}
+
+static const field_desc *findField(const field_desc *fields, size_t count, const char *name, size_t len) {
+  for (size_t i = 0; i < count; i++) {
+    if (strncmp(fields[i].name, name, len) == 0 && fields[i].name[len] == 0) {
+      return &fields[i];
+    }
+  }
+  return nullptr;
+}
+
+bool fieldsFromJson(const field_desc *fields, size_t count, void *object, const char *json) {
+  const char *p = skipSpace(json);
+
+  if (*p != '{') {
+    return false;
+  }
+  p = skipSpace(p + 1);
+
+  while (*p != '}') {
+    const field_desc *field;
+    const char *name;
+    size_t len;
+    long value;
+    bool found;
+
+    p = *p == '"' ? scanString(p, &name, &len) : nullptr;
+    p = p ? skipSpace(p) : nullptr;
+    if (!p || *p != ':') {
+      return false;
+    }
+    p = skipSpace(p + 1);
+    field = findField(fields, count, name, len);
+
+    if (field && field->count > 1 && *p == '[') {
+      p = skipSpace(p + 1);
+      for (uint8_t k = 0; p && *p != ']'; k++) {
+        p = scanScalar(p, &value, &found);
+        if (p && found && k < field->count) {
+          fieldSet(field, object, k, value);
+        }
+        p = p ? skipSpace(p) : nullptr;
+        if (p && *p == ',') {
+          p = skipSpace(p + 1);
+          if (*p == ']') {
+            return false;
+          }
+        } else if (p && *p != ']') {
+          return false;
+        }
+      }
+      p = p ? p + 1 : nullptr;
+    } else if (field && field->count == 1) {
+      p = scanScalar(p, &value, &found);
+      if (p && found) {
+        fieldSet(field, object, 0, value);
+      }
+    } else {
+      p = skipValue(p, 0);
+    }
+
+    p = p ? skipSpace(p) : nullptr;
+    if (p && *p == ',') {
+      p = skipSpace(p + 1);
+      if (*p == '}') {  // another pair must follow the comma
+        return false;
+      }
+    } else if (!p || *p != '}') {
+      return false;
+    }
+  }
+  return *skipSpace(p + 1) == 0;
+}
+
+void fieldsToJson(const field_desc *fields, size_t count, const void *object, JsonWriter *json) {
+  for (size_t i = 0; i < count; i++) {
+    const field_desc *field = &fields[i];
+
+    json->key(field->name);
+    if (field->count == 1) {
+      json->num(fieldGet(field, object, 0));
+      continue;
+    }
+    json->beginArray();
+    for (uint8_t k = 0; k < field->count; k++) {
+      json->num(fieldGet(field, object, k));
+    }
+    json->endArray();
+  }
+}
@@ -0,0 +1,97 @@
+/*
+  FieldTable.h - plain structs described by a table of their fields, read and written as JSON and binary
+
+  A table has a line per field, FIELD(struct, member, id): JSON key is the
+  member name, id tags the value in binary form and is never reused, type
+  and array length come from the member declaration. Integer members and
+  arrays of them are supported.
+
+  Binary form:
+    'T' 'F' <version> then per field <id:u8> <type:u8> <count:u8> <values, little-endian>
+  Fields of unknown id are skipped, values are converted to the type of the
+  member and arrays of other length are read as far as both go, so data of
+  older and newer firmware is read.
+
+  JSON is an object of the fields, keys not in the table are skipped,
+  numbers in strings and true/false are taken as numbers. Nothing is
+  allocated: JSON is scanned in place, output goes through JsonWriter.
+*/
+
+#ifndef FIELD_TABLE_H
+#define FIELD_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "JsonWriter.h"
+
+#define FIELD_MAGIC_0 'T'
+#define FIELD_MAGIC_1 'F'
+#define FIELD_FORMAT_VERSION 1
+#define FIELD_HEADER_SIZE 3
+#define FIELD_JSON_DEPTH_MAX 8  // nesting of skipped values
+
+enum field_type : uint8_t {
+  FIELD_I32,
+  FIELD_U32,
+  FIELD_U8,
+};
+
+struct field_desc {
+  const char *name;
+  uint8_t id;
+  field_type type;
+  uint8_t count;  // array length, 1 for a plain member
+  uint16_t offset;
+};
+
+template <typename T>
+struct field_traits;
+template <>
+struct field_traits<int> {
+  static constexpr field_type type = FIELD_I32;
+  static constexpr uint8_t count = 1;
+};
+template <>
+struct field_traits<unsigned int> {
+  static constexpr field_type type = FIELD_U32;
+  static constexpr uint8_t count = 1;
+};
+template <>
+struct field_traits<uint8_t> {
+  static constexpr field_type type = FIELD_U8;
+  static constexpr uint8_t count = 1;
+};
+template <typename T, size_t N>
+struct field_traits<T[N]> {
+  static constexpr field_type type = field_traits<T>::type;
+  static constexpr uint8_t count = N;
+};
+
+#define FIELD(object, member, id) \
+  { #member, id, field_traits<decltype(object::member)>::type, field_traits<decltype(object::member)>::count, offsetof(object, member) }
+
+constexpr size_t fieldTypeSize(uint8_t type) {
+  return type == FIELD_U8 ? 1 : 4;
+}
+
+// Bytes binary form of the table takes at most, known at compile time for a constexpr table
+constexpr size_t fieldsEncodedMax(const field_desc *fields, size_t count) {
+  size_t size = FIELD_HEADER_SIZE;
+
+  for (size_t i = 0; i < count; i++) {
+    size += 3 + fields[i].count * fieldTypeSize(fields[i].type);
+  }
+  return size;
+}
+// Binary form of object, 0 if it does not fit
+size_t fieldsEncode(const field_desc *fields, size_t count, const void *object, uint8_t *buf, size_t size);
+// Sets fields found in binary form, false if it is not one
+bool fieldsDecode(const field_desc *fields, size_t count, void *object, const uint8_t *buf, size_t len);
+
+// Sets fields found in JSON object, false if it is malformed (object may be partly set then)
+bool fieldsFromJson(const field_desc *fields, size_t count, void *object, const char *json);
+// Key and value of every field, into the object the writer has open
+void fieldsToJson(const field_desc *fields, size_t count, const void *object, JsonWriter *json);
+
+#endif
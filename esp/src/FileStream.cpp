@@ -0,0 +1,344 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "FileStream.h"
+#include "LittleFS.h"
+
+#define CHUNK_HEAD 6  // "%04x\r\n", a buffer is one chunk
+#define CHUNK_TAIL 2
+#define CHUNK_LAST "0\r\n\r\n"
+
+FileStream::FileStream() {
+  for (uint8_t i = 0; i < FILE_STREAM_SLOTS; i++) {
+    _slots[i].used = false;
+  }
+}
+
+bool FileStream::sendFile(WiFiClient client, File file, const char *contentType, const char *headers, const char *extra) {
+  slot *s = take(client, file);
+
+  if (!s) {
+    return false;
+  }
+
+  s->extra = *extra ? extra : nullptr;
+  s->file.seek(0);
+  head(s, "200 OK", contentType, headers, s->file.size() + strlen(extra));
+  return true;
+}
+
+bool FileStream::sendLog(WiFiClient client, File file, const char *contentType, const char *headers) {
+  slot *s = takeLog(client, file);
+
+  if (!s) {
+    return false;
+  }
+
+  s->chunked = true;
+  head(s, "200 OK", contentType, headers, -1);
+  return true;
+}
+
+bool FileStream::sendFileRange(WiFiClient client, File file, const char *contentType, const char *headers, const char *extra,
+                               uint32_t from, uint32_t length) {
+  slot *s = take(client, file);
+
+  if (!s) {
+    return false;
+  }
+
+  s->extra = *extra ? extra : nullptr;
+  s->file.seek(from);  // from the end of file only extra bytes go
+  s->left = length;
+  head(s, "206 Partial Content", contentType, headers, length);
+  return true;
+}
+
+bool FileStream::sendBatch(WiFiClient client, const char *dir, const String &names, const char *contentType,
+                           const char *headers, const char *extra) {
+  slot *s = take(client, File());
+
+  if (!s) {
+    return false;
+  }
+
+  s->dir = dir;
+  s->names = names;
+  s->extra = extra;
+  s->chunked = true;
+  head(s, "200 OK", contentType, headers, -1);
+  return true;
+}
+
+void FileStream::pump() {
+  for (uint8_t i = 0; i < FILE_STREAM_SLOTS; i++) {
+    slot *s = &_slots[i];
+    size_t len;
+
+    if (!s->used) {
+      continue;
+    }
+    if (!s->client.connected()) {
+      close(s);
+      continue;
+    }
+
+    if (s->pos == s->len) {
+      if (s->done) {
+        close(s);
+        continue;
+      }
+      fill(s);
+    }
+
+    len = s->client.availableForWrite();
+    len = len < (size_t)(s->len - s->pos) ? len : s->len - s->pos;
+    if (len > 0) {
+      s->pos += s->client.write((const uint8_t *)s->buf + s->pos, len);
+      s->sentAt = millis();
+    } else if (millis() - s->sentAt > FILE_STREAM_IDLE_MS) {
+      close(s);
+    }
+  }
+}
+
+void FileStream::abort() {
+  for (uint8_t i = 0; i < FILE_STREAM_SLOTS; i++) {
+    if (_slots[i].used) {
+      close(&_slots[i]);
+    }
+  }
+}
+
+void FileStream::abort(const String &path) {
+  const char *name = path.c_str() + (path[0] == '/');  // fullName() has no leading slash
+
+  for (uint8_t i = 0; i < FILE_STREAM_SLOTS; i++) {
+    if (_slots[i].used && _slots[i].file && !strcmp(_slots[i].file.fullName(), name)) {
+      close(&_slots[i]);
+    }
+  }
+}
+
+bool FileStream::full() const {
+  return active() == FILE_STREAM_SLOTS;
+}
+
+uint8_t FileStream::active() const {
+  uint8_t count = 0;
+
+  for (uint8_t i = 0; i < FILE_STREAM_SLOTS; i++) {
+    count += _slots[i].used;
+  }
+  return count;
+}
+
+FileStream::slot *FileStream::take(WiFiClient client, File file) {
+  for (uint8_t i = 0; i < FILE_STREAM_SLOTS; i++) {
+    slot *s = &_slots[i];
+
+    if (!s->used) {
+      s->client = client;
+      s->file = file;
+      s->extra = nullptr;
+      s->dir = nullptr;
+      s->used = true;
+      s->log = false;
+      s->chunked = false;
+      s->frames = false;
+      s->done = false;
+      s->sentAt = millis();
+      s->left = UINT32_MAX;
+      s->len = s->pos = 0;
+      return s;
+    }
+  }
+  return nullptr;
+}
+
+// Slot of a binary log reply, nullptr when all slots are busy or file is not a binary log
+FileStream::slot *FileStream::takeLog(WiFiClient client, File file) {
+  slot *s = take(client, file);
+
+  if (!s) {
+    return nullptr;
+  }
+
+  if (!s->reader.open(&s->file)) {
+    s->file = File();  // caller may send it in other way
+    s->client = WiFiClient();
+    s->used = false;
+    return nullptr;
+  }
+
+  s->log = true;
+  s->first = true;
+  packedDateReset(&s->cache);
+  return s;
+}
+
+// Length < 0 means chunked reply. Connection is closed after every reply, slot is not kept for the next request
+void FileStream::head(slot *s, const char *status, const char *contentType, const char *headers, long contentLength) {
+  int len = snprintf(s->buf, sizeof(s->buf), "HTTP/1.1 %s\r\nContent-Type: %s\r\n%s", status, contentType, headers);
+
+  if (contentLength >= 0) {
+    len += snprintf(s->buf + len, sizeof(s->buf) - len, "Content-Length: %ld\r\n", contentLength);
+  } else {
+    len += snprintf(s->buf + len, sizeof(s->buf) - len, "Transfer-Encoding: chunked\r\n");
+  }
+  len += snprintf(s->buf + len, sizeof(s->buf) - len, "Connection: close\r\n\r\n");
+
+  s->len = len < (int)sizeof(s->buf) ? len : sizeof(s->buf) - 1;
+}
+
+// Reply with Content-Length: a buffer of the file, cut at the end of the range
+void FileStream::fill(slot *s) {
+  bool over;
+
+  s->pos = 0;
+
+  if (s->chunked) {
+    fillChunk(s);
+    return;
+  }
+
+  s->len = putFile(s, s->buf, s->buf + sizeof(s->buf), &over) - s->buf;
+  if (s->len > s->left) {
+    s->len = s->left;
+  }
+  s->left -= s->len;
+  s->done = over || s->left == 0;
+}
+
+// A buffer is one chunk, the last one goes in the same buffer as the end of reply
+void FileStream::fillChunk(slot *s) {
+  char *out = s->buf + CHUNK_HEAD;
+  char *end = s->buf + sizeof(s->buf) - CHUNK_TAIL - (sizeof(CHUNK_LAST) - 1);
+  char head[CHUNK_HEAD + 1];
+  bool over;
+
+  if (s->dir) {
+    out = putBatch(s, out, end);
+  } else {
+    out = putLog(s, out, end, &over);
+    s->done = over;
+  }
+
+  snprintf(head, sizeof(head), "%04x\r\n", (unsigned)(out - s->buf - CHUNK_HEAD));
+  memcpy(s->buf, head, CHUNK_HEAD);
+  memcpy(out, "\r\n", CHUNK_TAIL);
+  out += CHUNK_TAIL;
+  if (s->done) {
+    memcpy(out, CHUNK_LAST, sizeof(CHUNK_LAST) - 1);
+    out += sizeof(CHUNK_LAST) - 1;
+  }
+  s->len = out - s->buf;
+}
+
+// Bytes of the file as they are, extra bytes once it is over
+char *FileStream::putFile(slot *s, char *out, char *end, bool *over) {
+  size_t len = s->file.read((uint8_t *)out, end - out);
+
+  *over = len == 0;
+  if (*over && s->extra) {
+    len = strlen(s->extra);
+    memcpy(out, s->extra, len);
+  }
+  return out + len;
+}
+
+// Records while the longest one still fits, closing bracket once the log is over
+char *FileStream::putLog(slot *s, char *out, char *end, bool *over) {
+  event_record record;
+
+  *over = false;
+  if (s->first) {
+    *out++ = '[';
+  }
+
+  while (end - out >= LOG_JSON_RECORD_MAX + 2) {  // comma and closing bracket
+    if (!s->reader.next(&record)) {
+      *out++ = ']';
+      *over = true;
+      break;
+    }
+    if (!s->first) {
+      *out++ = ',';
+    }
+    s->first = false;
+    out += logRecordToJson(&record, s->reader.sensors(), &s->cache, out);
+  }
+  return out;
+}
+
+// Frames of batch files while there is room for more than a frame head
+char *FileStream::putBatch(slot *s, char *out, char *end) {
+  bool over;
+
+  if (!s->frames) {  // the first buffer has room for a frame head, at least one is opened
+    *out++ = '[';
+  }
+
+  while (!s->done) {
+    if (!s->file) {
+      if (end - out < FILE_STREAM_FRAME_MAX) {
+        break;
+      }
+      out = openNext(s, out);
+      continue;
+    }
+
+    if (end - out < LOG_JSON_RECORD_MAX + 3) {  // opening bracket too
+      break;
+    }
+    out = s->log ? putLog(s, out, end, &over) : putFile(s, out, end, &over);
+    if (over) {
+      *out++ = '}';
+      s->file.close();
+      s->file = File();
+    }
+  }
+  return out;
+}
+
+// Head of the next frame, end of the array when the list is over
+char *FileStream::openNext(slot *s, char *out) {
+  int comma = s->names.indexOf(',');
+  String name = comma < 0 ? s->names : s->names.substring(0, comma);
+  String path = String(s->dir) + name;
+
+  if (name.length() == 0) {
+    *out++ = ']';
+    s->done = true;
+    return out;
+  }
+  s->names = comma < 0 ? String() : s->names.substring(comma + 1);
+
+  if (s->frames) {
+    *out++ = ',';
+  }
+  s->frames = true;
+
+  s->file = LittleFS.open(path, "r");
+  if (!s->file) {
+    return out + snprintf(out, FILE_STREAM_FRAME_MAX - 1, "{\"n\":\"%s\",\"s\":0,\"d\":null}", name.c_str());
+  }
+
+  s->log = s->reader.open(&s->file);
+  if (!s->log) {
+    s->file.seek(0);
+  }
+  s->first = true;
+  packedDateReset(&s->cache);
+  return out + snprintf(out, FILE_STREAM_FRAME_MAX - 1, "{\"n\":\"%s\",\"s\":%u,\"d\":", name.c_str(), (unsigned)s->file.size());
+}
+
+void FileStream::close(slot *s) {
+  s->client.stop();
+  s->client = WiFiClient();
+  s->file.close();
+  s->file = File();
+  s->names = String();
+  s->used = false;
+  s->len = s->pos = 0;
+}
@@ -0,0 +1,105 @@
+/*
+  FileStream.h - data file replies sent from loop(), a few at once
+
+  A reply is a slot holding the TCP client taken over from the web server,
+  the open file and the part of the reply not sent yet. The handler only
+  queues the response head, pump() gives every client as much as its TCP
+  send buffer takes and reads the next buffer from the file once the client
+  took the previous one. So no more than a buffer per client is prepared in
+  a loop() pass, sensors and relay are served while files go out over Wi-Fi,
+  and a slow client only slows down its own reply.
+
+  Binary data files are converted to JSON array on the way and sent chunked,
+  other files go as they are with Content-Length.
+
+  A range of a file reply goes as 206 with Content-Length, the file is read
+  from the first byte of the range. JSON of a log is known only by converting
+  it from the start, so logs are not sent in ranges.
+
+  A batch sends files of a list one after another in one chunked reply,
+  through the same buffer: a JSON array with a frame per file,
+    {"n":"<name>","s":<bytes on flash>,"d":<what sendLog()/sendFile() send>}
+  Frame of a file that can't be opened has "d":null.
+*/
+
+#ifndef FILE_STREAM_H
+#define FILE_STREAM_H
+
+#include <WiFiClient.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FS.h"
+#include "LogFormat.h"
+#include "LogReader.h"
+#include "WString.h"
+
+#define FILE_STREAM_SLOTS 3
+#define FILE_STREAM_BUFFER 1024     // per slot, some TCP segments
+#define FILE_STREAM_IDLE_MS 10000  // client which takes nothing that long is dropped
+#define FILE_STREAM_FRAME_MAX 64    // batch frame head, {"n":"<name>","s":<size>,"d": with a comma before it
+
+class FileStream {
+ public:
+  FileStream();
+
+  // Takes client over and sends file as it is, extra bytes after it. headers are header lines
+  // ending with CRLF each. False when all slots are busy
+  bool sendFile(WiFiClient client, File file, const char *contentType, const char *headers, const char *extra);
+  // Binary data file as JSON array of records, false when all slots are busy or file is not a binary log
+  bool sendLog(WiFiClient client, File file, const char *contentType, const char *headers);
+  // `length` bytes of what sendFile() sends, starting at byte `from`, as 206 reply. headers have Content-Range
+  bool sendFileRange(WiFiClient client, File file, const char *contentType, const char *headers, const char *extra,
+                     uint32_t from, uint32_t length);
+  // Files of dir named in comma separated list, in one reply. Text files get `extra` after them.
+  // False when all slots are busy
+  bool sendBatch(WiFiClient client, const char *dir, const String &names, const char *contentType, const char *headers,
+                 const char *extra);
+  // Sends what clients take without blocking, refills buffers, finishes complete replies
+  void pump();
+  // Drops every reply, their files are about to be removed
+  void abort();
+  // Drops replies reading the file at path, it is about to be removed. Later files of a batch are not
+  // looked at, the batch sends a null frame for a file which is gone by then
+  void abort(const String &path);
+
+  bool full() const;
+  uint8_t active() const;
+
+ protected:
+  struct slot {
+    WiFiClient client;
+    File file;
+    LogReader reader;
+    packed_date_cache cache;
+    const char *extra;  // still to be sent after file, nullptr when queued
+    const char *dir;    // of batch files, nullptr when it is not a batch
+    String names;       // batch files left, comma separated
+    bool used;
+    bool log;
+    bool chunked;
+    bool first;  // no record is sent yet
+    bool frames;  // a batch frame is sent already
+    bool done;   // buffer holds the end of reply
+    uint32_t sentAt;
+    uint32_t left;  // bytes of the range still to be sent
+    uint16_t len;
+    uint16_t pos;
+    char buf[FILE_STREAM_BUFFER];
+  };
+
+  slot *take(WiFiClient client, File file);
+  slot *takeLog(WiFiClient client, File file);
+  void head(slot *s, const char *status, const char *contentType, const char *headers, long contentLength);
+  void fill(slot *s);
+  void fillChunk(slot *s);
+  char *putFile(slot *s, char *out, char *end, bool *over);
+  char *putLog(slot *s, char *out, char *end, bool *over);
+  char *putBatch(slot *s, char *out, char *end);
+  char *openNext(slot *s, char *out);
+  void close(slot *s);
+
+  slot _slots[FILE_STREAM_SLOTS];
+};
+
+#endif
@@ -0,0 +1,193 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "GzipWriter.h"
+#include "LogCodec.h"
+
+#define MATCH_MIN 3
+#define MATCH_MAX 258
+#define WINDOW_MASK (GZIP_WINDOW - 1)
+
+static const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                          193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                          6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+GzipWriter::GzipWriter() : _state(nullptr) {
+}
+
+bool GzipWriter::begin(sink_t sink, void *ctx) {
+  static const uint8_t header[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff};  // deflate, no name, no mtime, unknown OS
+
+  abort();
+  _state = (state *)malloc(sizeof(state));
+  if (!_state) {
+    return false;
+  }
+  memset(_state->head, 0, sizeof(_state->head));
+
+  _sink = sink;
+  _ctx = ctx;
+  _pos = _end = 0;
+  _crc = 0;
+  _bits = 0;
+  _bitCount = 0;
+  _outLen = 0;
+  _outTotal = 0;
+
+  putBytes(header, sizeof(header));
+  putBits(1, 1);  // the only block is the final one
+  putBits(1, 2);  // fixed Huffman code
+  return true;
+}
+
+void GzipWriter::abort() {
+  free(_state);
+  _state = nullptr;
+}
+
+void GzipWriter::write(const uint8_t *data, size_t len) {
+  while (len > 0) {
+    size_t room = GZIP_WINDOW - GZIP_DISTANCE_MAX - (_end - _pos);
+    size_t n = len < room ? len : room;
+
+    _crc = logCrc32(data, n, _crc);
+    for (size_t i = 0; i < n; i++) {
+      _state->window[(_end + i) & WINDOW_MASK] = data[i];
+    }
+    _end += n;
+    data += n;
+    len -= n;
+
+    compress(false);
+  }
+}
+
+void GzipWriter::finish() {
+  uint8_t trailer[8];
+
+  compress(true);
+  putLiteral(256);  // end of block
+  if (_bitCount) {
+    putBits(0, 8 - _bitCount);
+  }
+
+  for (int i = 0; i < 4; i++) {
+    trailer[i] = (_crc >> (i * 8)) & 0xff;
+    trailer[4 + i] = (_end >> (i * 8)) & 0xff;
+  }
+  putBytes(trailer, sizeof(trailer));
+  flushOut();
+  abort();
+}
+
+static uint16_t hash3(const uint8_t *window, uint32_t pos) {
+  return ((window[pos & WINDOW_MASK] << 6) ^ (window[(pos + 1) & WINDOW_MASK] << 3) ^ window[(pos + 2) & WINDOW_MASK]) & (GZIP_HASH_SIZE - 1);
+}
+
+uint16_t GzipWriter::matchLength(uint32_t distance, uint32_t avail) const {
+  const uint8_t *window = _state->window;
+  uint16_t len = 0;
+
+  while (len < avail && window[(_pos - distance + len) & WINDOW_MASK] == window[(_pos + len) & WINDOW_MASK]) {
+    len++;
+  }
+  return len;
+}
+
+// Greedy parse; until flush a match is only looked for with full lookahead behind it
+void GzipWriter::compress(bool flush) {
+  while (_end - _pos >= (flush ? 1 : MATCH_MAX)) {
+    uint32_t avail = _end - _pos < MATCH_MAX ? _end - _pos : MATCH_MAX;
+    uint16_t len = 0, distance = 0;
+
+    if (avail >= MATCH_MIN) {
+      uint16_t h = hash3(_state->window, _pos);
+
+      distance = (uint16_t)((uint16_t)_pos - _state->head[h]);
+      _state->head[h] = (uint16_t)_pos;
+      if (distance > 0 && distance <= GZIP_DISTANCE_MAX && distance <= _pos) {
+        len = matchLength(distance, avail);
+      }
+    }
+
+    if (len >= MATCH_MIN) {
+      putMatch(len, distance);
+      for (uint16_t i = 1; i < len && _pos + i + MATCH_MIN <= _end; i++) {
+        _state->head[hash3(_state->window, _pos + i)] = (uint16_t)(_pos + i);
+      }
+      _pos += len;
+    } else {
+      putLiteral(_state->window[_pos & WINDOW_MASK]);
+      _pos++;
+    }
+  }
+}
+
+void GzipWriter::putBits(uint32_t value, uint8_t count) {
+  _bits |= value << _bitCount;
+  _bitCount += count;
+  while (_bitCount >= 8) {
+    _state->out[_outLen++] = _bits & 0xff;
+    _bits >>= 8;
+    _bitCount -= 8;
+    if (_outLen == GZIP_OUT_SIZE) {
+      flushOut();
+    }
+  }
+}
+
+// Huffman codes go most significant bit first, unlike the rest of the stream
+void GzipWriter::putCode(uint16_t code, uint8_t len) {
+  uint16_t reversed = 0;
+
+  for (uint8_t i = 0; i < len; i++) {
+    reversed = (reversed << 1) | ((code >> i) & 1);
+  }
+  putBits(reversed, len);
+}
+
+void GzipWriter::putLiteral(uint16_t symbol) {
+  if (symbol < 144) {
+    putCode(0x30 + symbol, 8);
+  } else if (symbol < 256) {
+    putCode(0x190 + symbol - 144, 9);
+  } else if (symbol < 280) {
+    putCode(symbol - 256, 7);
+  } else {
+    putCode(0xc0 + symbol - 280, 8);
+  }
+}
+
+void GzipWriter::putMatch(uint16_t length, uint16_t distance) {
+  uint8_t i = 28, k = 29;
+
+  while (lengthBase[i] > length) {
+    i--;
+  }
+  putLiteral(257 + i);
+  putBits(length - lengthBase[i], lengthExtra[i]);
+
+  while (distanceBase[--k] > distance)
+    ;
+  putCode(k, 5);
+  putBits(distance - distanceBase[k], distanceExtra[k]);
+}
+
+void GzipWriter::putBytes(const uint8_t *data, size_t len) {
+  while (len--) {
+    putBits(*data++, 8);
+  }
+}
+
+void GzipWriter::flushOut() {
+  if (_outLen) {
+    _sink(_state->out, _outLen, _ctx);
+    _outTotal += _outLen;
+    _outLen = 0;
+  }
+}
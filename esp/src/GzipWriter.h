@@ -0,0 +1,70 @@
+/*
+  GzipWriter.h - gzip stream compressed on the fly, written through a sink
+
+  Deflate with the fixed Huffman code (one block for the whole stream) and
+  greedy LZ77 matches found by a 3-byte hash over a small window: it takes
+  far less RAM than zlib and is still good at repetitive text like JSON of
+  data files. Window and output buffer are allocated by begin() and freed
+  by finish()/abort(), so the writer costs nothing between streams. Input
+  may come in pieces of any size.
+*/
+
+#ifndef GZIP_WRITER_H
+#define GZIP_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GZIP_WINDOW 2048                    // ring of input, power of two
+#define GZIP_DISTANCE_MAX (GZIP_WINDOW / 2)  // the other half is lookahead
+#define GZIP_HASH_SIZE 512
+#define GZIP_OUT_SIZE 128
+
+class GzipWriter {
+ public:
+  typedef void (*sink_t)(const uint8_t *data, size_t len, void *ctx);
+
+  GzipWriter();
+  ~GzipWriter() { abort(); }
+
+  // Writes gzip header, false if there is no memory for the window
+  bool begin(sink_t sink, void *ctx);
+  void write(const uint8_t *data, size_t len);
+  // Compresses the rest, writes trailer and frees memory
+  void finish();
+  // Frees memory, stream is left unfinished
+  void abort();
+
+  bool active() const { return _state != nullptr; }
+  uint32_t inSize() const { return _end; }
+  uint32_t outSize() const { return _outTotal; }
+
+ protected:
+  struct state {
+    uint8_t window[GZIP_WINDOW];
+    uint16_t head[GZIP_HASH_SIZE];  // low 16 bits of the last position of a hash, matches are checked anyway
+    uint8_t out[GZIP_OUT_SIZE];
+  };
+
+  void compress(bool flush);
+  uint16_t matchLength(uint32_t distance, uint32_t avail) const;
+  void putBits(uint32_t value, uint8_t count);
+  void putCode(uint16_t code, uint8_t len);
+  void putLiteral(uint16_t symbol);
+  void putMatch(uint16_t length, uint16_t distance);
+  void putBytes(const uint8_t *data, size_t len);
+  void flushOut();
+
+  state *_state;
+  sink_t _sink;
+  void *_ctx;
+  uint32_t _pos;  // next input byte to compress
+  uint32_t _end;  // input taken so far
+  uint32_t _crc;
+  uint32_t _bits;
+  uint8_t _bitCount;
+  uint16_t _outLen;
+  uint32_t _outTotal;
+};
+
+#endif
@@ -0,0 +1,166 @@
+#include <string.h>
+
+#include "JsonWriter.h"
+
+JsonWriter::JsonWriter(char *buf, size_t size, sink_t sink)
+    : _buf(buf), _size(size), _len(0), _written(0), _sink(sink), _needComma(0), _depth(0) {
+}
+
+void JsonWriter::flush() {
+  if (_len) {
+    _sink(_buf, _len);
+    _written += _len;
+    _len = 0;
+  }
+}
+
+void JsonWriter::end() {
+  flush();
+  _sink(_buf, 0);
+}
+
+char *JsonWriter::reserve(size_t len) {
+  if (_len + len > _size) {
+    flush();
+  }
+  return _buf + _len;
+}
+
+void JsonWriter::put(char ch) {
+  *reserve(1) = ch;
+  _len++;
+}
+
+void JsonWriter::separate() {
+  uint32_t bit = 1UL << (_depth & 31);
+
+  if (_needComma & bit) {
+    put(',');
+  }
+  _needComma |= bit;
+}
+
+JsonWriter &JsonWriter::raw(const char *text, size_t len) {
+  while (len) {
+    size_t part = len < _size ? len : _size;
+
+    memcpy(reserve(part), text, part);
+    _len += part;
+    text += part;
+    len -= part;
+  }
+  return *this;
+}
+
+JsonWriter &JsonWriter::raw(const char *text) {
+  return raw(text, strlen(text));
+}
+
+JsonWriter &JsonWriter::beginObject() {
+  separate();
+  put('{');
+  _depth++;
+  _needComma &= ~(1UL << (_depth & 31));
+  return *this;
+}
+
+JsonWriter &JsonWriter::endObject() {
+  _depth--;
+  put('}');
+  return *this;
+}
+
+JsonWriter &JsonWriter::beginArray() {
+  separate();
+  put('[');
+  _depth++;
+  _needComma &= ~(1UL << (_depth & 31));
+  return *this;
+}
+
+JsonWriter &JsonWriter::endArray() {
+  _depth--;
+  put(']');
+  return *this;
+}
+
+JsonWriter &JsonWriter::key(const char *name) {
+  separate();
+  put('"');
+  raw(name);
+  put('"');
+  put(':');
+  _needComma &= ~(1UL << (_depth & 31));  // value that follows goes without comma
+  return *this;
+}
+
+JsonWriter &JsonWriter::num(long value) {
+  char tmp[12];
+  size_t len = 0;
+  unsigned long v = value < 0 ? -(unsigned long)value : value;
+
+  separate();
+  do {
+    tmp[len++] = '0' + v % 10;
+    v /= 10;
+  } while (v);
+  if (value < 0)
+    put('-');
+  while (len)
+    put(tmp[--len]);
+
+  return *this;
+}
+
+JsonWriter &JsonWriter::num(float value, uint8_t decimals) {
+  long scale = 1, scaled, whole, frac;
+
+  for (uint8_t i = 0; i < decimals; i++)
+    scale *= 10;
+
+  scaled = (long)(value * scale + (value < 0 ? -0.5f : 0.5f));
+  whole = scaled / scale;
+  frac = scaled % scale;
+
+  if (scaled < 0 && whole == 0) {
+    separate();
+    put('-');
+    _needComma &= ~(1UL << (_depth & 31));
+  }
+  num(whole);
+
+  if (decimals) {
+    put('.');
+    frac = frac < 0 ? -frac : frac;
+    for (long div = scale / 10; div > 0; div /= 10) {
+      put('0' + (frac / div) % 10);
+    }
+  }
+  return *this;
+}
+
+JsonWriter &JsonWriter::str(const char *value) {
+  separate();
+  put('"');
+  for (; *value; value++) {
+    if (*value == '"' || *value == '\\')
+      put('\\');
+    put(*value);
+  }
+  put('"');
+  return *this;
+}
+
+JsonWriter &JsonWriter::null() {
+  separate();
+  return raw("null");
+}
+
+char *JsonWriter::value(size_t len) {
+  separate();
+  return reserve(len);
+}
+
+void JsonWriter::commit(size_t len) {
+  _len += len;
+}
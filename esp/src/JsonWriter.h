@@ -0,0 +1,58 @@
+/*
+  JsonWriter.h - JSON output streamed through a fixed buffer
+
+  Nothing is allocated: text is collected in the buffer given to constructor
+  and handed to the sink each time the buffer is full. Sink is called with
+  zero length once by end(), which terminates a chunked HTTP response.
+  Commas between values are inserted automatically.
+*/
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class JsonWriter {
+ public:
+  typedef void (*sink_t)(const char *data, size_t len);
+
+  JsonWriter(char *buf, size_t size, sink_t sink);
+
+  JsonWriter &beginObject();
+  JsonWriter &endObject();
+  JsonWriter &beginArray();
+  JsonWriter &endArray();
+  JsonWriter &key(const char *name);
+  JsonWriter &num(long value);
+  JsonWriter &num(float value, uint8_t decimals);
+  JsonWriter &str(const char *value);
+  JsonWriter &null();
+  // Text written as is, no comma is added
+  JsonWriter &raw(const char *text);
+  JsonWriter &raw(const char *text, size_t len);
+
+  // Room for one value of up to len bytes (comma is added if needed), fill it and commit()
+  char *value(size_t len);
+  void commit(size_t len);
+
+  void flush();
+  void end();
+
+  size_t written() const { return _written + _len; }
+
+ protected:
+  void separate();
+  void put(char ch);
+  char *reserve(size_t len);
+
+  char *_buf;
+  size_t _size;
+  size_t _len;
+  size_t _written;
+  sink_t _sink;
+  uint32_t _needComma;  // bit per nesting level
+  uint8_t _depth;
+};
+
+#endif
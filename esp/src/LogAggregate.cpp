@@ -0,0 +1,193 @@
+#include <string.h>
+
+#include "LogAggregate.h"
+
+static uint32_t bucketStep(uint32_t from, uint32_t to, uint16_t points) {
+  points = points ? points : 1;
+  return (to - from) / points + 1;
+}
+
+static float recordMean(const event_record *record, uint8_t sensors) {
+  long sum = 0;
+
+  for (uint8_t k = 0; k < sensors; k++) {
+    sum += record->t[k];
+  }
+  return sensors ? (float)sum / sensors : 0;
+}
+
+void LogAggregator::begin(uint32_t from, uint32_t to, uint16_t points, sink_t sink, void *ctx) {
+  _from = from;
+  _to = to;
+  _step = bucketStep(from, to, points);
+  _cursor = 0;
+  _started = false;
+  _relayOn = false;
+  _sink = sink;
+  _ctx = ctx;
+}
+
+void LogAggregator::reset(uint32_t start) {
+  memset(&_bucket, 0, sizeof(_bucket));
+  _bucket.start = start;
+}
+
+void LogAggregator::account(uint32_t until) {
+  if (until > _cursor) {
+    _bucket.span += until - _cursor;
+    if (_relayOn) {
+      _bucket.on += until - _cursor;
+    }
+    _cursor = until;
+  }
+}
+
+void LogAggregator::add(const event_record *record, uint8_t sensors) {
+  uint32_t stamp = (uint32_t)record->stamp;
+
+  if (stamp > _to) {
+    return;
+  }
+
+  if (stamp >= _from) {
+    uint32_t start = _from + (stamp - _from) / _step * _step;
+
+    if (!_started) {
+      reset(start);
+      _cursor = _cursor ? start : stamp;  // relay state at `from` is known if older records were seen
+      _started = true;
+    } else if (start > _bucket.start) {
+      account(_bucket.start + _step);
+      _sink(&_bucket, _ctx);
+      reset(start);
+      _cursor = start;  // empty buckets in between are skipped
+    }
+
+    account(stamp);  // no-op for a record older than the bucket, it is counted into the bucket anyway
+
+    if (record->event != 'b') {
+      for (uint8_t k = 0; k < sensors; k++) {
+        if (!_bucket.count || record->t[k] < _bucket.min[k])
+          _bucket.min[k] = record->t[k];
+        if (!_bucket.count || record->t[k] > _bucket.max[k])
+          _bucket.max[k] = record->t[k];
+        _bucket.sum[k] += record->t[k];
+      }
+      _bucket.sensors = sensors > _bucket.sensors ? sensors : _bucket.sensors;
+      _bucket.count++;
+    }
+  } else {
+    _cursor = stamp;
+  }
+
+  if (record->event == 'n') {
+    _relayOn = true;
+  } else if (record->event == 'f' || record->event == 'b') {  // relay is off after boot
+    _relayOn = false;
+  }
+}
+
+void LogAggregator::finish() {
+  if (_started) {
+    _sink(&_bucket, _ctx);
+    _started = false;
+  }
+}
+
+void LogLttb::begin(uint32_t from, uint32_t to, uint16_t points, lttb_point *averages) {
+  _from = from;
+  _to = to;
+  _points = points ? points : 1;
+  _step = bucketStep(from, to, _points);
+  _avg = averages;
+  memset(_avg, 0, sizeof(lttb_point) * _points);
+}
+
+uint16_t LogLttb::bucketOf(uint32_t stamp) const {
+  uint32_t i = (stamp - _from) / _step;
+
+  return i < _points ? i : _points - 1;
+}
+
+void LogLttb::average(const event_record *record, uint8_t sensors) {
+  uint32_t stamp = (uint32_t)record->stamp;
+  lttb_point *point;
+
+  if (stamp < _from || stamp > _to || record->event == 'b') {
+    return;
+  }
+
+  point = &_avg[bucketOf(stamp)];
+  point->x += stamp - _from;
+  point->y += recordMean(record, sensors);
+  point->count++;
+}
+
+void LogLttb::beginSelect(sink_t sink, void *ctx) {
+  const lttb_point *next = nullptr;
+
+  for (int i = _points - 1; i >= 0; i--) {
+    lttb_point *point = &_avg[i];
+
+    if (point->count) {
+      point->x /= point->count;
+      point->y /= point->count;
+      point->count = 1;
+      next = point;
+    } else if (next) {  // empty bucket looks ahead to the next non-empty one
+      *point = *next;
+    }
+  }
+
+  _sink = sink;
+  _ctx = ctx;
+  _hasBest = false;
+  _current = 0;
+  _ax = _avg[0].x;
+  _ay = _avg[0].y;
+}
+
+void LogLttb::select(const event_record *record, uint8_t sensors) {
+  uint32_t stamp = (uint32_t)record->stamp;
+  uint16_t bucket;
+  const lttb_point *c;
+  float x, y, area;
+
+  if (stamp < _from || stamp > _to || record->event == 'b') {
+    return;
+  }
+
+  bucket = bucketOf(stamp);
+  if (_hasBest && bucket > _current) {
+    emit();
+  }
+  if (!_hasBest) {
+    _current = bucket > _current ? bucket : _current;
+  }
+
+  c = _current + 1 < _points && _avg[_current + 1].count ? &_avg[_current + 1] : &_avg[_current];
+  x = stamp - _from;
+  y = recordMean(record, sensors);
+  area = (_ax - c->x) * (y - _ay) - (_ax - x) * (c->y - _ay);
+  area = area < 0 ? -area : area;
+
+  if (!_hasBest || area > _bestArea) {
+    _best = *record;
+    _bestSensors = sensors;
+    _bestArea = area;
+    _hasBest = true;
+  }
+}
+
+void LogLttb::emit() {
+  _sink(&_best, _bestSensors, _ctx);
+  _ax = (uint32_t)_best.stamp - _from;
+  _ay = recordMean(&_best, _bestSensors);
+  _hasBest = false;
+}
+
+void LogLttb::finish() {
+  if (_hasBest) {
+    emit();
+  }
+}
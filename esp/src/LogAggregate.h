@@ -0,0 +1,102 @@
+/*
+  LogAggregate.h - downsampling of the event log for charts
+
+  Range [from, to] is split into equal buckets. Records must come in time
+  order (as data files are scanned), so both classes keep only a constant
+  state besides what the caller gives them:
+
+  LogAggregator reduces every bucket to min/max/avg of each sensor and the
+  share of time relay was on, handing each bucket to the sink as soon as the
+  first record of a later bucket arrives. Records older than `from` only tell
+  the relay state at `from`.
+
+  LogLttb selects one real record per bucket with Largest-Triangle-Three-
+  Buckets over the mean of the sensors. It takes two passes over the range:
+  the first one collects bucket averages into caller's array of `points`
+  lttb_point, the second one picks the records.
+*/
+
+#ifndef LOG_AGGREGATE_H
+#define LOG_AGGREGATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "LogFormat.h"
+
+struct log_bucket {
+  uint32_t start;
+  uint16_t count;  // records with temperatures
+  uint8_t sensors;
+  uint32_t span;   // seconds between records seen in the bucket, relay state is known for them
+  uint32_t on;     // seconds of span relay was on
+  int min[MAX_SENSORS_COUNT];
+  int max[MAX_SENSORS_COUNT];
+  long sum[MAX_SENSORS_COUNT];
+};
+
+struct lttb_point {
+  float x;  // seconds from `from`
+  float y;
+  uint16_t count;
+};
+
+class LogAggregator {
+ public:
+  typedef void (*sink_t)(const log_bucket *bucket, void *ctx);
+
+  void begin(uint32_t from, uint32_t to, uint16_t points, sink_t sink, void *ctx);
+  void add(const event_record *record, uint8_t sensors);
+  // Hands the last bucket to the sink
+  void finish();
+
+  uint32_t step() const { return _step; }
+
+ protected:
+  void account(uint32_t until);
+  void reset(uint32_t start);
+
+  uint32_t _from;
+  uint32_t _to;
+  uint32_t _step;
+  uint32_t _cursor;  // relay time is accounted till here
+  bool _started;
+  bool _relayOn;
+  sink_t _sink;
+  void *_ctx;
+  log_bucket _bucket;
+};
+
+class LogLttb {
+ public:
+  typedef void (*sink_t)(const event_record *record, uint8_t sensors, void *ctx);
+
+  void begin(uint32_t from, uint32_t to, uint16_t points, lttb_point *averages);
+  // First pass
+  void average(const event_record *record, uint8_t sensors);
+  // Second pass, selected records go to the sink
+  void beginSelect(sink_t sink, void *ctx);
+  void select(const event_record *record, uint8_t sensors);
+  void finish();
+
+ protected:
+  uint16_t bucketOf(uint32_t stamp) const;
+  void emit();
+
+  uint32_t _from;
+  uint32_t _to;
+  uint32_t _step;
+  uint16_t _points;
+  lttb_point *_avg;
+  sink_t _sink;
+  void *_ctx;
+  uint16_t _current;
+  bool _hasBest;
+  float _bestArea;
+  float _ax;
+  float _ay;
+  uint8_t _bestSensors;
+  event_record _best;
+};
+
+#endif
@@ -0,0 +1,233 @@
+#include <string.h>
+
+#include "LogCodec.h"
+
+static const char eventCodes[4] = {'t', 'n', 'f', 'b'};
+
+static uint8_t eventToCode(char event) {
+  switch (event) {
+    case 'n':
+      return 1;
+    case 'f':
+      return 2;
+    case 'b':
+      return 3;
+  }
+  return 0;
+}
+
+static size_t putVarint(uint8_t *buf, int32_t value) {
+  uint32_t zz = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+  size_t len = 0;
+
+  while (zz >= 0x80) {
+    buf[len++] = (uint8_t)(zz | 0x80);
+    zz >>= 7;
+  }
+  buf[len++] = (uint8_t)zz;
+
+  return len;
+}
+
+static int clampTemp(int value) {
+  return value > INT16_MAX ? INT16_MAX : (value < INT16_MIN ? INT16_MIN : value);
+}
+
+static void putU32(uint8_t *buf, uint32_t value) {
+  buf[0] = value & 0xff;
+  buf[1] = (value >> 8) & 0xff;
+  buf[2] = (value >> 16) & 0xff;
+  buf[3] = (value >> 24) & 0xff;
+}
+
+static uint32_t getU32(const uint8_t *buf) {
+  return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+// Half-byte table keeps it at 64 bytes of flash
+static const uint32_t crcTable[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c};
+
+uint32_t logCrc32(const uint8_t *data, size_t len, uint32_t crc) {
+  crc = ~crc;
+  while (len--) {
+    crc ^= *data++;
+    crc = (crc >> 4) ^ crcTable[crc & 0x0f];
+    crc = (crc >> 4) ^ crcTable[crc & 0x0f];
+  }
+  return ~crc;
+}
+
+bool logChunkHeaderDecode(const uint8_t *buf, log_chunk_header *header) {
+  header->size = buf[0] | (buf[1] << 8);
+  header->count = buf[2] | (buf[3] << 8);
+  header->flags = buf[4];
+  header->base = getU32(buf + 5);
+
+  return header->count > 0 && !(header->flags & ~LOG_CHUNK_FLAGS_KNOWN) && logChunkSize(header) <= LOG_CHUNK_MAX;
+}
+
+size_t logChunkSize(const log_chunk_header *header) {
+  return LOG_CHUNK_HEADER_SIZE + header->size + (header->flags & LOG_CHUNK_FLAG_CRC ? LOG_CHUNK_CRC_SIZE : 0);
+}
+
+bool logChunkVerify(const uint8_t *buf, const log_chunk_header *header) {
+  size_t len = LOG_CHUNK_HEADER_SIZE + header->size;
+
+  return !(header->flags & LOG_CHUNK_FLAG_CRC) || logCrc32(buf, len) == getU32(buf + len);
+}
+
+void LogChunkEncoder::begin(uint8_t *buf, size_t capacity, uint8_t sensors) {
+  _buf = buf;
+  _capacity = capacity > LOG_CHUNK_MAX ? LOG_CHUNK_MAX : capacity;
+  _size = LOG_CHUNK_HEADER_SIZE;
+  _groupAt = 0;
+  _count = 0;
+  _sensors = sensors;
+}
+
+bool LogChunkEncoder::add(const event_record *record) {
+  uint8_t tmp[LOG_RECORD_MAX_ENCODED];
+  size_t len = 0;
+  uint32_t stamp = (uint32_t)record->stamp;
+  uint8_t code = eventToCode(record->event);
+  int32_t delta = 0;
+
+  if (_count == 0xffff || _size + LOG_CHUNK_CRC_SIZE >= _capacity) {
+    return false;
+  }
+
+  if (_count % 4 == 0) {
+    tmp[len++] = 0;  // events byte of a new group
+  }
+
+  if (_count > 0) {
+    delta = (int32_t)(stamp - _prevStamp);
+    len += putVarint(tmp + len, delta - _prevDelta);
+  }
+
+  if (code != 3) {
+    for (uint8_t k = 0; k < _sensors; k++) {
+      int t = clampTemp(record->t[k]);
+
+      len += putVarint(tmp + len, _count > 0 ? t - _prev[k] : t);
+    }
+  }
+
+  if (_size + len + LOG_CHUNK_CRC_SIZE > _capacity) {
+    return false;
+  }
+
+  memcpy(_buf + _size, tmp, len);
+  if (_count % 4 == 0) {
+    _groupAt = _size;
+  }
+  _buf[_groupAt] |= code << ((_count % 4) * 2);
+  _size += len;
+
+  if (_count == 0) {
+    _base = stamp;
+    for (uint8_t k = 0; k < _sensors; k++) {
+      _prev[k] = 0;
+    }
+  }
+  if (code != 3) {
+    for (uint8_t k = 0; k < _sensors; k++) {
+      _prev[k] = clampTemp(record->t[k]);
+    }
+  }
+  _prevDelta = delta;
+  _prevStamp = stamp;
+  _count++;
+
+  return true;
+}
+
+size_t LogChunkEncoder::finish() {
+  uint16_t payload = _size - LOG_CHUNK_HEADER_SIZE;
+
+  _buf[0] = payload & 0xff;
+  _buf[1] = payload >> 8;
+  _buf[2] = _count & 0xff;
+  _buf[3] = _count >> 8;
+  _buf[4] = LOG_CHUNK_FLAG_CRC;
+  putU32(_buf + 5, _base);
+  putU32(_buf + _size, logCrc32(_buf, _size));
+
+  return _size + LOG_CHUNK_CRC_SIZE;
+}
+
+void LogChunkDecoder::begin(const log_chunk_header *header, const uint8_t *payload, uint8_t sensors) {
+  _payload = payload;
+  _size = header->size;
+  _pos = 0;
+  _count = header->count;
+  _index = 0;
+  _sensors = sensors;
+  _prevStamp = header->base;
+  _prevDelta = 0;
+
+  for (uint8_t k = 0; k < _sensors; k++) {
+    _prev[k] = 0;
+  }
+}
+
+bool LogChunkDecoder::readVarint(int32_t *value) {
+  uint32_t zz = 0;
+
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (_pos >= _size) {
+      return false;
+    }
+
+    uint8_t b = _payload[_pos++];
+
+    zz |= (uint32_t)(b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      *value = (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LogChunkDecoder::next(event_record *record) {
+  int32_t value;
+
+  if (_index >= _count) {
+    return false;
+  }
+
+  if (_index % 4 == 0) {
+    if (_pos >= _size) {
+      return false;
+    }
+    _events = _payload[_pos++];
+  }
+
+  record->event = eventCodes[(_events >> ((_index % 4) * 2)) & 3];
+
+  if (_index > 0) {
+    if (!readVarint(&value)) {
+      return false;
+    }
+    _prevDelta += value;
+    _prevStamp += _prevDelta;
+  }
+  record->stamp = (time_t)_prevStamp;
+
+  for (uint8_t k = 0; k < _sensors; k++) {
+    if (record->event != 'b') {
+      if (!readVarint(&value)) {
+        return false;
+      }
+      _prev[k] += value;
+    }
+    record->t[k] = _prev[k];
+  }
+
+  _index++;
+
+  return true;
+}
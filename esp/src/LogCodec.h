@@ -0,0 +1,106 @@
+/*
+  LogCodec.h - delta compressed chunks of event records (data file format v2)
+
+  Chunk layout:
+    <payload size:u16> <count:u16> <flags:u8> <base stamp:u32> <payload> [<crc:u32>]
+
+  Payload is a sequence of groups of up to 4 records. Every group starts with a
+  byte of 2-bit event codes (t=0, n=1, f=2, b=3, first record in the low bits),
+  followed by the records of the group:
+    - zig-zag varint of the stamp delta-of-delta, absent for the first record
+      of the chunk (its stamp is the base stamp);
+    - unless the event is 'b', zig-zag varint of the difference to the previous
+      value of each sensor column (the first record keeps plain values).
+
+  Readings come every few minutes and move by tenths of degree, so a typical
+  record takes 1 byte for the stamp and 1 byte per sensor.
+  Flags tell which optional fields the chunk has:
+    LOG_CHUNK_FLAG_CRC - CRC32 (as of zlib) of the header and the payload
+                         follows the payload. Chunks of older firmware go
+                         without it.
+  Chunk with unknown flag bits is treated as broken.
+*/
+
+#ifndef LOG_CODEC_H
+#define LOG_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "LogFormat.h"
+
+#define LOG_CHUNK_HEADER_SIZE 9
+#define LOG_CHUNK_MAX 512  // whole chunk, header included
+#define LOG_RECORD_MAX_ENCODED (1 + 5 + 3 * MAX_SENSORS_COUNT)
+#define LOG_CHUNK_CRC_SIZE 4
+
+#define LOG_CHUNK_FLAG_CRC 0x01
+#define LOG_CHUNK_FLAGS_KNOWN LOG_CHUNK_FLAG_CRC
+
+struct log_chunk_header {
+  uint16_t size;
+  uint16_t count;
+  uint8_t flags;
+  uint32_t base;
+};
+
+bool logChunkHeaderDecode(const uint8_t *buf, log_chunk_header *header);
+// Bytes the chunk takes in file, header and trailer included
+size_t logChunkSize(const log_chunk_header *header);
+// Checks CRC of the chunk read into buf (header, payload and trailer), true for chunk without CRC
+bool logChunkVerify(const uint8_t *buf, const log_chunk_header *header);
+
+uint32_t logCrc32(const uint8_t *data, size_t len, uint32_t crc = 0);
+
+class LogChunkEncoder {
+ public:
+  // Chunk is built in buf, never growing over capacity bytes (header included)
+  void begin(uint8_t *buf, size_t capacity, uint8_t sensors);
+  // False if the record does not fit, chunk stays unchanged then
+  bool add(const event_record *record);
+  // Completes the chunk header and appends CRC, returns whole chunk size
+  size_t finish();
+
+  uint16_t count() const { return _count; }
+  size_t size() const { return _size; }
+  // Stamps of the first and the last added record
+  uint32_t firstStamp() const { return _base; }
+  uint32_t lastStamp() const { return _prevStamp; }
+
+ protected:
+  uint8_t *_buf;
+  size_t _capacity;
+  size_t _size;
+  size_t _groupAt;
+  uint16_t _count;
+  uint8_t _sensors;
+  uint32_t _base;
+  uint32_t _prevStamp;
+  int32_t _prevDelta;
+  int _prev[MAX_SENSORS_COUNT];
+};
+
+class LogChunkDecoder {
+ public:
+  void begin(const log_chunk_header *header, const uint8_t *payload, uint8_t sensors);
+  // False at the end of the chunk or when the payload is broken
+  bool next(event_record *record);
+  // All records are decoded and the payload is consumed exactly
+  bool done() const { return _index == _count && _pos == _size; }
+
+ protected:
+  bool readVarint(int32_t *value);
+
+  const uint8_t *_payload;
+  size_t _size;
+  size_t _pos;
+  uint16_t _count;
+  uint16_t _index;
+  uint8_t _sensors;
+  uint8_t _events;
+  uint32_t _prevStamp;
+  int32_t _prevDelta;
+  int _prev[MAX_SENSORS_COUNT];
+};
+
+#endif
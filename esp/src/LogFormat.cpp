@@ -0,0 +1,162 @@
+#include <string.h>
+
+#include "LogFormat.h"
+
+static void putU32(uint8_t *buf, uint32_t value) {
+  buf[0] = value & 0xff;
+  buf[1] = (value >> 8) & 0xff;
+  buf[2] = (value >> 16) & 0xff;
+  buf[3] = (value >> 24) & 0xff;
+}
+
+static uint32_t getU32(const uint8_t *buf) {
+  return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static int16_t clampTemp(int value) {
+  if (value > INT16_MAX) return INT16_MAX;
+  if (value < INT16_MIN) return INT16_MIN;
+  return (int16_t)value;
+}
+
+static size_t putInt(char *out, long value) {
+  char tmp[12];
+  size_t len = 0, i = 0;
+  unsigned long v = value < 0 ? -(unsigned long)value : value;
+
+  do {
+    tmp[len++] = '0' + v % 10;
+    v /= 10;
+  } while (v);
+
+  if (value < 0)
+    out[i++] = '-';
+  while (len)
+    out[i++] = tmp[--len];
+
+  return i;
+}
+
+static void put2(char *out, int value) {
+  out[0] = '0' + (value / 10) % 10;
+  out[1] = '0' + value % 10;
+}
+
+void logHeaderEncode(uint8_t *buf, uint8_t sensors, uint8_t version, uint32_t seq) {
+  memset(buf, 0, LOG_HEADER_SIZE);
+  buf[0] = LOG_MAGIC_0;
+  buf[1] = LOG_MAGIC_1;
+  buf[2] = version;
+  buf[3] = sensors;
+  buf[4] = version == LOG_FORMAT_FIXED ? logRecordSize(sensors) : 0;
+  buf[5] = seq & 0xff;
+  buf[6] = (seq >> 8) & 0xff;
+  buf[7] = (seq >> 16) & 0xff;
+}
+
+bool logHeaderDecode(const uint8_t *buf, size_t len, log_header *header) {
+  if (len < LOG_HEADER_SIZE || buf[0] != LOG_MAGIC_0 || buf[1] != LOG_MAGIC_1) {
+    return false;
+  }
+
+  header->version = buf[2];
+  header->sensors = buf[3];
+  header->recordSize = buf[4];
+  header->seq = buf[5] | (buf[6] << 8) | ((uint32_t)buf[7] << 16);
+
+  if (header->sensors > MAX_SENSORS_COUNT) {
+    return false;
+  }
+
+  switch (header->version) {
+    case LOG_FORMAT_FIXED:
+      return header->recordSize == logRecordSize(header->sensors);
+    case LOG_FORMAT_CHUNKED:
+      return header->recordSize == 0;
+  }
+  return false;
+}
+
+size_t logRecordEncode(const event_record *record, uint8_t sensors, uint8_t *buf) {
+  putU32(buf, (uint32_t)record->stamp);
+  buf[4] = (uint8_t)record->event;
+
+  for (uint8_t k = 0; k < sensors; k++) {
+    int16_t t = clampTemp(record->t[k]);
+
+    buf[5 + k * 2] = (uint16_t)t & 0xff;
+    buf[6 + k * 2] = ((uint16_t)t >> 8) & 0xff;
+  }
+
+  return logRecordSize(sensors);
+}
+
+bool logRecordDecode(const uint8_t *buf, uint8_t sensors, event_record *record) {
+  record->stamp = (time_t)getU32(buf);
+  record->event = (char)buf[4];
+
+  for (uint8_t k = 0; k < sensors; k++) {
+    record->t[k] = (int16_t)(buf[5 + k * 2] | (buf[6 + k * 2] << 8));
+  }
+
+  switch (record->event) {
+    case 't':
+    case 'n':
+    case 'f':
+    case 'b':
+      return true;
+  }
+  return false;
+}
+
+void packedDateReset(packed_date_cache *cache) {
+  cache->hourStart = -1;
+}
+
+size_t packedDateFormat(time_t stamp, packed_date_cache *cache, char *out) {
+  if (cache->hourStart < 0 || stamp < cache->hourStart || stamp >= cache->hourStart + 3600) {
+    struct tm *tmp = localtime(&stamp);
+
+    put2(cache->prefix, (tmp->tm_year - 100) % 100);
+    put2(cache->prefix + 2, (tmp->tm_mon + 1) % 100);
+    put2(cache->prefix + 4, tmp->tm_mday % 100);
+    put2(cache->prefix + 6, tmp->tm_hour % 100);
+    cache->hourStart = stamp - tmp->tm_min * 60 - tmp->tm_sec;
+  }
+
+  memcpy(out, cache->prefix, 8);
+  put2(out + 8, (stamp - cache->hourStart) / 60);
+
+  return 10;
+}
+
+size_t logRecordToJson(const event_record *record, uint8_t sensors, packed_date_cache *cache, char *out) {
+  size_t len = 0;
+
+  out[len++] = '[';
+  len += packedDateFormat(record->stamp, cache, out + len);
+
+  if (record->event == 'b') {
+    memcpy(out + len, ",\"st\"", 5);
+    len += 5;
+  } else {
+    for (uint8_t k = 0; k < sensors; k++) {
+      out[len++] = ',';
+      len += putInt(out + len, record->t[k]);
+    }
+    switch (record->event) {
+      case 'n':
+        memcpy(out + len, ",\"on\"", 5);
+        len += 5;
+        break;
+      case 'f':
+        memcpy(out + len, ",\"off\"", 6);
+        len += 6;
+        break;
+    }
+  }
+
+  out[len++] = ']';
+
+  return len;
+}
@@ -0,0 +1,72 @@
+/*
+  LogFormat.h - on-flash binary layout of the event log
+
+  Data file layout:
+    header  : 'T' 'L' <version> <sensors> <record size> <seq:u24>
+    version 1 (fixed width) records:
+              <stamp:u32> <event:u8> <t[0]:i16> ... <t[sensors-1]:i16>
+    version 2 (chunked) is a sequence of delta compressed chunks, see LogCodec.h.
+              Record size in the header is 0.
+
+  Records are numbered across data files: seq in the header is the number of
+  the first record of the file (0 in files of older firmware), the rest follow
+  in order. All numbers are little-endian. Stamp is UTC epoch seconds (records are
+  re-stamped from boot-relative time before they reach the flash), temperatures
+  are tenths of degree exactly as kept in event_record.
+*/
+
+#ifndef LOG_FORMAT_H
+#define LOG_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define MAX_SENSORS_COUNT 8
+
+#define LOG_MAGIC_0 'T'
+#define LOG_MAGIC_1 'L'
+#define LOG_FORMAT_FIXED 1
+#define LOG_FORMAT_CHUNKED 2
+#define LOG_FORMAT_VERSION LOG_FORMAT_CHUNKED
+#define LOG_HEADER_SIZE 8
+#define LOG_RECORD_MAX_SIZE (5 + 2 * MAX_SENSORS_COUNT)
+#define LOG_JSON_RECORD_MAX (12 + MAX_SENSORS_COUNT * 7 + 8)  // [YYMMDDhhmm,-1270,...,"off"]
+
+struct event_record {
+  time_t stamp;
+  char event;
+  int t[MAX_SENSORS_COUNT];
+};
+
+struct log_header {
+  uint8_t version;
+  uint8_t sensors;
+  uint8_t recordSize;
+  uint32_t seq;  // of the first record
+};
+
+// Keeps the "YYMMDDhh" part of the last formatted stamp, so consecutive records
+// of the same hour are formatted without localtime() call.
+struct packed_date_cache {
+  time_t hourStart;
+  char prefix[8];
+};
+
+inline size_t logRecordSize(uint8_t sensors) {
+  return 5 + 2 * sensors;
+}
+
+void logHeaderEncode(uint8_t *buf, uint8_t sensors, uint8_t version = LOG_FORMAT_VERSION, uint32_t seq = 0);
+bool logHeaderDecode(const uint8_t *buf, size_t len, log_header *header);
+
+size_t logRecordEncode(const event_record *record, uint8_t sensors, uint8_t *buf);
+bool logRecordDecode(const uint8_t *buf, uint8_t sensors, event_record *record);
+
+void packedDateReset(packed_date_cache *cache);
+size_t packedDateFormat(time_t stamp, packed_date_cache *cache, char *out);
+
+// Writes record as `[YYMMDDhhmm,t0,..,"on"]` (no trailing zero), returns length.
+size_t logRecordToJson(const event_record *record, uint8_t sensors, packed_date_cache *cache, char *out);
+
+#endif
@@ -0,0 +1,206 @@
+#include "LogCodec.h"
+#include "LogIndex.h"
+
+static void putU16(uint8_t *buf, uint16_t value) {
+  buf[0] = value & 0xff;
+  buf[1] = (value >> 8) & 0xff;
+}
+
+static void putU32(uint8_t *buf, uint32_t value) {
+  putU16(buf, value & 0xffff);
+  putU16(buf + 2, value >> 16);
+}
+
+static uint16_t getU16(const uint8_t *buf) {
+  return buf[0] | (buf[1] << 8);
+}
+
+static uint32_t getU32(const uint8_t *buf) {
+  return getU16(buf) | ((uint32_t)getU16(buf + 2) << 16);
+}
+
+void logIndexEntryEncode(const log_index_entry *entry, uint8_t *buf) {
+  putU32(buf, entry->offset);
+  putU16(buf + 4, entry->size);
+  putU16(buf + 6, entry->count);
+  putU32(buf + 8, entry->first);
+  putU32(buf + 12, entry->last);
+}
+
+void logIndexEntryDecode(const uint8_t *buf, log_index_entry *entry) {
+  entry->offset = getU32(buf);
+  entry->size = getU16(buf + 4);
+  entry->count = getU16(buf + 6);
+  entry->first = getU32(buf + 8);
+  entry->last = getU32(buf + 12);
+}
+
+bool logIndexRead(File *index, size_t i, log_index_entry *entry) {
+  uint8_t buf[LOG_INDEX_ENTRY_SIZE];
+
+  if (i >= logIndexEntries(index) || !index->seek(i * LOG_INDEX_ENTRY_SIZE) ||
+      index->read(buf, LOG_INDEX_ENTRY_SIZE) != LOG_INDEX_ENTRY_SIZE) {
+    return false;
+  }
+  logIndexEntryDecode(buf, entry);
+  return true;
+}
+
+size_t logIndexFind(File *index, uint32_t stamp) {
+  size_t lo = 0, hi = logIndexEntries(index);
+  log_index_entry entry;
+
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+
+    if (!logIndexRead(index, mid, &entry)) {
+      return logIndexEntries(index);
+    }
+    if (entry.last < stamp) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+size_t logIndexFindRecord(File *index, uint32_t n, uint32_t *skip) {
+  size_t entries = logIndexEntries(index);
+  log_index_entry entry;
+
+  for (size_t i = 0; i < entries && logIndexRead(index, i, &entry); i++) {
+    if (n < entry.count) {
+      *skip = n;
+      return i;
+    }
+    n -= entry.count;
+  }
+  return entries;
+}
+
+uint32_t logIndexRecords(File *index) {
+  size_t entries = logIndexEntries(index);
+  log_index_entry entry;
+  uint32_t count = 0;
+
+  for (size_t i = 0; i < entries && logIndexRead(index, i, &entry); i++) {
+    count += entry.count;
+  }
+  return count;
+}
+
+bool logIndexCovers(File *index, size_t dataSize) {
+  size_t entries = logIndexEntries(index);
+  log_index_entry entry;
+
+  if (entries == 0) {
+    return dataSize <= LOG_HEADER_SIZE;
+  }
+  return logIndexRead(index, entries - 1, &entry) && entry.offset + entry.size == dataSize;
+}
+
+void logIndexTruncate(File *index, size_t dataSize) {
+  size_t entries = logIndexEntries(index);
+  log_index_entry entry;
+
+  while (entries > 0 && (!logIndexRead(index, entries - 1, &entry) || entry.offset + entry.size > dataSize)) {
+    entries--;
+  }
+  index->truncate(entries * LOG_INDEX_ENTRY_SIZE);
+}
+
+static void putEntry(File *index, const log_index_entry *entry) {
+  uint8_t buf[LOG_INDEX_ENTRY_SIZE];
+
+  logIndexEntryEncode(entry, buf);
+  index->write(buf, LOG_INDEX_ENTRY_SIZE);
+}
+
+// Fixed width records are indexed in blocks of whole records up to LOG_CHUNK_MAX bytes. entry is left at the
+// intact end, with the last stamp indexed
+static void buildFixed(File *data, File *index, const log_header *header, log_index_entry *entry) {
+  uint8_t buf[LOG_CHUNK_MAX];
+  size_t perBlock = LOG_CHUNK_MAX / header->recordSize;
+  event_record record;
+
+  while (true) {
+    size_t len = data->read(buf, perBlock * header->recordSize);
+
+    entry->count = len / header->recordSize;
+    if (entry->count == 0 || !logRecordDecode(buf, header->sensors, &record)) {
+      return;
+    }
+    entry->first = (uint32_t)record.stamp;
+    entry->size = entry->count * header->recordSize;
+    logRecordDecode(buf + entry->size - header->recordSize, header->sensors, &record);
+    entry->last = (uint32_t)record.stamp;
+
+    putEntry(index, entry);
+    entry->offset += entry->size;
+  }
+}
+
+// The same for chunks
+static void buildChunked(File *data, File *index, const log_header *header, log_index_entry *entry) {
+  uint8_t buf[LOG_CHUNK_MAX];
+  LogChunkDecoder decoder;
+  log_chunk_header chunk;
+  event_record record;
+
+  while (data->read(buf, LOG_CHUNK_HEADER_SIZE) == LOG_CHUNK_HEADER_SIZE && logChunkHeaderDecode(buf, &chunk)) {
+    uint16_t size = logChunkSize(&chunk);
+
+    if (data->read(buf + LOG_CHUNK_HEADER_SIZE, size - LOG_CHUNK_HEADER_SIZE) != (size_t)size - LOG_CHUNK_HEADER_SIZE ||
+        !logChunkVerify(buf, &chunk)) {
+      return;
+    }
+
+    decoder.begin(&chunk, buf + LOG_CHUNK_HEADER_SIZE, header->sensors);
+    while (decoder.next(&record))
+      ;
+    if (!decoder.done()) {  // torn chunk, index stops before it
+      return;
+    }
+
+    entry->size = size;
+    entry->count = chunk.count;
+    entry->first = chunk.base;
+    entry->last = (uint32_t)record.stamp;
+
+    putEntry(index, entry);
+    entry->offset += entry->size;
+  }
+}
+
+// Bytes past the intact end get entries of no records, stamped with the last one indexed
+static void putTorn(File *index, log_index_entry *entry, size_t dataSize) {
+  entry->count = 0;
+  entry->first = entry->last;
+  while (entry->offset < dataSize) {
+    entry->size = dataSize - entry->offset < UINT16_MAX ? dataSize - entry->offset : UINT16_MAX;
+    putEntry(index, entry);
+    entry->offset += entry->size;
+  }
+}
+
+bool logIndexBuild(File *data, File *index) {
+  uint8_t buf[LOG_HEADER_SIZE];
+  log_header header;
+  log_index_entry entry;
+
+  if (!data->seek(0) || data->read(buf, LOG_HEADER_SIZE) != LOG_HEADER_SIZE ||
+      !logHeaderDecode(buf, LOG_HEADER_SIZE, &header)) {
+    return false;
+  }
+
+  entry.offset = LOG_HEADER_SIZE;
+  entry.last = 0;
+  if (header.version == LOG_FORMAT_FIXED) {
+    buildFixed(data, index, &header, &entry);
+  } else {
+    buildChunked(data, index, &header, &entry);
+  }
+  putTorn(index, &entry, data->size());
+  return true;
+}
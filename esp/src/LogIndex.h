@@ -0,0 +1,56 @@
+/*
+  LogIndex.h - sidecar stamp index of a data file
+
+  Index file keeps one entry per chunk of the data file (per block of records
+  for fixed width files) in the order they are stored:
+    <offset:u32> <size:u16> <count:u16> <first stamp:u32> <last stamp:u32>
+
+  Records of a data file go in time order, so entries are sorted by stamps and
+  a time range is found by binary search over the index, then the data file is
+  read from the offset of the first matching entry. Index covers the data file
+  when its last entry ends exactly at the end of data; otherwise it is stale
+  (torn write, file of older firmware) and gets rebuilt from the data file.
+  Bytes of a torn write past the intact end get entries of no records, so a
+  rebuilt index covers the file and is not built again on the next query.
+*/
+
+#ifndef LOG_INDEX_H
+#define LOG_INDEX_H
+
+#include "FS.h"
+#include "LogFormat.h"
+
+#define LOG_INDEX_ENTRY_SIZE 16
+
+struct log_index_entry {
+  uint32_t offset;  // of the chunk, or of the first record in fixed width file
+  uint16_t size;
+  uint16_t count;
+  uint32_t first;
+  uint32_t last;
+};
+
+void logIndexEntryEncode(const log_index_entry *entry, uint8_t *buf);
+void logIndexEntryDecode(const uint8_t *buf, log_index_entry *entry);
+
+inline size_t logIndexEntries(File *index) {
+  return index->size() / LOG_INDEX_ENTRY_SIZE;
+}
+
+// i-th entry, false past the last one
+bool logIndexRead(File *index, size_t i, log_index_entry *entry);
+// First entry having records at or after stamp, logIndexEntries() if there is none
+size_t logIndexFind(File *index, uint32_t stamp);
+// Entry holding the n-th record of the file (from 0), *skip is set to the records of it before that one.
+// logIndexEntries() if the file has fewer records.
+size_t logIndexFindRecord(File *index, uint32_t n, uint32_t *skip);
+// Records of the whole file
+uint32_t logIndexRecords(File *index);
+// Index describes all the data of a file of dataSize bytes
+bool logIndexCovers(File *index, size_t dataSize);
+// Drops entries of data past dataSize, after the data file is cut
+void logIndexTruncate(File *index, size_t dataSize);
+// Writes entries for the whole data file into empty index, torn tail included, false if data is not a binary log
+bool logIndexBuild(File *data, File *index);
+
+#endif
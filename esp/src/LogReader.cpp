@@ -0,0 +1,96 @@
+#include "LogReader.h"
+
+bool LogReader::open(File *file) {
+  _file = file;
+  _broken = false;
+  _inChunk = false;
+  _len = 0;
+  _pos = 0;
+  _intactEnd = LOG_HEADER_SIZE;
+
+  return _file->read(_buf, LOG_HEADER_SIZE) == LOG_HEADER_SIZE && logHeaderDecode(_buf, LOG_HEADER_SIZE, &_header);
+}
+
+bool LogReader::next(event_record *record) {
+  if (_broken) {
+    return false;
+  }
+  return _header.version == LOG_FORMAT_FIXED ? nextFixed(record) : nextChunked(record);
+}
+
+bool LogReader::seek(uint32_t offset) {
+  _broken = false;
+  _inChunk = false;
+  _len = 0;
+  _pos = 0;
+  _intactEnd = offset;
+
+  return offset >= LOG_HEADER_SIZE && _file->seek(offset);
+}
+
+bool LogReader::nextFixed(event_record *record) {
+  if (_pos + _header.recordSize > _len) {
+    if (_pos < _len) {  // tail shorter than a record
+      _broken = true;
+      return false;
+    }
+    _bufAt = _file->position();
+    _len = _file->read(_buf, sizeof(_buf) / _header.recordSize * _header.recordSize);
+    _pos = 0;
+    if (_len == 0) {
+      return false;
+    }
+    if (_len < _header.recordSize) {
+      _broken = true;
+      return false;
+    }
+  }
+
+  if (!logRecordDecode(_buf + _pos, _header.sensors, record)) {
+    _broken = true;
+    return false;
+  }
+  _pos += _header.recordSize;
+  _intactEnd = _bufAt + _pos;
+
+  return true;
+}
+
+bool LogReader::nextChunked(event_record *record) {
+  log_chunk_header chunk;
+  size_t len;
+
+  if (_inChunk) {
+    if (_decoder.next(record)) {
+      return true;
+    }
+    if (!_decoder.done()) {
+      _broken = true;
+      return false;
+    }
+    _inChunk = false;
+    _intactEnd = _chunkEnd;
+  }
+
+  len = _file->read(_buf, LOG_CHUNK_HEADER_SIZE);
+  if (len == 0) {
+    return false;
+  }
+
+  if (len < LOG_CHUNK_HEADER_SIZE || !logChunkHeaderDecode(_buf, &chunk)) {
+    _broken = true;
+    return false;
+  }
+
+  len = logChunkSize(&chunk) - LOG_CHUNK_HEADER_SIZE;
+  if (_file->read(_buf + LOG_CHUNK_HEADER_SIZE, len) != len || !logChunkVerify(_buf, &chunk)) {
+    _broken = true;
+    return false;
+  }
+  _chunkEnd = _file->position();
+
+  _decoder.begin(&chunk, _buf + LOG_CHUNK_HEADER_SIZE, _header.sensors);
+  _inChunk = true;
+
+  return nextChunked(record);
+}
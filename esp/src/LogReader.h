@@ -0,0 +1,46 @@
+/*
+  LogReader.h - sequential reader of binary data files (both fixed and chunked)
+*/
+
+#ifndef LOG_READER_H
+#define LOG_READER_H
+
+#include "FS.h"
+#include "LogCodec.h"
+#include "LogFormat.h"
+
+class LogReader {
+ public:
+  // Reads file header, false if the file is not a binary log
+  bool open(File *file);
+  // False at the end of file, or when stopped on a broken/torn part (see broken())
+  bool next(event_record *record);
+  // Continues reading from offset of a chunk (record of fixed width file), see LogIndex.h
+  bool seek(uint32_t offset);
+
+  bool broken() const { return _broken; }
+  // Offset right after the last complete record (chunk) read, file can be cut there when broken()
+  uint32_t intactEnd() const { return _intactEnd; }
+  uint8_t sensors() const { return _header.sensors; }
+  uint8_t version() const { return _header.version; }
+  // Number of the first record of the file, see LogFormat.h
+  uint32_t seq() const { return _header.seq; }
+
+ protected:
+  bool nextFixed(event_record *record);
+  bool nextChunked(event_record *record);
+
+  File *_file;
+  log_header _header;
+  bool _broken;
+  bool _inChunk;
+  size_t _len;
+  size_t _pos;
+  uint32_t _bufAt;
+  uint32_t _chunkEnd;
+  uint32_t _intactEnd;
+  LogChunkDecoder _decoder;
+  uint8_t _buf[LOG_CHUNK_MAX];
+};
+
+#endif
@@ -0,0 +1,139 @@
+#include "Metrics.h"
+
+#if METRICS
+
+#include <Arduino.h>
+#include <stdio.h>
+
+struct metric_histogram {
+  uint32_t buckets[METRICS_BUCKETS];  // not cumulative, it is summed up on output
+  uint64_t sumUs;
+};
+
+struct metric_info {
+  const char *name;
+  const char *help;
+};
+
+static const uint32_t bucketBoundsUs[METRICS_BUCKETS - 1] = {100, 300, 1000, 3000, 10000, 30000, 100000, 300000, 1000000, 3000000};
+static const char *const bucketLabels[METRICS_BUCKETS] = {"le=\"0.0001\"", "le=\"0.0003\"", "le=\"0.001\"", "le=\"0.003\"", "le=\"0.01\"", "le=\"0.03\"",
+                                                          "le=\"0.1\"", "le=\"0.3\"", "le=\"1\"", "le=\"3\"", "le=\"+Inf\""};
+
+static const metric_info histogramInfo[METRIC_HISTOGRAMS] = {
+    {"thermo_loop_seconds", "loop() pass, idle sleep excluded"},
+    {"thermo_http_seconds", "HTTP request handler"},
+    {"thermo_flush_seconds", "Data log flush into file"},
+    {"thermo_write_seconds", "Data file append"},
+    {"thermo_scan_seconds", "Sensors conversion start"},
+    {"thermo_read_seconds", "Sensors readout"},
+    {"thermo_check_seconds", "Data file check"},
+    {"thermo_archive_seconds", "Slice of data file compression"},
+    {"thermo_retention_seconds", "Slice of data file compaction into month files"},
+};
+
+static const metric_info counterInfo[METRIC_COUNTERS] = {
+    {"thermo_flash_written_bytes_total", "Data, index, journal and archive bytes written"},
+    {"thermo_records_logged_total", "Records put into data log"},
+    {"thermo_records_dropped_total", "Records dropped, data log was full"},
+    {"thermo_data_written_bytes_total", "Bytes appended to data files"},
+    {"thermo_data_commits_total", "Data file commits"},
+    {"thermo_data_programmed_bytes_total", "Estimated flash bytes programmed by data file commits, block copies included"},
+    {"thermo_sse_dropped_total", "Event stream subscribers dropped for not keeping up"},
+    {"thermo_retention_files_total", "Data files compacted into month files or removed, month files removed"},
+    {"thermo_retention_corrupt_total", "Corrupt data files removed by retention without compaction"},
+};
+
+static metric_histogram histograms[METRIC_HISTOGRAMS];
+static uint32_t counters[METRIC_COUNTERS];
+static uint16_t ringLevelMax;
+static uint32_t heapFreeMin = UINT32_MAX;
+
+void metricObserve(uint8_t histogram, uint32_t us) {
+  uint8_t i = 0;
+
+  while (i < METRICS_BUCKETS - 1 && us > bucketBoundsUs[i]) {
+    i++;
+  }
+  histograms[histogram].buckets[i]++;
+  histograms[histogram].sumUs += us;
+}
+
+void metricAdd(uint8_t counter, uint32_t n) {
+  counters[counter] += n;
+}
+
+uint32_t metricCounter(uint8_t counter) {
+  return counters[counter];
+}
+
+void metricRingLevel(uint16_t used) {
+  ringLevelMax = used > ringLevelMax ? used : ringLevelMax;
+}
+
+void metricHeapSample() {
+  uint32_t heapFree = ESP.getFreeHeap();
+
+  heapFreeMin = heapFree < heapFreeMin ? heapFree : heapFreeMin;
+}
+
+MetricTimer::MetricTimer(uint8_t histogram) : _startedUs(micros()), _histogram(histogram) {
+}
+
+MetricTimer::~MetricTimer() {
+  metricObserve(_histogram, micros() - _startedUs);
+}
+
+void metricsWriteHead(JsonWriter *out, const char *name, const char *type, const char *help) {
+  out->raw("# HELP ").raw(name).raw(" ").raw(help).raw("\n");
+  out->raw("# TYPE ").raw(name).raw(" ").raw(type).raw("\n");
+}
+
+void metricsWriteLine(JsonWriter *out, const char *name, const char *labels, uint32_t value) {
+  char line[24];
+
+  out->raw(name);
+  if (labels) {
+    out->raw("{").raw(labels).raw("}");
+  }
+  out->raw(line, sprintf(line, " %lu\n", (unsigned long)value));
+}
+
+static void writeHistogram(JsonWriter *out, const metric_info *info, const metric_histogram *histogram) {
+  char line[48];
+  uint32_t count = 0;
+
+  metricsWriteHead(out, info->name, "histogram", info->help);
+  for (uint8_t i = 0; i < METRICS_BUCKETS; i++) {
+    count += histogram->buckets[i];
+    out->raw(info->name).raw("_bucket");
+    metricsWriteLine(out, "", bucketLabels[i], count);
+  }
+  out->raw(info->name).raw(line, sprintf(line, "_sum %lu.%06lu\n", (unsigned long)(histogram->sumUs / 1000000),
+                                         (unsigned long)(histogram->sumUs % 1000000)));
+  out->raw(info->name).raw("_count");
+  metricsWriteLine(out, "", nullptr, count);
+}
+
+void metricsWrite(JsonWriter *out) {
+  for (uint8_t i = 0; i < METRIC_HISTOGRAMS; i++) {
+    writeHistogram(out, &histogramInfo[i], &histograms[i]);
+  }
+
+  for (uint8_t i = 0; i < METRIC_COUNTERS; i++) {
+    metricsWriteHead(out, counterInfo[i].name, "counter", counterInfo[i].help);
+    metricsWriteLine(out, counterInfo[i].name, nullptr, counters[i]);
+  }
+
+  metricsWriteHead(out, "thermo_ring_used_max", "gauge", "Most records waiting in data log");
+  metricsWriteLine(out, "thermo_ring_used_max", nullptr, ringLevelMax);
+  metricsWriteHead(out, "thermo_heap_free_bytes", "gauge", "Free heap");
+  metricsWriteLine(out, "thermo_heap_free_bytes", nullptr, ESP.getFreeHeap());
+  metricsWriteHead(out, "thermo_heap_free_min_bytes", "gauge", "Least free heap seen after a loop() pass");
+  metricsWriteLine(out, "thermo_heap_free_min_bytes", nullptr, heapFreeMin);
+  metricsWriteHead(out, "thermo_heap_max_block_bytes", "gauge", "Largest free heap block");
+  metricsWriteLine(out, "thermo_heap_max_block_bytes", nullptr, ESP.getMaxFreeBlockSize());
+  metricsWriteHead(out, "thermo_heap_fragmentation_percent", "gauge", "Heap fragmentation");
+  metricsWriteLine(out, "thermo_heap_fragmentation_percent", nullptr, ESP.getHeapFragmentation());
+}
+
+#endif
@@ -0,0 +1,95 @@
+/*
+  Metrics.h - runtime counters and duration histograms, served as /metrics
+
+  Everything lives in static arrays, nothing is allocated. Durations are
+  counted in fixed buckets (100 us .. 3 s and +Inf) with their sum, counters
+  only grow, gauges keep the extreme seen since boot. Output is Prometheus
+  text exposition format.
+
+  Probes are the METRIC_* macros below; build with METRICS 0 (-D METRICS=0)
+  and they expand to nothing, the module is left out together with /metrics.
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#ifndef METRICS
+#define METRICS 1
+#endif
+
+#include <stdint.h>
+
+#include "JsonWriter.h"
+
+#define METRICS_BUCKETS 11  // last one is +Inf
+
+enum metric_histogram_id : uint8_t {
+  METRIC_LOOP_US,     // loop() pass, idle sleep excluded
+  METRIC_HTTP_US,     // request handler
+  METRIC_FLUSH_US,    // flushLogIntoFile()
+  METRIC_WRITE_US,    // writeToFile()
+  METRIC_SCAN_US,     // scanSensors()
+  METRIC_READ_US,     // readSensors()
+  METRIC_CHECK_US,    // checkFile()
+  METRIC_ARCHIVE_US,  // slice of data file compression
+  METRIC_RETENTION_US,  // slice of data file compaction into month files
+  METRIC_HISTOGRAMS
+};
+
+enum metric_counter_id : uint8_t {
+  METRIC_FLASH_BYTES,       // data, index, journal and archive bytes written
+  METRIC_RECORDS_LOGGED,
+  METRIC_RECORDS_DROPPED,   // data log was full
+  METRIC_DATA_BYTES,        // appended to data files
+  METRIC_DATA_COMMITS,      // data file commits, see AppendBuffer
+  METRIC_DATA_PROGRAMMED,   // estimated flash bytes programmed by them
+  METRIC_EVENTS_DROPPED,    // /events subscribers too slow to keep up
+  METRIC_RETENTION_FILES,   // data and month files retention removed
+  METRIC_RETENTION_CORRUPT, // data files retention removed uncompacted, their header went bad
+  METRIC_COUNTERS
+};
+
+#if METRICS
+
+void metricObserve(uint8_t histogram, uint32_t us);
+void metricAdd(uint8_t counter, uint32_t n);
+uint32_t metricCounter(uint8_t counter);
+// Fill level of the data log ring, its maximum is kept
+void metricRingLevel(uint16_t used);
+// Low-water mark of free heap, cheap enough for every loop() pass
+void metricHeapSample();
+// All metrics as Prometheus text, with the current heap state
+void metricsWrite(JsonWriter *out);
+// "# HELP" and "# TYPE" lines of a metric
+void metricsWriteHead(JsonWriter *out, const char *name, const char *type, const char *help);
+// Sample line "<name>{<labels>} <value>", labels may be nullptr
+void metricsWriteLine(JsonWriter *out, const char *name, const char *labels, uint32_t value);
+
+class MetricTimer {
+ public:
+  MetricTimer(uint8_t histogram);
+  ~MetricTimer();
+
+ protected:
+  uint32_t _startedUs;
+  uint8_t _histogram;
+};
+
+#define METRIC_CONCAT_(a, b) a##b
+#define METRIC_CONCAT(a, b) METRIC_CONCAT_(a, b)
+// Times the rest of the enclosing block
+#define METRIC_SCOPE(histogram) MetricTimer METRIC_CONCAT(metricTimer, __LINE__)(histogram)
+#define METRIC_ADD(counter, n) metricAdd(counter, n)
+#define METRIC_RING_LEVEL(used) metricRingLevel(used)
+#define METRIC_HEAP_SAMPLE() metricHeapSample()
+
+#else
+
+#define METRIC_SCOPE(histogram)
+#define METRIC_ADD(counter, n) ((void)(n))  // n may have side effects, e.g. file.write()
+#define METRIC_RING_LEVEL(used)
+#define METRIC_HEAP_SAMPLE()
+
+#endif
+
+#endif
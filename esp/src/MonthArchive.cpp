@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "MonthArchive.h"
+
+static void putU32(uint8_t *buf, uint32_t value) {
+  buf[0] = value & 0xff;
+  buf[1] = (value >> 8) & 0xff;
+  buf[2] = (value >> 16) & 0xff;
+  buf[3] = (value >> 24) & 0xff;
+}
+
+static uint32_t getU32(const uint8_t *buf) {
+  return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static void putI16(uint8_t *buf, int value) {
+  int16_t v = value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : value;
+
+  buf[0] = (uint16_t)v & 0xff;
+  buf[1] = ((uint16_t)v >> 8) & 0xff;
+}
+
+static int getI16(const uint8_t *buf) {
+  return (int16_t)(buf[0] | (buf[1] << 8));
+}
+
+static size_t putInt(char *out, long value) {
+  char tmp[12];
+  size_t len = 0, i = 0;
+  unsigned long v = value < 0 ? -(unsigned long)value : value;
+
+  do {
+    tmp[len++] = '0' + v % 10;
+    v /= 10;
+  } while (v);
+
+  if (value < 0)
+    out[i++] = '-';
+  while (len)
+    out[i++] = tmp[--len];
+
+  return i;
+}
+
+static size_t putColumn(char *out, const int *values, uint8_t sensors) {
+  size_t len = 0;
+
+  out[len++] = ',';
+  out[len++] = '[';
+  for (uint8_t k = 0; k < sensors; k++) {
+    if (k) {
+      out[len++] = ',';
+    }
+    len += putInt(out + len, values[k]);
+  }
+  out[len++] = ']';
+  return len;
+}
+
+static size_t entrySize(char tag, uint8_t sensors) {
+  return tag == 'a' ? 8 + 6 * sensors : MONTH_SWITCH_SIZE;
+}
+
+uint16_t monthOf(time_t stamp) {
+  struct tm *tmp = localtime(&stamp);
+
+  return (tmp->tm_year - 100) % 100 * 100 + tmp->tm_mon + 1;
+}
+
+uint32_t monthFileKey(const String &name) {
+  unsigned long month = 0, n = 0;
+  char back[16];
+
+  if (sscanf(name.c_str(), "%4lu_%2lu", &month, &n) < 1 || month % 100 < 1 || month % 100 > 12) {
+    return 0;
+  }
+  snprintf(back, sizeof(back), n ? "%04lu_%lu" : "%04lu", month, n);
+  return name == back ? month * 100 + n : 0;
+}
+
+String monthFileName(uint32_t key) {
+  char name[16];
+
+  snprintf(name, sizeof(name), key % 100 ? "%04lu_%lu" : "%04lu", (unsigned long)(key / 100), (unsigned long)(key % 100));
+  return name;
+}
+
+void monthHeaderEncode(const month_header *header, uint8_t *buf) {
+  buf[0] = MONTH_MAGIC_0;
+  buf[1] = MONTH_MAGIC_1;
+  buf[2] = MONTH_FORMAT_VERSION;
+  buf[3] = header->sensors;
+  putU32(buf + 4, header->size);
+  putU32(buf + 8, header->source);
+  putU32(buf + 12, header->first);
+  putU32(buf + 16, header->last);
+}
+
+bool monthHeaderDecode(const uint8_t *buf, size_t len, month_header *header) {
+  if (len < MONTH_HEADER_SIZE || buf[0] != MONTH_MAGIC_0 || buf[1] != MONTH_MAGIC_1 || buf[2] != MONTH_FORMAT_VERSION) {
+    return false;
+  }
+  header->sensors = buf[3];
+  header->size = getU32(buf + 4);
+  header->source = getU32(buf + 8);
+  header->first = getU32(buf + 12);
+  header->last = getU32(buf + 16);
+  return header->sensors <= MAX_SENSORS_COUNT;
+}
+
+size_t monthEntryEncode(const month_entry *entry, uint8_t sensors, uint8_t *buf) {
+  buf[0] = (uint8_t)entry->tag;
+  putU32(buf + 1, entry->stamp);
+  if (entry->tag != 'a') {
+    return MONTH_SWITCH_SIZE;
+  }
+
+  buf[5] = entry->count;
+  buf[6] = entry->on & 0xff;
+  buf[7] = entry->on >> 8;
+  for (uint8_t k = 0; k < sensors; k++) {
+    putI16(buf + 8 + k * 6, entry->avg[k]);
+    putI16(buf + 10 + k * 6, entry->min[k]);
+    putI16(buf + 12 + k * 6, entry->max[k]);
+  }
+  return entrySize('a', sensors);
+}
+
+void monthEntryToRecord(const month_entry *entry, uint8_t sensors, event_record *record) {
+  record->stamp = entry->stamp;
+  record->event = entry->tag == 'a' ? 't' : entry->tag;
+  for (uint8_t k = 0; k < sensors; k++) {
+    record->t[k] = entry->avg[k];
+  }
+}
+
+size_t monthEntryToJson(const month_entry *entry, uint8_t sensors, packed_date_cache *cache, char *out) {
+  size_t len = 0;
+
+  if (entry->tag != 'a') {
+    event_record record;
+
+    monthEntryToRecord(entry, sensors, &record);
+    return logRecordToJson(&record, sensors, cache, out);
+  }
+
+  out[len++] = '[';
+  len += packedDateFormat(entry->stamp, cache, out + len);
+  memcpy(out + len, ",\"a\",", 5);
+  len += 5;
+  len += putInt(out + len, entry->count);
+  out[len++] = ',';
+  len += putInt(out + len, entry->on);
+  len += putColumn(out + len, entry->avg, sensors);
+  len += putColumn(out + len, entry->min, sensors);
+  len += putColumn(out + len, entry->max, sensors);
+  out[len++] = ']';
+
+  return len;
+}
+
+bool MonthReader::open(File *file) {
+  uint8_t buf[MONTH_HEADER_SIZE];
+
+  _file = file;
+  _pos = 0;
+  memset(_avg, 0, sizeof(_avg));
+  return file->seek(0) && monthHeaderDecode(buf, file->read(buf, sizeof(buf)), &_header);
+}
+
+bool MonthReader::next(month_entry *entry) {
+  uint8_t buf[MONTH_ENTRY_MAX_SIZE];
+  size_t size;
+
+  if (_pos + MONTH_SWITCH_SIZE > _header.size || _file->read(buf, MONTH_SWITCH_SIZE) != MONTH_SWITCH_SIZE) {
+    return false;
+  }
+
+  entry->tag = (char)buf[0];
+  entry->stamp = getU32(buf + 1);
+  size = entrySize(entry->tag, _header.sensors);
+  if ((entry->tag != 'a' && entry->tag != 'n' && entry->tag != 'f') || _pos + size > _header.size ||
+      (size > MONTH_SWITCH_SIZE && _file->read(buf + MONTH_SWITCH_SIZE, size - MONTH_SWITCH_SIZE) != size - MONTH_SWITCH_SIZE)) {
+    return false;
+  }
+  _pos += size;
+
+  if (entry->tag == 'a') {
+    entry->count = buf[5];
+    entry->on = buf[6] | (buf[7] << 8);
+    for (uint8_t k = 0; k < _header.sensors; k++) {
+      entry->avg[k] = _avg[k] = getI16(buf + 8 + k * 6);
+      entry->min[k] = getI16(buf + 10 + k * 6);
+      entry->max[k] = getI16(buf + 12 + k * 6);
+    }
+  } else {
+    entry->count = 1;
+    entry->on = 0;
+    for (uint8_t k = 0; k < _header.sensors; k++) {
+      entry->avg[k] = entry->min[k] = entry->max[k] = _avg[k];
+    }
+  }
+  return true;
+}
+
+MonthBucketer::MonthBucketer() : _relayOn(false), _open(false) {
+}
+
+void MonthBucketer::begin(uint8_t sensors, sink_t sink, void *ctx) {
+  _sensors = sensors;
+  _sink = sink;
+  _ctx = ctx;
+  _open = false;
+  _switchCount = 0;
+}
+
+void MonthBucketer::add(const event_record *record) {
+  uint32_t stamp = record->stamp;
+
+  if (_open && stamp >= _start + MONTH_PERIOD_SEC) {
+    account(_start + MONTH_PERIOD_SEC);
+    flush();
+  }
+
+  if (!_open) {
+    _open = true;
+    _start = stamp - stamp % MONTH_PERIOD_SEC;
+    _cursor = stamp;
+    _onSec = 0;
+    _count = 0;
+    _switchCount = 0;
+    memset(_sum, 0, sizeof(_sum));
+  }
+  account(stamp);
+
+  if (record->event == 'b') {  // relay is off after boot, there are no readings
+    _relayOn = false;
+    return;
+  }
+
+  for (uint8_t k = 0; k < _sensors; k++) {
+    int t = record->t[k];
+
+    _entry.min[k] = _count == 0 || t < _entry.min[k] ? t : _entry.min[k];
+    _entry.max[k] = _count == 0 || t > _entry.max[k] ? t : _entry.max[k];
+    _sum[k] += t;
+  }
+  _count++;
+
+  if (record->event == 'n' || record->event == 'f') {
+    _relayOn = record->event == 'n';
+    if (_switchCount < MONTH_PERIOD_SWITCHES) {
+      _switchAt[_switchCount] = stamp;
+      _switchEvent[_switchCount++] = record->event;
+    }
+  }
+}
+
+void MonthBucketer::finish() {
+  if (_open) {
+    flush();
+  }
+}
+
+void MonthBucketer::account(uint32_t until) {
+  if (until > _cursor) {
+    _onSec += _relayOn ? until - _cursor : 0;
+    _cursor = until;
+  }
+}
+
+// Period entry, then relay switches of the period
+void MonthBucketer::flush() {
+  month_entry sw;
+
+  _open = false;
+
+  if (_count > 0) {
+    _entry.tag = 'a';
+    _entry.stamp = _start;
+    _entry.count = _count > 255 ? 255 : _count;
+    _entry.on = (_onSec + 30) / 60;
+    for (uint8_t k = 0; k < _sensors; k++) {
+      _entry.avg[k] = (_sum[k] + (_sum[k] >= 0 ? _count / 2 : -(long)(_count / 2))) / (long)_count;
+    }
+    _sink(&_entry, _ctx);
+  }
+
+  for (uint8_t i = 0; i < _switchCount; i++) {
+    sw.tag = _switchEvent[i];
+    sw.stamp = _switchAt[i];
+    _sink(&sw, _ctx);
+  }
+  _switchCount = 0;
+}
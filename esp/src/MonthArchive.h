@@ -0,0 +1,130 @@
+/*
+  MonthArchive.h - downsampled history of a month, what retention leaves of data files
+
+  Month file layout (/m/YYMM, /m/YYMM_n):
+    header : 'T' 'M' <version> <sensors> <size:u32> <source:u32> <first:u32> <last:u32>
+    entries: 'a' <stamp:u32> <count:u8> <on:u16> then per sensor <avg:i16> <min:i16> <max:i16>
+             'n' | 'f' <stamp:u32>
+
+  Entry 'a' sums up the readings of a period (MONTH_PERIOD_SEC) starting at
+  stamp: their count, minutes relay was on, average, lowest and highest
+  reading of every sensor. Relay switches ('n', 'f') are kept exactly as
+  logged, after the period they belong to; their readings are the averages
+  of it. Entries go in time order. A period cut by the end of a data file
+  may show up twice, as two parts.
+
+  Binary log takes a byte or two per reading, so periods are long enough for
+  a month file to take a fraction of the data files it is made of.
+
+  Only `size` bytes of entries are read, what follows was left by a
+  compaction cut short by reboot and is cut off before the next append.
+  `first` and `last` are the stamps of the first and the last of them.
+  `source` is the key of the data file compacted into the month last (see
+  DataManifest.h): when that compaction is run again its entries are there
+  already. A month of other sensors count goes on in a file named YYMM_n.
+*/
+
+#ifndef MONTH_ARCHIVE_H
+#define MONTH_ARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FS.h"
+#include "LogFormat.h"
+#include "WString.h"
+
+#define MONTH_MAGIC_0 'T'
+#define MONTH_MAGIC_1 'M'
+#define MONTH_FORMAT_VERSION 1
+#define MONTH_HEADER_SIZE 20
+#define MONTH_SWITCH_SIZE 5
+#define MONTH_ENTRY_MAX_SIZE (8 + 6 * MAX_SENSORS_COUNT)
+#define MONTH_PERIOD_SEC 21600    // 6 hours, a dozen records logged every 30 minutes go into one entry
+#define MONTH_PERIOD_SWITCHES 16  // more relay switches in a period count for "on" minutes only
+#define MONTH_JSON_ENTRY_MAX (26 + 3 * (2 + MAX_SENSORS_COUNT * 6))  // [YYMMDDhhmm,"a",n,on,[..],[..],[..]]
+
+struct month_header {
+  uint8_t sensors;
+  uint32_t size;    // bytes of entries
+  uint32_t source;
+  uint32_t first;
+  uint32_t last;
+};
+
+struct month_entry {
+  char tag;
+  uint32_t stamp;
+  uint8_t count;
+  uint16_t on;  // minutes
+  int avg[MAX_SENSORS_COUNT];
+  int min[MAX_SENSORS_COUNT];
+  int max[MAX_SENSORS_COUNT];
+};
+
+// YYMM of local time, the month holding stamp
+uint16_t monthOf(time_t stamp);
+// YYMM[_n] name as a key (YYMM * 100 + n), 0 for other names
+uint32_t monthFileKey(const String &name);
+String monthFileName(uint32_t key);
+
+void monthHeaderEncode(const month_header *header, uint8_t *buf);
+// False if it is not a month file
+bool monthHeaderDecode(const uint8_t *buf, size_t len, month_header *header);
+size_t monthEntryEncode(const month_entry *entry, uint8_t sensors, uint8_t *buf);
+// Entry as the record charts draw: average readings of a period, or the relay switch
+void monthEntryToRecord(const month_entry *entry, uint8_t sensors, event_record *record);
+// `[YYMMDDhhmm,"a",count,on,[avg..],[min..],[max..]]`, relay switch as logRecordToJson() writes it
+size_t monthEntryToJson(const month_entry *entry, uint8_t sensors, packed_date_cache *cache, char *out);
+
+// Reads entries of a month file in order, up to the size in its header
+class MonthReader {
+ public:
+  // False if it is not a month file
+  bool open(File *file);
+  // Switch gets readings of the period before it. False past the last entry or on a broken one
+  bool next(month_entry *entry);
+
+  const month_header &header() const { return _header; }
+
+ protected:
+  File *_file;
+  month_header _header;
+  uint32_t _pos;  // bytes of entries read
+  int _avg[MAX_SENSORS_COUNT];
+};
+
+// Reduces records coming in time order to month entries. Relay state is kept across begin() calls,
+// data files are compacted one after another.
+class MonthBucketer {
+ public:
+  typedef void (*sink_t)(const month_entry *entry, void *ctx);
+
+  MonthBucketer();
+
+  void begin(uint8_t sensors, sink_t sink, void *ctx);
+  void add(const event_record *record);
+  // Hands the open period over
+  void finish();
+
+ protected:
+  void account(uint32_t until);
+  void flush();
+
+  sink_t _sink;
+  void *_ctx;
+  uint8_t _sensors;
+  bool _relayOn;
+  bool _open;
+  uint32_t _start;
+  uint32_t _cursor;  // relay time is accounted till here
+  uint32_t _onSec;
+  uint16_t _count;
+  long _sum[MAX_SENSORS_COUNT];
+  month_entry _entry;
+  uint32_t _switchAt[MONTH_PERIOD_SWITCHES];
+  char _switchEvent[MONTH_PERIOD_SWITCHES];
+  uint8_t _switchCount;
+};
+
+#endif
@@ -0,0 +1,230 @@
+#include <string.h>
+
+#include "RollingStats.h"
+
+#define TREND_MAX 32000  // tenths per hour, a faster change is cut to it
+
+static const uint32_t windows[STATS_WINDOWS] = {3600, 86400, 604800};
+
+static uint32_t slotSec(uint8_t w) {
+  return windows[w] / STATS_SLOTS;
+}
+
+RollingStats::RollingStats() : _sensors(0), _started(false), _relayOn(false), _since(0), _at(0) {
+  memset(_sensor, 0, sizeof(_sensor));
+  memset(_window, 0, sizeof(_window));
+}
+
+uint32_t RollingStats::windowSec(uint8_t w) {
+  return windows[w];
+}
+
+void RollingStats::begin(uint8_t sensors) {
+  _sensors = sensors;
+  memset(_sensor, 0, sizeof(_sensor));
+  for (uint8_t w = 0; w < STATS_WINDOWS; w++) {
+    for (uint8_t k = 0; k < MAX_SENSORS_COUNT; k++) {
+      _window[w].has[k] = false;
+      _window[w].mins[k].len = 0;
+      _window[w].maxs[k].len = 0;
+    }
+  }
+}
+
+void RollingStats::addReading(uint32_t now, const int *t) {
+  update(now);
+
+  for (uint8_t k = 0; k < _sensors; k++) {
+    sensor_stats *s = &_sensor[k];
+    int32_t x = (int32_t)t[k] * 256;
+
+    if (t[k] == STATS_NO_READING) {
+      continue;
+    }
+
+    if (!s->seen) {
+      s->seen = true;
+      s->ewma = x;
+      s->trend = 0;
+    } else {
+      s->ewma += (x - s->ewma) / (1 << STATS_EWMA_SHIFT);
+      if (now > s->lastAt) {
+        long rate = (long)(t[k] - s->last) * 3600 / (long)(now - s->lastAt);
+
+        rate = rate > TREND_MAX ? TREND_MAX : rate < -TREND_MAX ? -TREND_MAX : rate;
+        s->trend += (int32_t)(rate * 256 - s->trend) / (1 << STATS_EWMA_SHIFT);
+      }
+    }
+    s->last = t[k];
+    s->lastAt = now;
+
+    for (uint8_t w = 0; w < STATS_WINDOWS; w++) {
+      window_stats *win = &_window[w];
+
+      win->curMin[k] = !win->has[k] || t[k] < win->curMin[k] ? t[k] : win->curMin[k];
+      win->curMax[k] = !win->has[k] || t[k] > win->curMax[k] ? t[k] : win->curMax[k];
+      win->has[k] = true;
+    }
+  }
+}
+
+void RollingStats::relaySwitched(uint32_t now, bool on) {
+  update(now);
+
+  if (on && !_relayOn) {
+    for (uint8_t w = 0; w < STATS_WINDOWS; w++) {
+      _window[w].cycles[_window[w].slot % STATS_SLOTS]++;
+      _window[w].cycleSum++;
+    }
+  }
+  _relayOn = on;
+}
+
+// Relay time goes into the slots it was spent in. After a gap longer than a window only its last window is
+// accounted, the rest is out of every window already
+void RollingStats::update(uint32_t now) {
+  if (!_started) {
+    _started = true;
+    _since = _at = now;
+    for (uint8_t w = 0; w < STATS_WINDOWS; w++) {
+      _window[w].slot = now / slotSec(w);
+    }
+    return;
+  }
+  if (now <= _at) {
+    return;
+  }
+
+  for (uint8_t w = 0; w < STATS_WINDOWS; w++) {
+    window_stats *win = &_window[w];
+    uint32_t len = slotSec(w);
+    uint32_t t = now - _at > windows[w] ? now - windows[w] : _at;
+
+    while (t < now) {
+      uint32_t end = (t / len + 1) * len;
+      uint32_t until = now < end ? now : end;
+
+      roll(w, t / len);
+      if (_relayOn) {
+        win->on[win->slot % STATS_SLOTS] += until - t;
+        win->onSum += until - t;
+      }
+      t = until;
+    }
+    roll(w, now / len);
+  }
+  _at = now;
+}
+
+int RollingStats::ewma(uint8_t k) const {
+  int32_t v = _sensor[k].ewma;
+
+  return (v + (v >= 0 ? 128 : -128)) / 256;
+}
+
+int RollingStats::trend(uint8_t k) const {
+  int32_t v = _sensor[k].trend;
+
+  return (v + (v >= 0 ? 128 : -128)) / 256;
+}
+
+bool RollingStats::min(uint8_t w, uint8_t k, int *value) const {
+  const window_stats *win = &_window[w];
+  const extreme_deque *d = &win->mins[k];
+  bool found = d->len > 0;
+
+  if (found) {
+    *value = d->e[d->head].value;
+  }
+  if (win->has[k] && (!found || win->curMin[k] < *value)) {
+    *value = win->curMin[k];
+    found = true;
+  }
+  return found;
+}
+
+bool RollingStats::max(uint8_t w, uint8_t k, int *value) const {
+  const window_stats *win = &_window[w];
+  const extreme_deque *d = &win->maxs[k];
+  bool found = d->len > 0;
+
+  if (found) {
+    *value = d->e[d->head].value;
+  }
+  if (win->has[k] && (!found || win->curMax[k] > *value)) {
+    *value = win->curMax[k];
+    found = true;
+  }
+  return found;
+}
+
+uint32_t RollingStats::span(uint8_t w) const {
+  uint32_t len = slotSec(w);
+  uint32_t covered = _at % len + (STATS_SLOTS - 1) * len;
+
+  return _at - _since < covered ? _at - _since : covered;
+}
+
+// Closes the current slot and opens `slot`, slots between them are empty
+void RollingStats::roll(uint8_t w, uint32_t slot) {
+  window_stats *win = &_window[w];
+
+  if (slot <= win->slot) {
+    return;
+  }
+
+  for (uint8_t k = 0; k < _sensors; k++) {
+    if (win->has[k]) {
+      push(&win->mins[k], win->slot, win->curMin[k], true);
+      push(&win->maxs[k], win->slot, win->curMax[k], false);
+      win->has[k] = false;
+    }
+  }
+
+  if (slot - win->slot >= STATS_SLOTS) {
+    memset(win->on, 0, sizeof(win->on));
+    memset(win->cycles, 0, sizeof(win->cycles));
+    win->onSum = 0;
+    win->cycleSum = 0;
+    for (uint8_t k = 0; k < MAX_SENSORS_COUNT; k++) {
+      win->mins[k].len = 0;
+      win->maxs[k].len = 0;
+    }
+  } else {
+    for (uint32_t s = win->slot + 1; s <= slot; s++) {
+      uint8_t at = s % STATS_SLOTS;
+
+      win->onSum -= win->on[at];
+      win->cycleSum -= win->cycles[at];
+      win->on[at] = 0;
+      win->cycles[at] = 0;
+    }
+  }
+  win->slot = slot;
+
+  for (uint8_t k = 0; k < _sensors; k++) {
+    expire(&win->mins[k], slot);
+    expire(&win->maxs[k], slot);
+  }
+}
+
+// Entries the new value makes useless go from the back: a later slot with a lower (higher) value outlives them
+void RollingStats::push(extreme_deque *d, uint16_t slot, int16_t value, bool isMin) {
+  while (d->len > 0) {
+    int16_t back = d->e[(d->head + d->len - 1) % STATS_SLOTS].value;
+
+    if (isMin ? back < value : back > value) {
+      break;
+    }
+    d->len--;
+  }
+  d->e[(d->head + d->len) % STATS_SLOTS] = {slot, value};
+  d->len++;
+}
+
+void RollingStats::expire(extreme_deque *d, uint32_t slot) {
+  while (d->len > 0 && (uint16_t)((uint16_t)slot - d->e[d->head].slot) >= STATS_SLOTS) {
+    d->head = (d->head + 1) % STATS_SLOTS;
+    d->len--;
+  }
+}
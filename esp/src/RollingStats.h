@@ -0,0 +1,108 @@
+/*
+  RollingStats.h - running statistics of readings and relay, updated as they come
+
+  Every update takes constant time and nothing is kept per reading:
+
+  - EWMA of every sensor (1/2^STATS_EWMA_SHIFT weight of a new reading) and
+    its trend, EWMA of the change rate in tenths of degree per hour. Both
+    are fixed-point, 8 bits of fraction.
+  - Lowest and highest reading of every sensor over the last hour, day and
+    week. A window is STATS_SLOTS slots; the current slot keeps its own
+    min/max, closed slots go into a monotonic deque per sensor, so the
+    extreme of the window is the front of the deque or the current slot.
+  - Seconds relay was on and times it was switched on over the same
+    windows, a sum per slot and a running total.
+
+  The edge of a window moves by a slot: it covers the current slot and
+  STATS_SLOTS - 1 before it. Time is seconds of a monotonic clock (uptime),
+  not wall time which jumps when it is set.
+*/
+
+#ifndef ROLLING_STATS_H
+#define ROLLING_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "LogFormat.h"
+
+#define STATS_WINDOWS 3
+#define STATS_SLOTS 16      // a week goes by 10.5 hour slots, an hour by 225 seconds
+#define STATS_EWMA_SHIFT 4  // new reading weighs 1/16
+#define STATS_NO_READING -1270  // DS18B20 disconnected, tenths
+
+class RollingStats {
+ public:
+  RollingStats();
+
+  // Drops readings statistics, sensors changed. Relay statistics are kept
+  void begin(uint8_t sensors);
+  // Readings in tenths of degree, STATS_NO_READING ones are skipped
+  void addReading(uint32_t now, const int *t);
+  void relaySwitched(uint32_t now, bool on);
+  // Moves windows and relay time up to now, before they are read
+  void update(uint32_t now);
+
+  static uint32_t windowSec(uint8_t w);
+
+  bool seen(uint8_t k) const { return _sensor[k].seen; }
+  // Tenths, rounded
+  int ewma(uint8_t k) const;
+  // Tenths per hour
+  int trend(uint8_t k) const;
+  // False if there was no reading in the window
+  bool min(uint8_t w, uint8_t k, int *value) const;
+  bool max(uint8_t w, uint8_t k, int *value) const;
+  uint32_t onSec(uint8_t w) const { return _window[w].onSum; }
+  uint16_t cycles(uint8_t w) const { return _window[w].cycleSum; }
+  // Seconds of the window statistics cover, less than the window for a while after boot
+  uint32_t span(uint8_t w) const;
+
+ protected:
+  struct deque_entry {
+    uint16_t slot;  // low bits of slot number
+    int16_t value;
+  };
+
+  // Monotonic deque of closed slots extremes: values grow from the front (min) or fall (max)
+  struct extreme_deque {
+    deque_entry e[STATS_SLOTS];
+    uint8_t head;
+    uint8_t len;
+  };
+
+  struct sensor_stats {
+    bool seen;
+    int32_t ewma;   // tenths << 8
+    int32_t trend;  // tenths per hour << 8
+    int16_t last;
+    uint32_t lastAt;
+  };
+
+  struct window_stats {
+    uint32_t slot;  // number of the current slot, time / slot length
+    uint32_t on[STATS_SLOTS];
+    uint16_t cycles[STATS_SLOTS];
+    uint32_t onSum;
+    uint16_t cycleSum;
+    bool has[MAX_SENSORS_COUNT];  // current slot has a reading
+    int16_t curMin[MAX_SENSORS_COUNT];
+    int16_t curMax[MAX_SENSORS_COUNT];
+    extreme_deque mins[MAX_SENSORS_COUNT];
+    extreme_deque maxs[MAX_SENSORS_COUNT];
+  };
+
+  void roll(uint8_t w, uint32_t slot);
+  void push(extreme_deque *d, uint16_t slot, int16_t value, bool isMin);
+  void expire(extreme_deque *d, uint32_t slot);
+
+  uint8_t _sensors;
+  bool _started;
+  bool _relayOn;
+  uint32_t _since;  // first update
+  uint32_t _at;     // relay time is accounted till here
+  sensor_stats _sensor[MAX_SENSORS_COUNT];
+  window_stats _window[STATS_WINDOWS];
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include <Arduino.h>
+#include <string.h>
+
+#include "Scheduler.h"
+
+Scheduler::Scheduler() : _count(0), _size(0), _lastMillis(0), _wraps(0) {
+}
+
+uint64_t Scheduler::now() {
+  uint32_t ms = millis();
+
+  if (ms < _lastMillis) {
+    _wraps++;
+  }
+  _lastMillis = ms;
+
+  return ((uint64_t)_wraps << 32) | ms;
+}
+
+uint8_t Scheduler::add(const char *name, callback_t callback) {
+  scheduler_job *job;
+
+  if (_count >= SCHEDULER_JOBS_MAX) {
+    return SCHEDULER_IDLE;
+  }
+
+  job = &_jobs[_count];
+  memset(job, 0, sizeof(*job));
+  job->name = name;
+  job->callback = callback;
+  job->heapAt = SCHEDULER_IDLE;
+
+  return _count++;
+}
+
+void Scheduler::place(uint8_t at, uint8_t id) {
+  _heap[at] = id;
+  _jobs[id].heapAt = at;
+}
+
+void Scheduler::siftUp(uint8_t at) {
+  while (at > 0 && earlier(at, (at - 1) / 2)) {
+    uint8_t parent = (at - 1) / 2, id = _heap[at];
+
+    place(at, _heap[parent]);
+    place(parent, id);
+    at = parent;
+  }
+}
+
+void Scheduler::siftDown(uint8_t at) {
+  for (;;) {
+    uint8_t least = at, left = at * 2 + 1, right = at * 2 + 2, id = _heap[at];
+
+    if (left < _size && earlier(left, least))
+      least = left;
+    if (right < _size && earlier(right, least))
+      least = right;
+    if (least == at)
+      return;
+
+    place(at, _heap[least]);
+    place(least, id);
+    at = least;
+  }
+}
+
+void Scheduler::removeAt(uint8_t at) {
+  uint8_t id = _heap[at];
+
+  _jobs[id].heapAt = SCHEDULER_IDLE;
+  if (--_size > at) {
+    place(at, _heap[_size]);
+    siftDown(at);
+    siftUp(at);
+  }
+}
+
+void Scheduler::start(uint8_t id, uint32_t delayMs, uint32_t periodMs) {
+  scheduler_job *job = &_jobs[id];
+
+  job->due = now() + (delayMs ? delayMs : 1);  // at least a tick away, so run() can't spin on a job re-armed with 0
+  job->period = periodMs;
+
+  if (job->heapAt == SCHEDULER_IDLE) {
+    place(_size++, id);
+  }
+  siftDown(job->heapAt);
+  siftUp(job->heapAt);
+}
+
+void Scheduler::stop(uint8_t id) {
+  if (_jobs[id].heapAt != SCHEDULER_IDLE) {
+    removeAt(_jobs[id].heapAt);
+  }
+}
+
+void Scheduler::run() {
+  uint64_t t = now();
+
+  while (_size && _jobs[_heap[0]].due <= t) {
+    scheduler_job *job = &_jobs[_heap[0]];
+    uint32_t late = t - job->due, runUs;
+
+    if (job->period) {  // next deadline goes by the period, missed ones are skipped
+      job->due += job->period;
+      if (job->due <= t) {
+        job->due = t + job->period;
+      }
+      siftDown(0);
+    } else {
+      removeAt(0);
+    }
+
+    runUs = micros();
+    job->callback();
+    runUs = micros() - runUs;
+
+    job->runs++;
+    job->lateSumMs += late;
+    job->lateMaxMs = late > job->lateMaxMs ? late : job->lateMaxMs;
+    job->runSumUs += runUs;
+    job->runMaxUs = runUs > job->runMaxUs ? runUs : job->runMaxUs;
+  }
+}
+
+uint32_t Scheduler::idleMs(uint32_t limit) {
+  uint64_t t = now();
+
+  if (!_size || _jobs[_heap[0]].due >= t + limit) {
+    return limit;
+  }
+  return _jobs[_heap[0]].due > t ? _jobs[_heap[0]].due - t : 0;
+}
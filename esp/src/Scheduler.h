@@ -0,0 +1,69 @@
+/*
+  Scheduler.h - cooperative timers run from loop()
+
+  Jobs are kept in a min-heap by their deadline on a 64-bit millisecond clock
+  (millis() extended over its 49 days wrap), so run() looks at the nearest
+  deadline only and loop() may sleep idleMs() until it. Jobs are registered
+  once with add() and then started, restarted or stopped by their id. Every
+  job collects how late it was started and how long it ran.
+*/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+#define SCHEDULER_JOBS_MAX 12
+#define SCHEDULER_IDLE 0xff
+
+struct scheduler_job {
+  const char *name;
+  void (*callback)(void);
+  uint64_t due;
+  uint32_t period;  // ms, 0 - job runs once
+  uint8_t heapAt;   // SCHEDULER_IDLE when not started
+  uint32_t runs;
+  uint32_t lateMaxMs;
+  uint64_t lateSumMs;
+  uint32_t runMaxUs;
+  uint64_t runSumUs;
+};
+
+class Scheduler {
+ public:
+  typedef void (*callback_t)(void);
+
+  Scheduler();
+
+  // Id of the new job, SCHEDULER_IDLE if there is no room
+  uint8_t add(const char *name, callback_t callback);
+  // (Re)starts the job in delayMs, then every periodMs if it is not 0
+  void start(uint8_t id, uint32_t delayMs, uint32_t periodMs = 0);
+  void stop(uint8_t id);
+  bool started(uint8_t id) const { return _jobs[id].heapAt != SCHEDULER_IDLE; }
+
+  // Runs every job which is due
+  void run();
+  // Time till the nearest deadline, limit if there is none or it is later
+  uint32_t idleMs(uint32_t limit);
+
+  uint64_t now();
+  uint8_t count() const { return _count; }
+  const scheduler_job *job(uint8_t id) const { return &_jobs[id]; }
+
+ protected:
+  bool earlier(uint8_t a, uint8_t b) const { return _jobs[_heap[a]].due < _jobs[_heap[b]].due; }
+  void place(uint8_t at, uint8_t id);
+  void siftUp(uint8_t at);
+  void siftDown(uint8_t at);
+  void removeAt(uint8_t at);
+
+  scheduler_job _jobs[SCHEDULER_JOBS_MAX];
+  uint8_t _heap[SCHEDULER_JOBS_MAX];
+  uint8_t _count;
+  uint8_t _size;
+  uint32_t _lastMillis;
+  uint32_t _wraps;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include <string.h>
+
+#include "SensorRegistry.h"
+
+int SensorRegistry::find(const uint8_t *addr) const {
+  for (int i = 0; i < _count; i++) {
+    if (!memcmp(_known[i].addr, addr, SENSOR_ROM_SIZE))
+      return i;
+  }
+  return -1;
+}
+
+size_t SensorRegistry::load(const uint8_t *buf, size_t len) {
+  _count = 0;
+  for (; len >= SENSOR_RECORD_SIZE; buf += SENSOR_RECORD_SIZE, len -= SENSOR_RECORD_SIZE) {
+    setWeight(buf, buf[SENSOR_ROM_SIZE]);
+  }
+  return _count;
+}
+
+size_t SensorRegistry::save(uint8_t *buf) const {
+  for (int i = 0; i < _count; i++) {
+    memcpy(buf + i * SENSOR_RECORD_SIZE, _known[i].addr, SENSOR_ROM_SIZE);
+    buf[i * SENSOR_RECORD_SIZE + SENSOR_ROM_SIZE] = _known[i].weight;
+  }
+  return _count * SENSOR_RECORD_SIZE;
+}
+
+uint8_t SensorRegistry::weightOf(const uint8_t *addr, uint8_t fallback) const {
+  int i = find(addr);
+
+  return i >= 0 ? _known[i].weight : fallback;
+}
+
+void SensorRegistry::setWeight(const uint8_t *addr, uint8_t weight) {
+  int i = find(addr);
+  sensor_config entry;
+
+  if (i < 0 && _count < SENSORS_KNOWN_MAX) {
+    i = _count++;
+  } else if (i < 0) {  // full - the oldest one is dropped
+    i = 0;
+  }
+
+  memcpy(entry.addr, addr, SENSOR_ROM_SIZE);
+  entry.weight = weight;
+
+  memmove(_known + i, _known + i + 1, sizeof(sensor_config) * (_count - 1 - i));  // last set goes last
+  _known[_count - 1] = entry;
+}
@@ -0,0 +1,48 @@
+/*
+  SensorRegistry.h - weights of temperature probes keyed by their ROM code
+
+  Every probe ever configured is remembered with its weight, so a probe that
+  is unplugged and back, or moved to another place on the bus, keeps its
+  weight. Stored in SENSORS_FILE as records of 9 bytes:
+    <rom code: 8 bytes> <weight:u8>
+*/
+
+#ifndef SENSOR_REGISTRY_H
+#define SENSOR_REGISTRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SENSOR_ROM_SIZE 8
+#define SENSOR_RECORD_SIZE 9
+#define SENSORS_KNOWN_MAX 16
+
+struct sensor_config {
+  uint8_t addr[SENSOR_ROM_SIZE];
+  uint8_t weight;
+};
+
+class SensorRegistry {
+ public:
+  SensorRegistry() : _count(0) {}
+
+  // Replaces the registry with records of buf, returns number of probes taken
+  size_t load(const uint8_t *buf, size_t len);
+  // Writes records into buf of count() * SENSOR_RECORD_SIZE bytes, returns its length
+  size_t save(uint8_t *buf) const;
+
+  // Weight of the probe, fallback if it is not known
+  uint8_t weightOf(const uint8_t *addr, uint8_t fallback) const;
+  // Remembers weight of the probe, the least recently set one is forgotten when there is no room
+  void setWeight(const uint8_t *addr, uint8_t weight);
+
+  size_t count() const { return _count; }
+
+ protected:
+  int find(const uint8_t *addr) const;
+
+  sensor_config _known[SENSORS_KNOWN_MAX];
+  uint8_t _count;
+};
+
+#endif
@@ -4,25 +4,55 @@
 //#include <ESP8266mDNS.h>
 #include <DallasTemperature.h>
 #include <OneWire.h>
-#include <Ticker.h>
 #include <WiFiClient.h>
 #include <WiFiManager.h>  //https://github.com/tzapu/WiFiManager
 #include <coredecls.h>    // settimeofday_cb()
 #include <sys/time.h>
 #include <time.h>  // time() ctime()
 
-#include "ArduinoJson.h"
+#include "AppendBuffer.h"
+#include "DataManifest.h"
+#include "EventRing.h"
+#include "EventStream.h"
 #include "FS.h"
+#include "FieldTable.h"
+#include "FileStream.h"
+#include "GzipWriter.h"
+#include "JsonWriter.h"
 #include "LittleFS.h"  // LittleFS is declared
-#include "MyTicker.h"
-
-#define CONFIG_FILE "conf2"
+#include "LogAggregate.h"
+#include "LogCodec.h"
+#include "LogFormat.h"
+#include "LogIndex.h"
+#include "LogReader.h"
+#include "Metrics.h"
+#include "MonthArchive.h"
+#include "RollingStats.h"
+#include "Scheduler.h"
+#include "SensorRegistry.h"
+
+#define CONFIG_FILE "conf3"       // binary form of configFields, see FieldTable.h
+#define CONFIG_FILE_JSON "conf2"  // JSON of older firmware, read once and replaced by CONFIG_FILE
+#define CONFIG_FILE_MAX 128       // room for configFields in binary form, checked below them
+#define CONFIG_JSON_MAX 250
 #define SENSORS_FILE "sensors2"
+#define JOURNAL_FILE "journal"  // records logged before real time is known, with boot-relative stamps
 //#define DATA_FILE "data"
 #define DATA_DIR "/d"
 #define DATA_DIR_SLASH "/d/"
+#define INDEX_DIR_SLASH "/x/"  // stamp index of every data file under the same name, see LogIndex.h
+#define ARCHIVE_DIR_SLASH "/z/"  // gzip of /data?f= reply of sealed data files under the same name, see conf.gz
+#define ARCHIVE_TMP_SUFFIX ".t"  // archive being written, renamed when it is complete
+#define MONTH_DIR "/m"
+#define MONTH_DIR_SLASH "/m/"  // hourly summary of the data files retention compacted, see MonthArchive.h
 
 #define FS_BLOCK_SIZE 8180
+#define DATA_STAGE_MAX 512        // bytes of current data file kept in RAM, up to a page of the file system
+#define DATA_STAGE_MAX_HOURS 4    // staged records older than that are committed at the next flush
+#define INDEX_STAGE_ENTRIES 16    // index entries of staged chunks, committed with them
+#define RESPONSE_BUFFER_SIZE 1024
+#define AGG_DEFAULT_POINTS 200
+#define AGG_MAX_POINTS 400  // LTTB keeps 12 bytes per point in heap
 //#define FS_BLOCK_SIZE 1020
 
 #define WIFI_CONFIG_DURATION_SEC 150
@@ -33,12 +63,25 @@
 #define DST_SEC 0  //((DST_MN)*60)
 
 #define SEC 1
-#define MAX_SENSORS_COUNT 8
-#define TEMP_BYTE_SIZE 4
-#define STAMP_BYTE_SIZE 4
 
 #define FILE_CHECK_EACH_HOURS 20
-#define TICKERS 3
+#define DATA_ETAG_MAX 64
+#define DATA_HEAD_MAX 320  // header lines of a data file reply sent by downloads
+#define DATA_CACHE_MAX_AGE "31536000"  // a year, sealed data files never change
+#define DATA_BATCH_FILES_MAX 64  // data files of a /data?f= list, the rest is left out
+#define ARCHIVE_SLICE_RECORDS 16     // compressed per loop() pass, each slice takes a few ms
+#define ARCHIVE_SLICE_BYTES 256      // same for files of text era
+#define ARCHIVE_BOOT_DELAY_MS 60000  // files sealed before reboot are looked for once boot is over
+#define ARCHIVE_FS_RESERVE 16384     // no archiving when it would leave less free space
+#define RETENTION_CHECK_MS 60000     // file system use is looked at that often
+#define RETENTION_HIGH_PCT 80        // file system use retention starts at by default..
+#define RETENTION_LOW_PCT 70         // ..and goes on till it is below this one
+#define RETENTION_SLICE_RECORDS 32   // compacted per loop() pass
+#define MONTHS_MAX 60                // month files known, five years; the oldest one goes to make room
+#define SENSORS_RESCAN_EACH 12  // scans, bus is searched for added/removed probes
+#define LOOP_SLEEP_MAX_MS 10  // loop() naps till the next job, but no longer: it also serves http
+#define SENSORS_AVERAGE_NONE -12700  // hundredths, no sensor has weight
+#define EVENTS_KEEPALIVE_MS 15000  // comment line to /events subscribers, proxies close silent streams
 
 #define LED_PIN 4       // D2 on board
 #define RELAY_PIN 14    // D5 on NodeMCU and WeMos.
@@ -46,17 +89,6 @@
 
 //int current_log_id = 2;
 
-struct event_record {
-  time_t stamp;
-  char event;
-  int t[MAX_SENSORS_COUNT];
-};
-
-struct sensor_config {
-  uint8_t addr[8];
-  uint8_t weight;
-};
-
 struct config {
   int tl;
   int th;
@@ -66,6 +98,36 @@ struct config {
   unsigned int log;
   unsigned int flush;
   uint8_t blink;
+  uint8_t res[MAX_SENSORS_COUNT];  // DS18B20 resolution bits (9..12) by sensor index, 0 - default 12
+  uint8_t rhi;  // percent of file system used retention starts at, 0 - default
+  uint8_t rlo;  // percent it stops below, 0 - default
+  uint8_t gz;   // 1 - keep gzip archive of every sealed data file (about twice the flash of a binary one), 0 - none
+};
+
+// /conf?set= and /info "conf" keys, CONFIG_FILE tags. A field takes a line, its id is never reused
+constexpr field_desc configFields[] = {
+    FIELD(config, tl, 1),
+    FIELD(config, th, 2),
+    FIELD(config, ton, 3),
+    FIELD(config, toff, 4),
+    FIELD(config, read, 5),
+    FIELD(config, log, 6),
+    FIELD(config, flush, 7),
+    FIELD(config, blink, 8),
+    FIELD(config, res, 9),
+    FIELD(config, rhi, 10),
+    FIELD(config, rlo, 11),
+    FIELD(config, gz, 12),
+};
+#define CONFIG_FIELDS (sizeof(configFields) / sizeof(configFields[0]))
+static_assert(fieldsEncodedMax(configFields, CONFIG_FIELDS) <= CONFIG_FILE_MAX, "CONFIG_FILE_MAX is short of configFields");
+
+struct month_file {
+  uint32_t key;    // see monthFileKey()
+  uint8_t sensors;
+  uint32_t size;   // bytes of entries, as the header has it
+  uint32_t first;  // stamp of the first entry
+  uint32_t last;
 };
 
 const int MIN = SEC * 60;
@@ -73,7 +135,8 @@ const int LOOP_DELAY = 4 * SEC;
 const int SENSORS_READ_EACH = 5 * MIN;
 const int LOG_EACH = 10 * MIN;
 const int FLUSH_LOG_EACH = 60 * MIN;
-const int DATA_BUFFER_SIZE = 150;  // Maximum events we can keep in memory before Internet is back(===real time is known, and we can write a log)
+const int DATA_BUFFER_SIZE = 128;  // Events kept in memory between flushes. Must be power of 2
+const int DATA_BUFFER_SPILL = DATA_BUFFER_SIZE * 3 / 4;  // Ring level where records are moved to flash ahead of time (into journal until Internet is back)
 const int PIN_LED = LED_BUILTIN;   // D4 on NodeMCU and WeMos. Controls the onboard LED.
 
 bool initialConfig = false;
@@ -81,26 +144,57 @@ bool initialConfig = false;
 const char *strAllowOrigin = "Access-Control-Allow-Origin";
 const char *strAllowMethod = "Access-Control-Allow-Method";
 const char *strContentType = "application/json";
+const char *requestHeaders[] = {"If-None-Match", "Accept-Encoding", "Range", "If-Range"};  // server keeps only the headers it is told to collect
 
-event_record dataLog[DATA_BUFFER_SIZE];
+EventRing<event_record, DATA_BUFFER_SIZE> dataLog;
 event_record curSensors;
-
-config conf = {3, 10, 10, 10, 180, 1800, 7200, 1};
-
-Ticker led_sin_ticker;
-Ticker timers_aligner;
-
-MyTicker tickers[TICKERS];
+long curAverage = SENSORS_AVERAGE_NONE;  // weighted average of curSensors, hundredths of degree
+RollingStats stats;
+char responseBuf[RESPONSE_BUFFER_SIZE];  // every reply is streamed through it, see JsonWriter
+
+config conf = {3, 10, 10, 10, 180, 1800, 7200, 1, {0}, 0, 0, 0};
+
+Scheduler scheduler;
+uint8_t jobScan, jobRead, jobLog, jobFlush, jobLed, jobAlign, jobWifi, jobArchive, jobEvents, jobRetention;
+
+DataManifest dataManifest;
+FSInfo fsUsage;  // see fsUsageInfo()
+bool fsUsageStale = true;
+
+EventStream events;
+FileStream downloads;
+char eventBuf[LOG_JSON_RECORD_MAX + 64];  // one event data, handed to subscribers by a single flush()
+const char *eventName;
+
+GzipWriter archiveGzip;
+String archiveName;  // data file being compressed, empty when there is none
+File archiveData;
+File archiveOut;
+LogReader archiveReader;
+bool archiveBinary;
+packed_date_cache archiveCache;
+char archiveJsonBuf[LOG_JSON_RECORD_MAX + 8];
+
+month_file months[MONTHS_MAX];  // in key order, built at boot by monthsLoad()
+uint8_t monthsCount = 0;
+bool retentionActive = false;  // use went past the high mark and is not below the low one yet
+uint32_t retentionKey = 0;     // data file being compacted, 0 when there is none
+File retentionData;
+LogReader retentionReader;
+MonthBucketer retentionBucketer;
+File retentionMonth;
+int retentionMonthAt = -1;  // entry of retentionMonth in months, -1 when no month file is open
+month_header retentionHeader;
+bool retentionMonthDone;    // entries of the data file made it to the month file before, they are not written again
+bool retentionFailed;       // an entry did not make it to the month file, the data file is kept
 bool timersHourAligned = false;
 
-const size_t capacity = JSON_OBJECT_SIZE(7) * 2 + 50;
-
-DynamicJsonDocument doc(capacity);
 OneWire oneWire(ONE_WIRE_BUS);
 DallasTemperature DS18B20(&oneWire);
 ESP8266WebServer server(80);
 
-sensor_config sensor[MAX_SENSORS_COUNT];
+sensor_config sensor[MAX_SENSORS_COUNT];  // probes found on the bus, in the order of data columns
+SensorRegistry sensorRegistry;
 
 #define LED_WIFI 0
 #define LED_R_ON 1
@@ -125,15 +219,37 @@ time_t fileCheckedAt = 0;
 
 String currentFileName;
 long currentFileSize;
+uint32_t currentFileVerified;  // current data file is read back and found intact up to this offset
+uint8_t currentFileSensors;
+uint8_t logChunk[LOG_CHUNK_MAX];
+uint8_t dataStageBuf[DATA_STAGE_MAX];
+AppendBuffer dataFile(dataStageBuf, sizeof(dataStageBuf));  // current data file, kept open between flushes
+time_t dataStagedAt;  // when the oldest of staged bytes was appended
+uint8_t indexStage[INDEX_STAGE_ENTRIES * LOG_INDEX_ENTRY_SIZE];
+uint8_t indexStaged = 0;
+bool indexStageNew = false;  // first staged entry starts the index, index left from a file of the same name is dropped
+uint32_t dataSeqNext = 0;  // number the next record written to data file gets, see LogFormat.h
+LogChunkEncoder logEncoder;
+size_t logChunkRoom;
+bool journalUsed = false;
 
 int sensorsCount = 0;
-int dataLogPointer = 0;
 bool relayOn = false;
+bool sensorsConverting = false;  // conversion is started by scanSensors(), readings are taken by jobRead
+uint16_t sensorsConversionMs = 750;
+uint8_t scansSinceRescan = 0;
+bool sensorsNeedRescan = false;
+bool sensorsSetChanged = false;  // data columns mean other probes now, next flush starts a new file
 
+#ifdef ARDUINO
 extern "C" int clock_gettime(clockid_t unused, struct timespec *tp);
+#endif
 void WiFiSetup(void);
 void setTimers(void);
 void flushLogIntoFile(void);
+bool sensorsRescan(void);
+void loadSeqNext(void);
+void manifestScanCurrent(void);
 
 #define SERIAL_DEBUG 1
 #if SERIAL_DEBUG
@@ -154,7 +270,7 @@ void pwmLedManager2() {
     led_profile_phase = 0;
 
   if (led_profiles[led_current_profile][led_profile_phase]) {
-    led_sin_ticker.once(led_profiles[led_current_profile][led_profile_phase] / 10.0, pwmLedManager2);
+    scheduler.start(jobLed, led_profiles[led_current_profile][led_profile_phase] * 100);
 
     ledStatus = !ledStatus;
     led_profile_phase++;
@@ -176,13 +292,20 @@ void serverSendHeaders() {
   server.sendHeader(strAllowMethod, "GET, POST, HEAD");
 }
 
-void serverSend(String smth) {
+void serverSendChunk(const char *data, size_t len) {
+  server.sendContent(data, len);
+}
+
+// Starts chunked reply, body is to be written through JsonWriter on responseBuf
+void serverBeginStream(const char *contentType = strContentType) {
   serverSendHeaders();
-  server.send(200, strContentType, smth);
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, contentType, "");
 }
 
 void genFilename(String *fileName) {
   char buffer[8];
+  String name;
   int index = 0;
 
   timeTmp = localtime(&nowTime);
@@ -191,74 +314,244 @@ void genFilename(String *fileName) {
     (uint8)(timeTmp->tm_year - 100) % 100,
     (uint8)(timeTmp->tm_mon + 1) % 100,
     (uint8)timeTmp->tm_mday % 100);
-    *fileName = DATA_DIR_SLASH + String(buffer) + (index > 0 ? ("_" + String(index)) : "");
+    name = String(buffer) + (index > 0 ? ("_" + String(index)) : "");
     index++;
-  } while (LittleFS.exists(*fileName));
+  } while (dataManifest.find(dataFileKey(name)));
+  *fileName = DATA_DIR_SLASH + name;
 
   SERIAL_PRINT("New file name generated:");
   SERIAL_PRINTLN(*fileName);
 }
 
+String indexPath(const String &dataFileName) {
+  return INDEX_DIR_SLASH + dataFileName.substring(strlen(DATA_DIR_SLASH));
+}
+
+// File system usage, LittleFS.info() walks all the files so it is asked again only after they change
+const FSInfo &fsUsageInfo() {
+  if (fsUsageStale) {
+    LittleFS.info(fsUsage);
+    fsUsageStale = false;
+  }
+  return fsUsage;
+}
+
+uint32_t currentFileKey() {
+  return dataFileKey(currentFileName.substring(strlen(DATA_DIR_SLASH)));
+}
+
+// Manifest entry of the current file, made when there is none yet (file is new or removed behind our back)
+data_file_info *manifestCurrent() {
+  data_file_info *info = dataManifest.find(currentFileKey());
+
+  if (!info) {
+    data_file_info fresh = {currentFileKey(), 0, 0, 0, dataSeqNext, 0, false, true};
+
+    dataManifest.put(fresh);
+    info = dataManifest.find(fresh.key);
+  }
+  return info;
+}
+
+void dataFileCommitted(size_t programmed) {
+  if (programmed) {
+    fsUsageStale = true;
+    METRIC_ADD(METRIC_DATA_COMMITS, 1);
+    METRIC_ADD(METRIC_DATA_PROGRAMMED, programmed);
+  }
+}
+
+void dataFileAppend(const uint8_t *data, size_t len) {
+  if (dataFile.staged() == 0) {
+    dataStagedAt = nowTime;
+  }
+  METRIC_ADD(METRIC_FLASH_BYTES, len);
+  METRIC_ADD(METRIC_DATA_BYTES, len);
+  dataFileCommitted(dataFile.append(data, len));
+}
+
+// Writes staged chunks of the current file out, then index entries of them. Makes the file
+// complete on flash for readers.
+void dataFileCommit() {
+  File index;
+
+  dataFileCommitted(dataFile.commit());
+
+  if (indexStaged > 0) {
+    index = LittleFS.open(indexPath(currentFileName), indexStageNew ? "w" : "a");
+    if (index) {
+      METRIC_ADD(METRIC_FLASH_BYTES, index.write(indexStage, indexStaged * LOG_INDEX_ENTRY_SIZE));
+      index.close();
+    }
+    indexStaged = 0;
+    indexStageNew = false;
+  }
+}
+
+void dataFileClose() {
+  dataFileCommit();
+  dataFile.close();
+}
+
+// Current file is removed or formatted away, what is staged for it is dropped
+void dataFileDiscard() {
+  dataFile.discard();
+  indexStaged = 0;
+  indexStageNew = false;
+}
+
+void startNewFile() {
+  data_file_info *previous = dataManifest.find(currentFileKey());
+
+  dataFileClose();  // previous file is sealed, everything of it goes to flash
+  if (previous) {
+    previous->sealed = true;
+  }
+  genFilename(&currentFileName);
+  currentFileSize = 0;
+  currentFileVerified = 0;
+  manifestCurrent();
+
+  if (!scheduler.started(jobArchive)) {  // previous file is sealed now
+    scheduler.start(jobArchive, 0);
+  }
+}
+
 void setCurrentEvent(char type) {
   curSensors.stamp = start ? nowTime : millis() / 1000;  // записываем число секунд от загрузки если нет настоящего времени (нет интернета)
   curSensors.event = type;
 }
 
-String validFileCharacters = "0123456789-[],\"\"onfst";  // supported events are "on", "off", "st"
-
-bool checkFile(String *fileName) {
+// Reads the file from *verified offset (0 - from the start) to the end and moves *verified to the end of
+// intact data, or sets it to 0 when the file can't be appended at all (bad header, other sensors).
+bool checkFile(String *fileName, uint32_t *verified) {
+  METRIC_SCOPE(METRIC_CHECK_US);
   File file = LittleFS.open(*fileName, "r");
-  char ch;
+  LogReader reader;
+  event_record record;
+  bool passed;
 
   if (!file) {
+    *verified = 0;
     return false;
   }
 
-  while (file.available()) {
-    ch = file.read();
-    if (validFileCharacters.indexOf(ch) < 0) {
-      SERIAL_PRINTLN("File check failed because of '" + String(ch) + "'");
-      return false;
-    }
+  passed = reader.open(&file) && reader.sensors() == sensorsCount && reader.version() == LOG_FORMAT_VERSION;
+  if (passed && *verified > LOG_HEADER_SIZE) {
+    passed = reader.seek(*verified);
   }
+  while (passed && reader.next(&record))
+    ;
+  *verified = passed ? reader.intactEnd() : 0;
+  passed = passed && !reader.broken();
+  file.close();
 
-  SERIAL_PRINTLN("File check passed!");
-  return true;
+  SERIAL_PRINTLN(passed ? "File check passed!" : "File check failed: bad header or broken record");
+  return passed;
 }
 
-void writeToFile(String *line, String *fileName) {
+// Cuts the broken tail of current file off, down to the last intact chunk. Starts a new file if nothing can be kept.
+void recoverCurrentFile() {
   File file;
 
-  //if (!line->length()) return;
-  SERIAL_PRINTLN("writeToFile");
+  if (currentFileVerified >= LOG_HEADER_SIZE) {
+    file = LittleFS.open(currentFileName, "r+");
+  }
 
-  SERIAL_PRINT("File opened to append:");
-  SERIAL_PRINTLN(*fileName);
-  SERIAL_PRINTLN(*line);
+  if (file && file.truncate(currentFileVerified)) {
+    File index = LittleFS.open(indexPath(currentFileName), "r+");
+
+    if (index) {
+      logIndexTruncate(&index, currentFileVerified);
+      index.close();
+    }
+    currentFileSize = currentFileVerified;
+    manifestScanCurrent();
+
+    SERIAL_PRINT("Broken tail is cut off, size:");
+    SERIAL_PRINTLN(String(currentFileSize));
+  } else {
+    startNewFile();
+  }
+
+  if (file) {
+    file.close();
+  }
+  loadSeqNext();  // records cut off are numbered again
+}
+
+// Appends through dataFile, the data may stay staged in RAM for a while. Returns offset the data
+// is written at, -1 on failure.
+long writeToFile(const uint8_t *data, size_t len, String *fileName) {
+  METRIC_SCOPE(METRIC_WRITE_US);
+  long offset;
+
+  SERIAL_PRINTLN("writeToFile");
 
   if ((fileCheckedAt + FILE_CHECK_EACH_HOURS * 60 * 60) < nowTime) {
     SERIAL_PRINTLN("File check");
-    if (!checkFile(&currentFileName)) {
-      genFilename(&currentFileName);
+    dataFileClose();  // check reads what is on flash, recovery may cut the file
+    if (currentFileSize > 0 && !checkFile(&currentFileName, &currentFileVerified)) {
+      recoverCurrentFile();
     }
     fileCheckedAt = nowTime;
   }
 
-  file = LittleFS.open(*fileName, "a");
+  if (dataFile.path() != *fileName && !dataFile.open(*fileName)) {
+    startNewFile();
+    dataFile.open(currentFileName);
+  }
+
+  if (!dataFile.isOpen()) {
+    return -1;
+  }
+
+  if (dataFile.size() == 0) {
+    uint8_t header[LOG_HEADER_SIZE];
 
-  if (!file) {
-    genFilename(&currentFileName);
-    file = LittleFS.open(currentFileName, "a");
+    logHeaderEncode(header, currentFileSensors, LOG_FORMAT_VERSION, dataSeqNext);
+    dataFileAppend(header, LOG_HEADER_SIZE);
   }
+  offset = dataFile.size();
+  dataFileAppend(data, len);
 
-  if (file) {
-    file.print(*line);
+  currentFileSize = dataFile.size();
+  SERIAL_PRINT("ResultingSize:");
+  SERIAL_PRINTLN(String(currentFileSize));
 
-    currentFileSize = file.size();
-    SERIAL_PRINT("ResultingSize:");
-    SERIAL_PRINTLN(String(currentFileSize));
+  return offset;
+}
 
-    file.close();
+void writeLogChunk() {
+  log_index_entry entry;
+  data_file_info *info;
+  long offset;
+
+  entry.count = logEncoder.count();
+  entry.first = logEncoder.firstStamp();
+  entry.last = logEncoder.lastStamp();
+  entry.size = logEncoder.finish();
+
+  offset = writeToFile(logChunk, entry.size, &currentFileName);
+  if (offset < 0) {
+    return;
+  }
+
+  entry.offset = offset;
+  info = manifestCurrent();
+  if (info) {
+    info->size = currentFileSize;
+    info->first = info->records ? info->first : entry.first;
+    info->last = entry.last;
+    info->records += entry.count;
+  }
+  dataSeqNext += entry.count;
+  logIndexEntryEncode(&entry, indexStage + indexStaged++ * LOG_INDEX_ENTRY_SIZE);
+  indexStageNew = indexStageNew || offset == LOG_HEADER_SIZE;
+
+  // chunk went out with a page of staged bytes, or index stage is full
+  if (dataFile.staged() == 0 || indexStaged == INDEX_STAGE_ENTRIES) {
+    dataFileCommit();
   }
 }
 
@@ -272,7 +565,7 @@ void alignTimersToHour(bool force) {
         SERIAL_PRINT("Align to hour required after(sec): ");
         SERIAL_PRINTLN(String(delta));
 
-        timers_aligner.once(delta, [](void) { setTimers(); });
+        scheduler.start(jobAlign, delta * 1000);
         timersHourAligned = true;
       }
     }
@@ -295,53 +588,67 @@ void timeSyncCb() {
 }
 
 void putSensorsIntoDataLog() {
-  if (dataLogPointer < DATA_BUFFER_SIZE) {
-    // Prevent same event type on same timestamp is logged
-    if (dataLogPointer > 0) {
-      if ((dataLog[dataLogPointer - 1].stamp == curSensors.stamp) && (dataLog[dataLogPointer - 1].event == curSensors.event)) {
-        SERIAL_PRINT("Prevented log record duplicate: " + String(curSensors.stamp) + ", ["+ String(curSensors.event)+"]");
-        return;
-      }
-    }
-    dataLog[dataLogPointer] = curSensors;
-    dataLogPointer++;
+  const event_record *last = dataLog.newest();
+
+  // Prevent same event type on same timestamp is logged
+  if (last && last->stamp == curSensors.stamp && last->event == curSensors.event) {
+    SERIAL_PRINT("Prevented log record duplicate: " + String(curSensors.stamp) + ", ["+ String(curSensors.event)+"]");
+    return;
   }
+
+  if (!dataLog.push(curSensors)) {
+    SERIAL_PRINTLN("Data log is full, record dropped");
+    METRIC_ADD(METRIC_RECORDS_DROPPED, 1);
+    return;
+  }
+  METRIC_ADD(METRIC_RECORDS_LOGGED, 1);
+  METRIC_RING_LEVEL(dataLog.size());
 }
 
-String stampToPackedDate(time_t *time) {
-  char buffer[12];
+// Moves the oldest records from RAM into journal while real time is unknown. Stamps stay boot-relative,
+// they are fixed when journal is replayed into data file.
+void spillLogIntoJournal() {
+  uint8_t buf[LOG_RECORD_MAX_SIZE];
+  event_record record;
+  File file = LittleFS.open(JOURNAL_FILE, "a");
+
+  if (!file) {
+    return;
+  }
+
+  if (file.size() == 0) {
+    logHeaderEncode(buf, sensorsCount, LOG_FORMAT_FIXED);
+    METRIC_ADD(METRIC_FLASH_BYTES, file.write(buf, LOG_HEADER_SIZE));
+  }
+
+  while (dataLog.size() > DATA_BUFFER_SIZE / 4 && dataLog.pop(&record)) {
+    METRIC_ADD(METRIC_FLASH_BYTES, file.write(buf, logRecordEncode(&record, sensorsCount, buf)));
+  }
 
-  timeTmp = localtime(time);
+  SERIAL_PRINT("Log spilled into journal, size:");
+  SERIAL_PRINTLN(String(file.size()));
 
-  sprintf(buffer, "%02d%02d%02d%02d%02d",
-  (uint8)(timeTmp->tm_year - 100)%100,
-  (uint8)(timeTmp->tm_mon + 1)%100,
-  (uint8)timeTmp->tm_mday%100,
-  (uint8)timeTmp->tm_hour%100,
-  (uint8)timeTmp->tm_min%100
-  );
-  return String(buffer);
+  file.close();
+  journalUsed = true;
 }
 
+// Newest data file is continued, its tail is checked first
 void checkCurrentFileName() {
   if (currentFileName.length() == 0) {
-    Dir dir = LittleFS.openDir(DATA_DIR);
-    time_t maxWriteTime = 0;
-    time_t curFileTime;
-
-    while (dir.next()) {
-      curFileTime = dir.fileTime();
-      if (curFileTime > maxWriteTime) {
-        currentFileName = DATA_DIR_SLASH + dir.fileName();
-        currentFileSize = dir.fileSize();
-        maxWriteTime = curFileTime;
-      }
-    }
+    data_file_info *newest = dataManifest.newest();
 
-    if (!maxWriteTime) {
-      genFilename(&currentFileName);
-      currentFileSize = 0;
+    currentFileVerified = 0;
+    if (!newest) {
+      startNewFile();
+    } else {
+      currentFileName = DATA_DIR_SLASH + dataFileName(newest->key);
+      currentFileSize = newest->size;
+      newest->sealed = false;
+      if (!checkFile(&currentFileName, &currentFileVerified)) {
+        recoverCurrentFile();
+      }
     }
+    currentFileSensors = sensorsCount;
 
     SERIAL_PRINT(" #INIT current file:");
     SERIAL_PRINT(currentFileName);
@@ -350,64 +657,159 @@ void checkCurrentFileName() {
   }
 }
 
-String genDataLogLine(event_record *record) {
-  String data = "";
+time_t recordTime(const event_record *record) {
+  // маленькое число в stamp означает что запись была добавлена ДО синхронизации со временем и является числом секунд со старта.
+  return record->stamp > 900000000 ? record->stamp : (time_t)(nowTime - millis() / 1000 + record->stamp);
+}
 
-  if (record->event == 'b') {
-    data = ",\"st\"";
-  } else {
-    for (int k = 0; k < sensorsCount; k++) {
-      data += ",";
-      data += record->t[k];
+void jsonRecord(JsonWriter *json, const event_record *record, packed_date_cache *cache) {
+  event_record stamped = *record;
+
+  stamped.stamp = recordTime(record);
+  json->commit(logRecordToJson(&stamped, sensorsCount, cache, json->value(LOG_JSON_RECORD_MAX)));
+}
+
+void eventSink(const char *data, size_t len) {
+  if (len) {
+    METRIC_ADD(METRIC_EVENTS_DROPPED, events.publish(eventName, data, len));
+  }
+}
+
+// Event "t" after every reading: {"rel":0|1,"cur":[record],"avg":<weighted average>}
+void publishReading() {
+  JsonWriter json(eventBuf, sizeof(eventBuf), eventSink);
+  packed_date_cache cache;
+
+  if (!events.subscribers()) {
+    return;
+  }
+
+  packedDateReset(&cache);
+  eventName = "t";
+  json.beginObject().key("rel").num((long)relayOn).key("cur");
+  jsonRecord(&json, &curSensors, &cache);
+  json.key("avg").num(curAverage / 100.0f, 2).endObject();
+  json.flush();
+}
+
+// Event "rel" when relay is switched: {"rel":0|1,"cur":[record]}
+void publishRelay() {
+  JsonWriter json(eventBuf, sizeof(eventBuf), eventSink);
+  packed_date_cache cache;
+
+  if (!events.subscribers()) {
+    return;
+  }
+
+  packedDateReset(&cache);
+  eventName = "rel";
+  json.beginObject().key("rel").num((long)relayOn).key("cur");
+  jsonRecord(&json, &curSensors, &cache);
+  json.endObject();
+  json.flush();
+}
+
+void eventsKeepAlive() {
+  METRIC_ADD(METRIC_EVENTS_DROPPED, events.keepAlive());
+}
+
+void beginAppend() {
+  checkCurrentFileName();
+
+  if (currentFileSensors != sensorsCount || sensorsSetChanged) {  // records of other sensors can't share a file
+    startNewFile();
+    currentFileSensors = sensorsCount;
+    sensorsSetChanged = false;
+  }
+
+  logChunkRoom = FS_BLOCK_SIZE - (currentFileSize ? currentFileSize : LOG_HEADER_SIZE);
+  logEncoder.begin(logChunk, logChunkRoom, currentFileSensors);
+}
+
+void appendRecord(event_record *record) {
+  while (!logEncoder.add(record)) {
+    if (logEncoder.count() > 0) {
+      writeLogChunk();
     }
-    switch (record->event) {
-      case 'n':
-        data += ",\"on\"";
-        break;
-      case 'f':
-        data += ",\"off\"";
-        break;
+
+    if (logEncoder.count() == 0 || logChunkRoom < LOG_CHUNK_MAX) {  // file is full
+      startNewFile();
     }
+
+    logChunkRoom = FS_BLOCK_SIZE - (currentFileSize ? currentFileSize : LOG_HEADER_SIZE);
+    logEncoder.begin(logChunk, logChunkRoom, currentFileSensors);
   }
+}
 
-  // маленькое число в stamp означает что запись была добавлена ДО синхронизации со временем и является числом секунд со старта.
-  time_t time = record->stamp > 900000000 ? record->stamp : (time_t)(nowTime - millis() / 1000 + record->stamp);
+void endAppend() {
+  if (logEncoder.count() > 0) {
+    writeLogChunk();
+  }
 
-  return "[" + stampToPackedDate(&time) + data + "]";
+  if (dataFile.staged() > 0 && nowTime - dataStagedAt >= DATA_STAGE_MAX_HOURS * 60 * 60) {
+    dataFileCommit();
+  }
+}
+
+void replayJournal() {
+  File file = LittleFS.open(JOURNAL_FILE, "r");
+  LogReader reader;
+  event_record record;
+
+  if (file) {
+    if (reader.open(&file)) {
+      while (reader.next(&record)) {
+        record.stamp = recordTime(&record);
+        appendRecord(&record);
+      }
+    }
+    file.close();
+    LittleFS.remove(JOURNAL_FILE);
+  }
+  journalUsed = false;
 }
 
 void flushLogIntoFile() {
-  String all = "";
+  METRIC_SCOPE(METRIC_FLUSH_US);
+  event_record record;
 
   SERIAL_PRINTLN("Flush log events");
 
-  if (start == 0 || dataLogPointer == 0) {  // мы пишем лог только если знаем настоящее время.
+  if (start == 0 || (dataLog.size() == 0 && !journalUsed)) {  // мы пишем лог только если знаем настоящее время.
     return;
   }
 
-  checkCurrentFileName();
+  beginAppend();
 
-  all = currentFileSize > 0 ? "," : "[";
+  if (journalUsed) {
+    replayJournal();
+  }
 
-  for (int i = 0; i < dataLogPointer; i++) {
-    String line = genDataLogLine(&dataLog[i]);
+  while (dataLog.pop(&record)) {
+    record.stamp = recordTime(&record);
+    appendRecord(&record);
+  }
 
-    if (currentFileSize + all.length() + 1 + line.length() > FS_BLOCK_SIZE) {
-      if (all.length() > 2) {
-        writeToFile(&all, &currentFileName);
-      }
+  endAppend();
+}
 
-      genFilename(&currentFileName);
-      currentFileSize = 0;
-      all = "[" + line;
-    } else {
-      all += (i > 0 ? "," : "") + line;
-    }
-  }
+// Seconds of uptime, statistics don't jump when the clock is set
+uint32_t statsNow() {
+  return scheduler.now() / 1000;
+}
 
-  writeToFile(&all, &currentFileName);
+// Weighted average of curSensors in hundredths of degree, in integers
+long sensorsAverage() {
+  long sum = 0, weights = 0;
 
-  dataLogPointer = 0;
+  for (int i = 0; i < sensorsCount; i++) {
+    sum += (long)curSensors.t[i] * sensor[i].weight * 10;
+    weights += sensor[i].weight;
+  }
+  if (!weights) {
+    return SENSORS_AVERAGE_NONE;
+  }
+  return (sum + (sum >= 0 ? weights / 2 : -weights / 2)) / weights;
 }
 
 void setRelay(bool set) {
@@ -419,15 +821,41 @@ void setRelay(bool set) {
   SERIAL_PRINTLN(relayOn ? "ON" : "OFF");
 
   relaySwitchedAt = nowTime;
+  stats.relaySwitched(statsNow(), relayOn);
 
   setCurrentEvent(relayOn ? 'n' : 'f');
 
   putSensorsIntoDataLog();
+  publishRelay();
   flushLogIntoFile();
 }
 
+// Starts conversion on all sensors and returns at once, results are read by jobRead when it is over
 void scanSensors() {
-  float tC, w, ws = 0, average = 0;
+  METRIC_SCOPE(METRIC_SCAN_US);
+
+  if (sensorsConverting) {
+    return;
+  }
+
+  if (sensorsNeedRescan || ++scansSinceRescan >= SENSORS_RESCAN_EACH) {
+    scansSinceRescan = 0;
+    sensorsNeedRescan = false;
+    sensorsSetChanged = sensorsRescan() || sensorsSetChanged;
+  }
+
+  digitalWrite(PIN_LED, LOW);
+  DS18B20.requestTemperatures();
+
+  sensorsConverting = true;
+  scheduler.start(jobRead, sensorsConversionMs);
+}
+
+void readSensors() {
+  METRIC_SCOPE(METRIC_READ_US);
+  float tC;
+
+  sensorsConverting = false;
 
   gettimeofday(&tv, nullptr);
   clock_gettime(0, &tp);
@@ -435,52 +863,67 @@ void scanSensors() {
 
   setCurrentEvent('t');
 
-  digitalWrite(PIN_LED, LOW);
-  DS18B20.requestTemperatures();
-
   for (int i = 0; i < sensorsCount; i++) {
-    tC = DS18B20.getTempCByIndex(i);
+    tC = DS18B20.getTempC(sensor[i].addr);
+    if (tC == DEVICE_DISCONNECTED_C) {
+      sensorsNeedRescan = true;
+    }
     curSensors.t[i] = (int)round(tC * 10);
-
-    w = sensor[i].weight / 100.0;
-    ws += w;
-
-    average += tC * w;
   }
 
-  average = ws ? average / ws : -127;
+  curAverage = sensorsAverage();
+  stats.addReading(statsNow(), curSensors.t);
 
   digitalWrite(PIN_LED, HIGH);
 
-  if (average < -100 ||  // average -127 mean sensors problems so we better to switch off
-      (average >= conf.th && relayOn && nowTime - relaySwitchedAt >= (int)conf.ton)) {
+  publishReading();
+
+  if (curAverage < -10000 ||  // average -127 mean sensors problems so we better to switch off
+      (curAverage >= conf.th * 100L && relayOn && nowTime - relaySwitchedAt >= (int)conf.ton)) {
     setRelay(false);
     setLedProfile(LED_R_OFF);
   } else if (
-      average > -100  // -127 if contact is broken or if weights are all 0
-      && average <= conf.tl && !relayOn && nowTime - relaySwitchedAt >= (int)conf.toff) {
+      curAverage > -10000  // -127 if contact is broken or if there are no probes
+      && curAverage <= conf.tl * 100L && !relayOn && nowTime - relaySwitchedAt >= (int)conf.toff) {
     setRelay(true);
     setLedProfile(LED_R_ON);
   }
 }
 
-void setTimers() {
-  SERIAL_PRINTLN("Set timers");
+uint8_t sensorResolution(int i) {
+  return conf.res[i] >= 9 && conf.res[i] <= 12 ? conf.res[i] : 12;
+}
+
+uint8_t retentionHighPct() {
+  return conf.rhi > 0 && conf.rhi <= 100 ? conf.rhi : RETENTION_HIGH_PCT;
+}
 
-  tickers[0].attach(conf.read, scanSensors);
-  tickers[1].attach(conf.log, putSensorsIntoDataLog);
-  tickers[2].attach(conf.flush, flushLogIntoFile);
+uint8_t retentionLowPct() {
+  return conf.rlo > 0 && conf.rlo < retentionHighPct() ? conf.rlo : retentionHighPct() * RETENTION_LOW_PCT / RETENTION_HIGH_PCT;
 }
 
-void sensorsPrepareAddresses() {
-  for (byte i = 0; i < sensorsCount; i++) {
-    DS18B20.getAddress((uint8_t *)&sensor[i].addr, (uint8_t)i);
+void sensorsApplyResolution() {
+  uint8_t maxBits = 9;
 
-    sensor[i].weight = (byte)100 / sensorsCount;
+  for (int i = 0; i < sensorsCount; i++) {
+    if (DS18B20.getResolution(sensor[i].addr) != sensorResolution(i)) {  // resolution is kept in sensor EEPROM, avoid rewriting it
+      DS18B20.setResolution(sensor[i].addr, sensorResolution(i), true);
+    }
+    maxBits = sensorResolution(i) > maxBits ? sensorResolution(i) : maxBits;
   }
+  sensorsConversionMs = DS18B20.millisToWaitForConversion(maxBits);
+}
+
+void setTimers() {
+  SERIAL_PRINTLN("Set timers");
+
+  scheduler.start(jobScan, conf.read * 1000UL, conf.read * 1000UL);
+  scheduler.start(jobLog, conf.log * 1000UL, conf.log * 1000UL);
+  scheduler.start(jobFlush, conf.flush * 1000UL, conf.flush * 1000UL);
 }
 
-void sensorsParseString(String *line, byte *buffer) {
+// Returns number of "a0 a1 .. a7 weight" records parsed
+int sensorsParseString(String *line, byte *buffer) {
   int ptr = 0, sum = 0;
 
   for (unsigned i = 0; i < line->length(); i++) {
@@ -493,277 +936,1542 @@ void sensorsParseString(String *line, byte *buffer) {
       sum = 0;
     }
 
-    if (ptr >= MAX_SENSORS_COUNT * 9)
-      return;
+    if (ptr >= MAX_SENSORS_COUNT * SENSOR_RECORD_SIZE)
+      return ptr / SENSOR_RECORD_SIZE;
   }
   buffer[ptr] = (byte)sum;
+  return (ptr + 1) / SENSOR_RECORD_SIZE;
 }
 
-void sensorsBufferToFile(byte *buffer) {
+void sensorsToFile() {
+  byte buffer[SENSOR_RECORD_SIZE * SENSORS_KNOWN_MAX];
   File file = LittleFS.open(SENSORS_FILE, "w");  // Open it
-  file.write(buffer, sensorsCount * 9);
+
+  file.write(buffer, sensorRegistry.save(buffer));
   file.close();
 
   SERIAL_PRINT("Sensor data saved to file");
 }
 
-void sensorsBufferFromFile(byte *buffer) {
+void sensorsFromFile() {
   if (LittleFS.exists(SENSORS_FILE)) {
+    byte buffer[SENSOR_RECORD_SIZE * SENSORS_KNOWN_MAX];
     File file = LittleFS.open(SENSORS_FILE, "r");
-    file.readBytes((char *)buffer, sensorsCount * 9);
+    size_t len = file.readBytes((char *)buffer, sizeof(buffer));
+
     file.close();
-    // if (bytes < sensorsCount*9 )
-    //   SERIAL_PRINTLN("--SERIOUS: sensor data read less than expected--");
-    // else
-    //   SERIAL_PRINTLN("Sensor data is read from file");
+    sensorRegistry.load(buffer, len);
   }
 }
 
-void sensorsApplyBufferOn(byte *buffer) {
-  for (byte i = 0; i < sensorsCount; i++) {
-    for (byte j = 0; j < sensorsCount; j++) {
-      int comp = 0;
-
-      while (comp < 8 && sensor[i].addr[j] == buffer[i * 9 + j])
-        comp++;
+// Probes nobody set weight for count 0, unless no probe on the bus has one: then they all count equally,
+// so swapped probes or a registry of other probes do not leave the relay without an average
+void sensorsApplyWeights() {
+  bool weighted = false;
 
-      if (comp == 8) {
-        sensor[i].weight = buffer[i * 9 + 8];
-        break;
-      }
-    }
+  for (int i = 0; i < sensorsCount; i++) {
+    sensor[i].weight = sensorRegistry.weightOf(sensor[i].addr, 0);
+    weighted = weighted || sensor[i].weight;
   }
+  for (int i = 0; !weighted && i < sensorsCount; i++) {
+    sensor[i].weight = 100 / sensorsCount;
+  }
+  curAverage = sensorsAverage();
 }
 
-void serverSendfile(String fileName) {
-  File f = LittleFS.open(DATA_DIR_SLASH + fileName, "r");
+// Searches the bus for probes, true if they differ from the current ones. Log gathered for the old set
+// is flushed before the set is switched. Before real time is known it can't be flushed, and journal
+// records its width once, so that log is dropped.
+bool sensorsRescan() {
+  uint8_t found[MAX_SENSORS_COUNT][SENSOR_ROM_SIZE];
+  int count = 0;
+  bool same;
+
+  oneWire.reset_search();
+  while (count < MAX_SENSORS_COUNT && oneWire.search(found[count])) {
+    if (DS18B20.validAddress(found[count]) && DS18B20.validFamily(found[count]))
+      count++;
+  }
 
-  if (f) {
-    char buf[2048];
-    size_t sent = 0;
-    int siz = f.size();
+  same = count == sensorsCount;
+  for (int i = 0; same && i < count; i++) {
+    same = !memcmp(found[i], sensor[i].addr, SENSOR_ROM_SIZE);
+  }
+  if (same) {
+    return false;
+  }
 
-    serverSendHeaders();
-    server.setContentLength(siz + 1);
-    server.send(200, strContentType, "");
+  SERIAL_PRINT("Sensors set changed, count:");
+  SERIAL_PRINTLN(count);
 
-    while (siz > 0) {
-      size_t len = std::min((int)(sizeof(buf) - 1), siz);
-      f.read((uint8_t *)buf, len);
+  if (start && sensorsCount) {
+    flushLogIntoFile();
+  } else if (sensorsCount) {
+    event_record record;
 
-      server.sendContent(buf, len);
-      siz -= len;
-      sent += len;
+    METRIC_ADD(METRIC_RECORDS_DROPPED, dataLog.size());
+    while (dataLog.pop(&record)) {
     }
-    f.close();
-
-    server.sendContent("]", 1);
+    LittleFS.remove(JOURNAL_FILE);
+    journalUsed = false;
+  }
 
-  } else {
-    serverSendHeaders();
-    server.send(404, strContentType, "File Not Found: " + String(DATA_DIR_SLASH) + fileName);
-    SERIAL_PRINTLN("Bad open file " + fileName);
+  sensorsCount = count;
+  for (int i = 0; i < count; i++) {
+    memcpy(sensor[i].addr, found[i], SENSOR_ROM_SIZE);
   }
-}
+  stats.begin(count);
+  sensorsApplyWeights();
+  sensorsApplyResolution();
 
-void parseConfJson(String *json) {
-  DeserializationError err = deserializeJson(doc, *json);
+  return true;
+}
 
-  SERIAL_PRINT("Conf parse ");
-  SERIAL_PRINTLN(err.c_str());
+// Validator of a data file: name, size and its last 4 bytes (CRC of the last chunk in a chunked file).
+// Files but the current one are never written again, they get a strong tag, the current one a weak tag.
+void dataFileEtag(File *f, const String &fileName, bool sealed, bool gzip, char *etag) {
+  uint8_t tail[4] = {0, 0, 0, 0};
+  size_t size = f->size();
 
-  if (!err) {
-    conf.tl = doc["tl"].as<int>();
-    conf.th = doc["th"].as<int>();
-    conf.ton = doc["ton"].as<int>();
-    conf.toff = doc["toff"].as<int>();
-    conf.read = doc["read"].as<int>();
-    conf.log = doc["log"].as<int>();
-    conf.flush = doc["flush"].as<int>();
-    conf.blink = doc["blink"].as<int>();
+  if (size >= sizeof(tail) && f->seek(size - sizeof(tail))) {
+    f->read(tail, sizeof(tail));
   }
-}
+  f->seek(0);
 
-void handleInfo() {
-  String msg = "{";
+  snprintf(etag, DATA_ETAG_MAX, "%s\"%s-%x-%02x%02x%02x%02x%s\"", sealed ? "" : "W/", fileName.c_str(), (unsigned)size,
+           tail[0], tail[1], tail[2], tail[3], gzip ? "-gz" : "");
+}
 
-  nowTime = time(nullptr);
+// If-None-Match lists tags separated by commas, they are compared weakly (W/ prefix is ignored)
+bool etagMatches(const String &ifNoneMatch, const char *etag) {
+  const char *p = ifNoneMatch.c_str();
 
-  if (server.arg("cur").length() > 0) {
-    float w, ws = 0, average = 0;
-    unsigned long upTime = start ? nowTime - start : millis() / 1000;
+  if (strncmp(etag, "W/", 2) == 0) {
+    etag += 2;
+  }
 
-    if (server.arg("f").length() > 0)
-      scanSensors();
+  while (*p) {
+    const char *end;
 
-    msg += "\"up\":" + String(upTime) + ",\"rel\":" + String((int)relayOn) + ",\"cur\":" + genDataLogLine(&curSensors);
+    while (*p == ' ' || *p == ',')
+      p++;
+    if (strncmp(p, "W/", 2) == 0)
+      p += 2;
+    end = p;
+    while (*end && *end != ',' && *end != ' ')
+      end++;
 
-    for (int i = 0; i < sensorsCount; i++) {
-      w = sensor[i].weight / 100.0;
-      ws += w;
-      average += curSensors.t[i] * w / 10;
+    if ((end - p == 1 && *p == '*') || ((size_t)(end - p) == strlen(etag) && strncmp(p, etag, end - p) == 0)) {
+      return true;
     }
+    p = end;
+  }
+  return false;
+}
 
-    average = ws ? average / ws : -127;
-    msg += ",\"avg\":" + String(average) + "}";
+bool dataFileSealed(const String &fileName) {
+  return currentFileName.length() > 0 && currentFileName != DATA_DIR_SLASH + fileName;
+}
 
-  } else if (server.arg("last").length() > 0) {
-    msg += "\"last\":[";
+// Replies 304 and returns true when client has the data file already. Otherwise the caching headers are
+// left in head for the reply sent by downloads, the tag in etag (DATA_ETAG_MAX bytes)
+bool serverSendCached(File *f, const String &fileName, bool sealed, bool gzip, char *etag, char *head, size_t size) {
+  const char *cacheControl = sealed ? "public, max-age=" DATA_CACHE_MAX_AGE ", immutable" : "no-cache";
 
-    if (start != 0 && dataLogPointer != 0) {  // мы пишем лог только если знаем настоящее время.
-      for (int i = 0; i < dataLogPointer; i++) {
-        String line = genDataLogLine(&dataLog[i]);
+  dataFileEtag(f, fileName, sealed, gzip, etag);
 
-        msg += (i > 0 ? "," : "") + line;
-      }
-    }
+  if (server.hasHeader("If-None-Match") && etagMatches(server.header("If-None-Match"), etag)) {
+    server.sendHeader("ETag", etag);
+    server.sendHeader("Vary", "Accept-Encoding");
+    server.sendHeader("Cache-Control", cacheControl);
+    serverSendHeaders();
+    server.send(304, strContentType, "");
+    return true;
+  }
 
-    msg += "]}";
-  } else {
-    FSInfo fs;
-    float flag = false;
-
-    LittleFS.info(fs);
-
-    msg += "\"fs\":{\"tot\":";
-    msg += fs.totalBytes;
-    msg += ",\"used\":";
-    msg += fs.usedBytes;
-    msg += ",\"block\":";
-    msg += fs.blockSize;
-    msg += ",\"page\":";
-    msg += fs.pageSize;
-    msg += "},\"rel\":";
-    msg += (int)relayOn;
-    msg += ",\"cur\":[";
-    for (int i = 0; i < sensorsCount; i++) {
-      if (i > 0)
-        msg += ",";
-
-      msg += curSensors.t[i];
-    }
-    msg += "],\"conf\":{\"tl\":";
-    msg += conf.tl;
-    msg += ",\"th\":";
-    msg += conf.th;
-    msg += ",\"ton\":";
-    msg += conf.ton;
-    msg += ",\"toff\":";
-    msg += conf.toff;
-    msg += ",\"read\":";
-    msg += conf.read;
-    msg += ",\"log\":";
-    msg += conf.log;
-    msg += ",\"flush\":";
-    msg += conf.flush;
-    msg += ",\"blink\":";
-    msg += conf.blink;
-    msg += "},\"sn\":\"";
+  snprintf(head, size,
+           "%s: *\r\n%s: GET, POST, HEAD\r\nETag: %s\r\nVary: Accept-Encoding\r\nCache-Control: %s\r\n%s",
+           strAllowOrigin, strAllowMethod, etag, cacheControl, gzip ? "Content-Encoding: gzip\r\n" : "");
+  return false;
+}
 
-    for (int i = 0; i < sensorsCount; i++) {
-      if (i > 0)
-        msg += ",";
+// Part of a reply of total bytes the request asks for, Range: bytes=first-last, first- or -suffix. 206 with
+// from and length set, 416 when it starts past the end, 200 when the whole reply goes: no range, a list of
+// them, or If-Range of other version. A weak tag is never taken for the same version.
+int requestRange(uint32_t total, const char *etag, uint32_t *from, uint32_t *length) {
+  String range = server.header("Range");
+  const char *p = range.c_str() + 6;
+  char *end;
+  unsigned long first, last;
+
+  if (!server.hasHeader("Range") || strncmp(range.c_str(), "bytes=", 6) != 0 || strchr(p, ',') ||
+      (server.hasHeader("If-Range") && (strncmp(etag, "W/", 2) == 0 || server.header("If-Range") != etag))) {
+    return 200;
+  }
 
-      for (int k = 0; k < 8; k++) {
-        msg += String(sensor[i].addr[k]);
-        msg += ' ';
-      }
-      msg += String(sensor[i].weight);
+  if (*p == '-') {
+    last = strtoul(p + 1, &end, 10);
+    if (end == p + 1 || *end) {
+      return 200;
     }
-
-    msg += "\",\"dt\":[";
-
-    Dir dir = LittleFS.openDir(DATA_DIR);
-    while (dir.next()) {
-      if (flag)
-        msg += ",";
-      msg += "{\"n\":\"";
-      msg += dir.fileName();
-      msg += "\",\"s\":";
-      msg += dir.fileSize();
-
-      flag = true;
-      msg += "}";
+    if (last == 0) {
+      return 416;
+    }
+    first = last < total ? total - last : 0;
+    last = total - 1;
+  } else {
+    first = strtoul(p, &end, 10);
+    if (end == p || *end != '-') {
+      return 200;
     }
-    msg += "]}";
+    p = end + 1;
+    last = *p ? strtoul(p, &end, 10) : total - 1;
+    if (*p && (*end || last < first)) {
+      return 200;
+    }
+    last = last < total ? last : total - 1;
   }
 
-  serverSend(msg);
+  if (first >= total) {
+    return 416;
+  }
+  *from = first;
+  *length = last - first + 1;
+  return 206;
 }
 
-void handleConfig() {
-    String msg;
-    String json = server.arg("set");
-    parseConfJson(&json);
+bool clientAcceptsGzip() {
+  return server.hasHeader("Accept-Encoding") && server.header("Accept-Encoding").indexOf("gzip") >= 0;
+}
 
-    File file = LittleFS.open(CONFIG_FILE, "w");  // Open it
-    file.println(server.arg("set"));
-    file.close();  // Then close the file again
+// Reply body goes out from loop() by downloads, the handler returns as soon as the file is handed over.
+// A range is of the bytes the client gets: of the archive when it goes gzipped, of a text era file with "]"
+// after it. JSON of a binary log is made on the way, its bytes aren't known without converting it all, so
+// it always goes whole.
+void serverSendfile(String fileName) {
+  bool sealed = dataFileSealed(fileName);
+  char etag[DATA_ETAG_MAX];
+  char head[DATA_HEAD_MAX];
+  uint32_t total = 0, from = 0, length = 0;
+  size_t len;
+  int code = 200;
+
+  if (!sealed) {
+    dataFileCommit();
+  }
+
+  File f = LittleFS.open(DATA_DIR_SLASH + fileName, "r");
+  bool gzip = f && sealed && clientAcceptsGzip() && LittleFS.exists(ARCHIVE_DIR_SLASH + fileName);
+
+  if (!f) {
+    serverSendHeaders();
+    server.send(404, strContentType, "File Not Found: " + String(DATA_DIR_SLASH) + fileName);
+    SERIAL_PRINTLN("Bad open file " + fileName);
+    return;
+  }
+  if (serverSendCached(&f, fileName, sealed, gzip, etag, head, sizeof(head))) {
+    f.close();
+    return;
+  }
+  if (downloads.full()) {
+    f.close();
+    serverSendHeaders();
+    server.sendHeader("Retry-After", "2");
+    server.send(503, strContentType, "{\"err\":\"busy\"}");
+    return;
+  }
+
+  const data_file_info *info = dataManifest.find(dataFileKey(fileName));
+  bool ranges = gzip || (info && !info->binary);
+
+  if (gzip) {  // archive has the same reply compressed
+    f.close();
+    f = LittleFS.open(ARCHIVE_DIR_SLASH + fileName, "r");
+  }
+  len = strlen(head);
+  snprintf(head + len, sizeof(head) - len, "Accept-Ranges: %s\r\n", ranges ? "bytes" : "none");
+  if (ranges && server.hasHeader("Range")) {
+    total = f.size() + (gzip ? 0 : 1);
+    code = requestRange(total, etag, &from, &length);
+  }
+
+  if (code == 416) {
+    f.close();
+    serverSendHeaders();
+    server.sendHeader("Content-Range", "bytes */" + String(total));
+    server.send(416, strContentType, "");
+  } else if (code == 206) {
+    len = strlen(head);
+    snprintf(head + len, sizeof(head) - len, "Content-Range: bytes %lu-%lu/%lu\r\n", (unsigned long)from,
+             (unsigned long)(from + length - 1), (unsigned long)total);
+    downloads.sendFileRange(server.client(), f, strContentType, head, gzip ? "" : "]", from, length);
+  } else if (gzip) {
+    downloads.sendFile(server.client(), f, strContentType, head, "");
+  } else if (!downloads.sendLog(server.client(), f, strContentType, head)) {  // file of text era, stored as JSON fragments already
+    downloads.sendFile(server.client(), f, strContentType, head, "]");
+  }
+}
+
+// Appends name to the comma separated list unless it is full. Staged records of the current file go to
+// flash first, as serverSendfile() does
+void batchAdd(String *names, uint8_t *count, const String &name) {
+  if (*count == DATA_BATCH_FILES_MAX) {
+    return;
+  }
+  if (DATA_DIR_SLASH + name == currentFileName) {
+    dataFileCommit();
+  }
+  if (*count) {
+    *names += ",";
+  }
+  *names += name;
+  (*count)++;
+}
+
+// Data files of a list in one reply, see FileStream.h. A name ending in "*" stands for every data file
+// it starts, 2103* is March 2021. Names which are not of data files are left out.
+void serverSendBatch(const String &list) {
+  char head[DATA_HEAD_MAX];
+  String names;
+  uint8_t count = 0;
+  unsigned int pos = 0;
+
+  while (pos <= list.length()) {
+    int comma = list.indexOf(',', pos);
+    String item = list.substring(pos, comma < 0 ? list.length() : comma);
+
+    pos = comma < 0 ? list.length() + 1 : comma + 1;
+    if (item.endsWith("*")) {
+      String prefix = item.substring(0, item.length() - 1);
+
+      for (size_t i = 0; i < dataManifest.count(); i++) {
+        String name = dataFileName(dataManifest.at(i)->key);
+
+        if (name.startsWith(prefix)) {
+          batchAdd(&names, &count, name);
+        }
+      }
+    } else if (dataFileKey(item) != 0) {
+      batchAdd(&names, &count, item);
+    }
+  }
+
+  snprintf(head, sizeof(head), "%s: *\r\n%s: GET, POST, HEAD\r\nCache-Control: no-cache\r\n", strAllowOrigin, strAllowMethod);
+  if (!downloads.sendBatch(server.client(), DATA_DIR_SLASH, names, strContentType, head, "]")) {
+    serverSendHeaders();
+    server.sendHeader("Retry-After", "2");
+    server.send(503, strContentType, "{\"err\":\"busy\"}");
+  }
+}
+
+void archiveGzipSink(const uint8_t *data, size_t len, void *ctx) {
+  METRIC_ADD(METRIC_FLASH_BYTES, ((File *)ctx)->write(data, len));
+}
+
+void archiveJsonSink(const char *data, size_t len) {
+  archiveGzip.write((const uint8_t *)data, len);
+}
+
+JsonWriter archiveJson(archiveJsonBuf, sizeof(archiveJsonBuf), archiveJsonSink);
+
+void archiveAbort() {
+  if (archiveName.length() > 0) {
+    archiveGzip.abort();
+    archiveData.close();
+    archiveOut.close();
+    LittleFS.remove(ARCHIVE_DIR_SLASH + archiveName + ARCHIVE_TMP_SUFFIX);
+    archiveName = "";
+  }
+}
+
+// Opens the first sealed data file which has no archive yet, false if there is none or no room for it.
+// Archives are made only when conf.gz asks for them: gzip of the JSON reply takes about twice the flash of
+// a binary data file, and retention would start sooner. Nor are they made past the low mark of retention,
+// they would only be removed by it. Archives made before are served till their data files go.
+bool archiveBegin() {
+  if (!conf.gz || currentFileName.length() == 0) {
+    return false;
+  }
+
+  for (size_t i = 0; i < dataManifest.count(); i++) {
+    const data_file_info *info = dataManifest.at(i);
+    String name = dataFileName(info->key);
+
+    if (!info->sealed || info->key == retentionKey || LittleFS.exists(ARCHIVE_DIR_SLASH + name)) {
+      continue;
+    }
+
+    const FSInfo &fs = fsUsageInfo();
+    if (fs.totalBytes - fs.usedBytes < info->size + ARCHIVE_FS_RESERVE ||
+        fs.usedBytes + info->size > (uint64_t)fs.totalBytes * retentionLowPct() / 100) {
+      return false;
+    }
+
+    archiveData = LittleFS.open(DATA_DIR_SLASH + name, "r");
+    archiveOut = LittleFS.open(ARCHIVE_DIR_SLASH + name + ARCHIVE_TMP_SUFFIX, "w");
+    if (!archiveData || !archiveOut || !archiveGzip.begin(archiveGzipSink, &archiveOut)) {
+      archiveData.close();
+      archiveOut.close();
+      return false;
+    }
+
+    archiveName = name;
+    archiveBinary = archiveReader.open(&archiveData);
+    if (archiveBinary) {  // the same JSON serverSendfile() makes
+      packedDateReset(&archiveCache);
+      archiveJson = JsonWriter(archiveJsonBuf, sizeof(archiveJsonBuf), archiveJsonSink);
+      archiveJson.beginArray();
+    } else {
+      archiveData.seek(0);
+    }
+    return true;
+  }
+  return false;
+}
+
+// Compresses a slice of the sealed data file into its archive, job is re-armed while there are files left
+void archiveSlice() {
+  METRIC_SCOPE(METRIC_ARCHIVE_US);
+  bool done;
+
+  if (archiveName.length() == 0 && !archiveBegin()) {
+    return;
+  }
+
+  if (archiveBinary) {
+    event_record record;
+    int count = 0;
+
+    while (count < ARCHIVE_SLICE_RECORDS && archiveReader.next(&record)) {
+      archiveJson.commit(logRecordToJson(&record, archiveReader.sensors(), &archiveCache, archiveJson.value(LOG_JSON_RECORD_MAX)));
+      count++;
+    }
+    done = count < ARCHIVE_SLICE_RECORDS;
+    if (done) {
+      archiveJson.endArray().flush();
+    }
+  } else {
+    uint8_t buf[ARCHIVE_SLICE_BYTES];
+    size_t len = archiveData.read(buf, sizeof(buf));
+
+    archiveGzip.write(buf, len);
+    done = len < sizeof(buf);
+    if (done) {
+      archiveGzip.write((const uint8_t *)"]", 1);
+    }
+  }
+
+  if (done) {
+    archiveGzip.finish();
+    archiveData.close();
+    archiveOut.close();
+    LittleFS.rename(ARCHIVE_DIR_SLASH + archiveName + ARCHIVE_TMP_SUFFIX, ARCHIVE_DIR_SLASH + archiveName);
+    fsUsageStale = true;
+
+    SERIAL_PRINT("Archived: ");
+    SERIAL_PRINTLN(archiveName);
+    archiveName = "";
+  }
+
+  scheduler.start(jobArchive, 0);
+}
+
+// Place of key in months, or where it goes
+uint8_t monthsFind(uint32_t key) {
+  uint8_t i = 0;
+
+  while (i < monthsCount && months[i].key < key) {
+    i++;
+  }
+  return i;
+}
+
+// Index of the entry put, -1 when there is no room
+int monthsPut(const month_file &month) {
+  uint8_t i = monthsFind(month.key);
+
+  if (i < monthsCount && months[i].key == month.key) {
+    months[i] = month;
+    return i;
+  }
+  if (monthsCount == MONTHS_MAX) {
+    return -1;
+  }
+  memmove(months + i + 1, months + i, (monthsCount - i) * sizeof(month_file));
+  months[i] = month;
+  monthsCount++;
+  return i;
+}
+
+void monthRemove(uint8_t i) {
+  LittleFS.remove(MONTH_DIR_SLASH + monthFileName(months[i].key));
+  fsUsageStale = true;
+
+  SERIAL_PRINTLN("Month removed: " + monthFileName(months[i].key));
+  memmove(months + i, months + i + 1, (monthsCount - i - 1) * sizeof(month_file));
+  monthsCount--;
+}
+
+// List entry of a month file from its header, false if it is not a month file
+bool monthFileInfo(const String &name, month_file *month) {
+  File file = LittleFS.open(MONTH_DIR_SLASH + name, "r");
+  MonthReader reader;
+  bool valid;
+
+  month->key = monthFileKey(name);
+  valid = month->key != 0 && file && reader.open(&file) && file.size() >= MONTH_HEADER_SIZE + reader.header().size;
+  if (valid) {
+    month->sensors = reader.header().sensors;
+    month->size = reader.header().size;
+    month->first = reader.header().first;
+    month->last = reader.header().last;
+  }
+  if (file) {
+    file.close();
+  }
+  return valid;
+}
+
+// The only walk of month directory, at boot
+void monthsLoad() {
+  Dir dir = LittleFS.openDir(MONTH_DIR);
+  month_file month;
+
+  monthsCount = 0;
+  while (dir.next()) {
+    if (!monthFileInfo(dir.fileName(), &month) || monthsPut(month) < 0) {
+      SERIAL_PRINTLN("Not in month list: " + dir.fileName());
+    }
+  }
+
+  SERIAL_PRINT("Month files:");
+  SERIAL_PRINTLN(String(monthsCount));
+}
+
+// Entries written since the month file was opened become part of it, the data file they come from is noted
+void retentionMonthClose() {
+  uint8_t header[MONTH_HEADER_SIZE];
+
+  if (retentionMonthAt < 0) {
+    return;
+  }
+  if (!retentionMonthDone) {
+    month_file *month = &months[retentionMonthAt];
+
+    retentionHeader.source = retentionKey;
+    monthHeaderEncode(&retentionHeader, header);
+    retentionMonth.seek(0);
+    if (retentionMonth.write(header, sizeof(header)) == sizeof(header)) {
+      METRIC_ADD(METRIC_FLASH_BYTES, sizeof(header));
+      month->size = retentionHeader.size;
+      month->first = retentionHeader.first;
+      month->last = retentionHeader.last;
+    } else {
+      retentionFailed = true;  // the file keeps its old count, entries past it are cut off by the next append
+    }
+  }
+  retentionMonth.close();
+  retentionMonthAt = -1;
+  fsUsageStale = true;
+}
+
+// Opens the newest month file of `month` for append, a new one is started when there is none or it is of
+// other sensors count
+bool retentionMonthOpen(uint16_t month, uint8_t sensors) {
+  uint8_t at = monthsFind(((uint32_t)month + 1) * 100);  // past the files of month
+  month_file fresh = {(uint32_t)month * 100, sensors, 0, 0, 0};
+  uint8_t header[MONTH_HEADER_SIZE];
+  MonthReader reader;
+
+  if (at > 0 && months[at - 1].key / 100 == month) {
+    if (months[at - 1].sensors == sensors) {
+      retentionMonth = LittleFS.open(MONTH_DIR_SLASH + monthFileName(months[at - 1].key), "r+");
+      if (!retentionMonth || !reader.open(&retentionMonth)) {
+        retentionMonth.close();
+        return false;
+      }
+      retentionHeader = reader.header();
+      retentionMonthAt = at - 1;
+      retentionMonthDone = retentionHeader.source == retentionKey;
+      retentionMonth.truncate(MONTH_HEADER_SIZE + retentionHeader.size);
+      retentionMonth.seek(0, SeekEnd);
+      return true;
+    }
+    fresh.key = months[at - 1].key + 1;
+  }
+
+  if (monthsCount == MONTHS_MAX) {
+    monthRemove(0);
+  }
+
+  retentionMonth = LittleFS.open(MONTH_DIR_SLASH + monthFileName(fresh.key), "w");
+  retentionHeader = {sensors, 0, 0, 0, 0};
+  monthHeaderEncode(&retentionHeader, header);
+  if (!retentionMonth || retentionMonth.write(header, sizeof(header)) != sizeof(header)) {
+    retentionMonth.close();
+    LittleFS.remove(MONTH_DIR_SLASH + monthFileName(fresh.key));
+    return false;
+  }
+  METRIC_ADD(METRIC_FLASH_BYTES, sizeof(header));
+  retentionMonthAt = monthsPut(fresh);
+  retentionMonthDone = false;
+  return true;
+}
+
+// ctx is the failure flag of the compaction: a month file which can't be opened or an entry written short
+// loses history, so the data file must stay
+void retentionSink(const month_entry *entry, void *ctx) {
+  bool *failed = (bool *)ctx;
+  uint8_t buf[MONTH_ENTRY_MAX_SIZE];
+  uint8_t sensors = retentionReader.sensors();
+  size_t len;
+
+  if (*failed) {
+    return;
+  }
+  if (retentionMonthAt < 0 || months[retentionMonthAt].key / 100 != monthOf(entry->stamp)) {
+    retentionMonthClose();
+    if (*failed || !retentionMonthOpen(monthOf(entry->stamp), sensors)) {
+      *failed = true;
+      return;
+    }
+  }
+  if (retentionMonthDone) {
+    return;
+  }
+
+  len = monthEntryEncode(entry, sensors, buf);
+  if (retentionMonth.write(buf, len) != len) {
+    *failed = true;
+    return;
+  }
+  METRIC_ADD(METRIC_FLASH_BYTES, len);
+  retentionHeader.first = retentionHeader.size == 0 ? entry->stamp : retentionHeader.first;
+  retentionHeader.last = entry->stamp;
+  retentionHeader.size += len;
+}
+
+// Compaction is dropped, month file keeps entries of it past its count till the next append cuts them off
+void retentionAbort() {
+  if (retentionKey != 0) {
+    retentionMonthDone = true;
+    retentionMonthClose();
+    retentionData.close();
+    retentionKey = 0;
+  }
+}
+
+// Use of file system past the high mark, or not below the low one yet
+bool retentionDue() {
+  const FSInfo &fs = fsUsageInfo();
+  uint32_t used = fs.totalBytes ? (uint64_t)fs.usedBytes * 100 / fs.totalBytes : 0;
+
+  retentionActive = used >= retentionHighPct() || (retentionActive && used >= retentionLowPct());
+  return retentionActive;
+}
+
+bool dataFileRemove(const String &name);
+
+// Opens the oldest sealed binary data file for compaction. Files of text era are left in place, a file whose
+// header went bad since boot is removed as it is. The oldest month file goes when there is no data file
+// left to compact. False if there was nothing to do.
+bool retentionBegin() {
+  if (currentFileName.length() == 0) {  // the newest file is about to be continued
+    return false;
+  }
+
+  for (size_t i = 0; i < dataManifest.count(); i++) {
+    const data_file_info *info = dataManifest.at(i);
+    String name = dataFileName(info->key);
+
+    if (!info->sealed || !info->binary) {  // text era history stays, month files take binary logs only
+      continue;
+    }
+
+    retentionData = LittleFS.open(DATA_DIR_SLASH + name, "r");
+    if (!retentionData) {  // can't be read now, nothing is known of it
+      continue;
+    }
+    if (!retentionReader.open(&retentionData)) {
+      retentionData.close();
+      SERIAL_PRINTLN("Retention removes corrupt " + name);
+      dataFileRemove(name);
+      METRIC_ADD(METRIC_RETENTION_CORRUPT, 1);
+      return true;
+    }
+
+    if (archiveName == name) {
+      archiveAbort();
+    }
+    retentionKey = info->key;
+    retentionFailed = false;
+    retentionBucketer.begin(retentionReader.sensors(), retentionSink, &retentionFailed);
+
+    SERIAL_PRINTLN("Retention compacts " + name);
+    return true;
+  }
+
+  if (monthsCount > 0) {
+    monthRemove(0);
+    METRIC_ADD(METRIC_RETENTION_FILES, 1);
+    return true;
+  }
+  return false;
+}
+
+// Month files have all of the data file now, it goes. If some of it did not make it there, compaction is
+// dropped and the data file is kept; false then
+bool retentionEnd() {
+  String name = dataFileName(retentionKey);
+
+  retentionBucketer.finish();  // the sink skips entries once compaction failed
+  if (!retentionFailed) {
+    retentionMonthClose();
+  }
+  if (retentionFailed) {
+    SERIAL_PRINTLN("Retention failed, keeps " + name);
+    retentionAbort();
+    return false;
+  }
+  retentionData.close();
+  retentionKey = 0;
+
+  dataFileRemove(name);
+  METRIC_ADD(METRIC_RETENTION_FILES, 1);
+  return true;
+}
+
+// While file system use is past the high mark, and then till it is below the low one, data files are compacted
+// into month files oldest first, a slice of records per pass. Job is re-armed at once while there is work left.
+void retentionSlice() {
+  METRIC_SCOPE(METRIC_RETENTION_US);
+  event_record record;
+  int count = 0;
+
+  if (retentionKey == 0) {
+    if (!retentionDue() || !retentionBegin()) {
+      return;
+    }
+  }
+
+  while (retentionKey != 0 && !retentionFailed && count < RETENTION_SLICE_RECORDS && retentionReader.next(&record)) {
+    retentionBucketer.add(&record);
+    count++;
+  }
+  if (retentionKey != 0 && (retentionFailed || count < RETENTION_SLICE_RECORDS) && !retentionEnd()) {
+    scheduler.start(jobRetention, RETENTION_CHECK_MS, RETENTION_CHECK_MS);  // not again at once, flash is full
+    return;
+  }
+
+  scheduler.start(jobRetention, 0, RETENTION_CHECK_MS);
+}
+
+// Removes a data file together with its index and archive, what is going on with it is dropped. False if
+// there was no such file
+bool dataFileRemove(const String &name) {
+  String path = DATA_DIR_SLASH + name;
+  bool removed;
+
+  if (path == currentFileName) {
+    dataFileDiscard();
+  }
+  if (dataFileKey(name) != 0 && dataFileKey(name) == retentionKey) {
+    retentionAbort();
+  }
+  downloads.abort(path);
+  downloads.abort(ARCHIVE_DIR_SLASH + name);
+  removed = LittleFS.exists(path) && LittleFS.remove(path);
+  dataManifest.remove(dataFileKey(name));
+  fsUsageStale = true;
+
+  LittleFS.remove(INDEX_DIR_SLASH + name);
+  if (archiveName == name) {
+    archiveAbort();
+  }
+  LittleFS.remove(ARCHIVE_DIR_SLASH + name);
+  return removed;
+}
+
+// Index of the data file, rebuilt when it does not cover the file (older firmware, torn write). A rebuilt
+// index covers a torn tail too, so it is built once. Files which are not binary logs have no index.
+File openIndex(const String &name, size_t dataSize) {
+  String path = INDEX_DIR_SLASH + name;
+  File index = LittleFS.open(path, "r");
+  File data;
+  bool built;
+
+  if (index && logIndexCovers(&index, dataSize)) {
+    return index;
+  }
+  if (index) {
+    index.close();
+  }
+
+  SERIAL_PRINTLN("Rebuild index " + path);
+
+  data = LittleFS.open(DATA_DIR_SLASH + name, "r");
+  index = LittleFS.open(path, "w");
+  built = data && index && logIndexBuild(&data, &index);
+  if (data) {
+    data.close();
+  }
+  if (index) {
+    index.close();
+  }
+
+  if (!built) {
+    LittleFS.remove(path);
+    return File();
+  }
+  return LittleFS.open(path, "r");
+}
+
+typedef void (*record_visitor_t)(const event_record *record, uint8_t sensors, void *ctx);
+
+void scanFileRange(const String &name, size_t dataSize, uint32_t from, uint32_t to, record_visitor_t visit, void *ctx) {
+  File index = openIndex(name, dataSize);
+  log_index_entry entry;
+  size_t i;
+
+  if (!index) {
+    return;
+  }
+
+  i = logIndexFind(&index, from);
+  if (logIndexRead(&index, i, &entry) && entry.first <= to) {
+    File data = LittleFS.open(DATA_DIR_SLASH + name, "r");
+    LogReader reader;
+    event_record record;
+
+    if (data && reader.open(&data)) {
+      do {
+        reader.seek(entry.offset);
+        for (uint16_t k = 0; k < entry.count && reader.next(&record) && (uint32_t)record.stamp <= to; k++) {
+          visit(&record, reader.sensors(), ctx);
+        }
+      } while (logIndexRead(&index, ++i, &entry) && entry.first <= to);
+    }
+    if (data) {
+      data.close();
+    }
+  }
+  index.close();
+}
+
+// Entries of [from, to] of a month file as records, see monthEntryToRecord()
+void scanMonthRange(const month_file *month, uint32_t from, uint32_t to, record_visitor_t visit, void *ctx) {
+  File file = LittleFS.open(MONTH_DIR_SLASH + monthFileName(month->key), "r");
+  MonthReader reader;
+  month_entry entry;
+  event_record record;
+
+  if (file && reader.open(&file)) {
+    while (reader.next(&entry) && entry.stamp <= to) {
+      if (entry.stamp >= from) {
+        monthEntryToRecord(&entry, month->sensors, &record);
+        visit(&record, month->sensors, ctx);
+      }
+    }
+  }
+  if (file) {
+    file.close();
+  }
+}
+
+// Visits records up to `to` of every month file, data file and those not flushed yet, in time order. Records of
+// the first chunk reaching `from` are visited from the chunk start, so some of them may be older than `from`.
+// Files go in key order of months[] and the manifest, never in directory order, which has "_10" before "_2".
+void scanRange(uint32_t from, uint32_t to, record_visitor_t visit, void *ctx) {
+  dataFileCommit();
+
+  for (uint8_t i = 0; i < monthsCount; i++) {  // retention compacts oldest data files first, months come before them
+    if (months[i].size > 0 && months[i].last >= from && months[i].first <= to) {
+      scanMonthRange(&months[i], from, to, visit, ctx);
+    }
+  }
+
+  for (size_t i = 0; i < dataManifest.count(); i++) {
+    const data_file_info *info = dataManifest.at(i);
+
+    if (info->binary && (info->records == 0 || info->last < from || info->first > to)) {  // nothing of the range there
+      continue;
+    }
+    scanFileRange(dataFileName(info->key), info->size, from, to, visit, ctx);
+  }
+
+  if (start != 0) {
+    for (uint16_t i = 0; i < dataLog.size(); i++) {
+      event_record record = *dataLog.peek(i);
+
+      record.stamp = recordTime(&record);
+      if ((uint32_t)record.stamp >= from && (uint32_t)record.stamp <= to) {
+        visit(&record, sensorsCount, ctx);
+      }
+    }
+  }
+}
+
+// Manifest entry of a data file from its header and index, false if the name is not of a data file
+bool dataFileInfo(const String &name, size_t size, data_file_info *info) {
+  File data = LittleFS.open(DATA_DIR_SLASH + name, "r");
+  LogReader reader;
+  log_index_entry entry;
+
+  memset(info, 0, sizeof(*info));
+  info->key = dataFileKey(name);
+  info->size = size;
+  info->sealed = true;
+  info->binary = data && reader.open(&data);
+  info->seq = info->binary ? reader.seq() : 0;
+  if (data) {
+    data.close();
+  }
+
+  if (info->binary) {
+    File index = openIndex(name, size);
+
+    if (index) {
+      info->records = logIndexRecords(&index);
+      if (logIndexRead(&index, 0, &entry)) {
+        info->first = entry.first;
+      }
+      if (logIndexRead(&index, logIndexEntries(&index) - 1, &entry)) {
+        info->last = entry.last;
+      }
+      index.close();
+    }
+  }
+  return info->key != 0;
+}
+
+// The only directory walk, at boot
+void manifestLoad() {
+  const FSInfo &fs = fsUsageInfo();
+  Dir dir = LittleFS.openDir(DATA_DIR);
+  data_file_info info;
+
+  dataManifest.clear();
+  if (fs.blockSize && !dataManifest.reserve(fs.totalBytes / fs.blockSize)) {  // a data file takes a block at least
+    SERIAL_PRINTLN("No room for manifest");
+  }
+  while (dir.next()) {
+    if (!dataFileInfo(dir.fileName(), dir.fileSize(), &info) || !dataManifest.put(info)) {
+      SERIAL_PRINTLN("Not in manifest: " + dir.fileName());
+    }
+  }
+
+  SERIAL_PRINT("Data files:");
+  SERIAL_PRINTLN(String(dataManifest.count()));
+}
+
+// Entry of the current file is built again after its tail is cut
+void manifestScanCurrent() {
+  data_file_info info;
+
+  if (dataFileInfo(currentFileName.substring(strlen(DATA_DIR_SLASH)), currentFileSize, &info)) {
+    info.sealed = false;
+    dataManifest.put(info);
+  }
+}
+
+// Sequence number after the last record on flash
+void loadSeqNext() {
+  uint32_t seq = 0;
+
+  for (size_t i = 0; i < dataManifest.count(); i++) {
+    const data_file_info *info = dataManifest.at(i);
+
+    if (info->binary && info->seq + info->records > seq) {
+      seq = info->seq + info->records;
+    }
+  }
+  dataSeqNext = seq;
+
+  SERIAL_PRINT("Next record seq:");
+  SERIAL_PRINTLN(String(dataSeqNext));
+}
+
+// Visits records of a data file numbered `since` and later
+void scanFileSince(const String &name, uint32_t since, record_visitor_t visit, void *ctx) {
+  File data = LittleFS.open(DATA_DIR_SLASH + name, "r");
+  LogReader reader;
+  event_record record;
+  uint32_t skip = 0;
+  bool found = data && reader.open(&data);
+
+  if (found && since > reader.seq()) {  // chunk of the first record wanted is found by index
+    File index = openIndex(name, data.size());
+    log_index_entry entry;
+
+    found = index && logIndexRead(&index, logIndexFindRecord(&index, since - reader.seq(), &skip), &entry) &&
+            reader.seek(entry.offset);
+    if (index) {
+      index.close();
+    }
+  }
+
+  while (found && reader.next(&record)) {
+    if (skip > 0) {
+      skip--;
+    } else {
+      visit(&record, reader.sensors(), ctx);
+    }
+  }
+
+  if (data) {
+    data.close();
+  }
+}
+
+// Visits records numbered `since` and later in order: data files, then data log. Records of data log
+// are numbered as they will be in the file.
+void scanSince(uint32_t since, record_visitor_t visit, void *ctx) {
+  if (since < dataSeqNext) {
+    size_t first = dataManifest.count();
+
+    dataFileCommit();
+
+    while (first > 0) {  // the newest file starting at `since` or before, an up to date client reads one or two files
+      first--;
+      if (dataManifest.at(first)->binary && dataManifest.at(first)->seq <= since) {
+        break;
+      }
+    }
+
+    for (size_t i = first; i < dataManifest.count(); i++) {
+      const data_file_info *info = dataManifest.at(i);
+
+      if (info->binary && info->seq + info->records > since) {
+        scanFileSince(dataFileName(info->key), since, visit, ctx);
+      }
+    }
+  }
+
+  if (start == 0) {  // data log is numbered once real time is known and journal is replayed
+    return;
+  }
+
+  for (uint16_t i = 0; i < dataLog.size(); i++) {
+    if (dataSeqNext + i >= since) {
+      event_record record = *dataLog.peek(i);
+
+      record.stamp = recordTime(&record);
+      visit(&record, sensorsCount, ctx);
+    }
+  }
+}
+
+struct range_output {
+  JsonWriter *json;
+  packed_date_cache cache;
+  uint32_t from;
+};
+
+void jsonRangeRecord(const event_record *record, uint8_t sensors, void *ctx) {
+  range_output *out = (range_output *)ctx;
+
+  if ((uint32_t)record->stamp >= out->from) {
+    out->json->commit(logRecordToJson(record, sensors, &out->cache, out->json->value(LOG_JSON_RECORD_MAX)));
+  }
+}
+
+// Records of [from, to] as one array
+void serverSendRange(uint32_t from, uint32_t to) {
+  JsonWriter json(responseBuf, sizeof(responseBuf), serverSendChunk);
+  range_output out = {&json, {}, from};
+
+  nowTime = time(nullptr);
+  packedDateReset(&out.cache);
+  serverBeginStream();
+
+  json.beginArray();
+  scanRange(from, to, jsonRangeRecord, &out);
+  json.endArray();
+
+  json.end();
+}
+
+// Records numbered `since` and later: {"seq":<number to ask next time>,"d":[...]}, records in the format
+// of /data?f=. Cursor past the last record (numbers started over, data was formatted) is answered
+// with {"seq":..,"reset":1,"d":[]}, client reloads the history and goes on from "seq".
+void serverSendSince(uint32_t since) {
+  JsonWriter json(responseBuf, sizeof(responseBuf), serverSendChunk);
+  range_output out = {&json, {}, 0};
+  uint32_t end = dataSeqNext + (start != 0 ? dataLog.size() : 0);
+
+  nowTime = time(nullptr);
+  packedDateReset(&out.cache);
+  serverBeginStream();
+
+  json.beginObject().key("seq").num((long)end);
+  if (since > end) {
+    json.key("reset").num(1L).key("d").beginArray();
+  } else {
+    json.key("d").beginArray();
+    scanSince(since, jsonRangeRecord, &out);
+  }
+  json.endArray().endObject();
+
+  json.end();
+}
+
+// Entries of a month file: [[YYMMDDhhmm,"a",count,on minutes,[avg..],[min..],[max..]],..] with relay switches
+// in the format of /data?f=
+void serverSendMonth(const String &name) {
+  JsonWriter json(responseBuf, sizeof(responseBuf), serverSendChunk);
+  File file = monthFileKey(name) ? LittleFS.open(MONTH_DIR_SLASH + name, "r") : File();
+  MonthReader reader;
+  packed_date_cache cache;
+  month_entry entry;
+
+  if (!file || !reader.open(&file)) {
+    if (file) {
+      file.close();
+    }
+    serverSendHeaders();
+    server.send(404, strContentType, "File Not Found: " + String(MONTH_DIR_SLASH) + name);
+    return;
+  }
+
+  packedDateReset(&cache);
+  serverBeginStream();
+  json.beginArray();
+  while (reader.next(&entry)) {
+    json.commit(monthEntryToJson(&entry, reader.header().sensors, &cache, json.value(MONTH_JSON_ENTRY_MAX)));
+  }
+  json.endArray();
+  json.end();
+  file.close();
+}
+
+void jsonBucket(const log_bucket *bucket, void *ctx) {
+  range_output *out = (range_output *)ctx;
+  JsonWriter *json = out->json;
+
+  json->beginArray();
+  json->commit(packedDateFormat(bucket->start, &out->cache, json->value(12)));
+  json->num((long)bucket->count);
+  json->num(bucket->span ? (float)bucket->on / bucket->span : 0, 2);
+  for (uint8_t k = 0; k < bucket->sensors; k++) {
+    json->num((long)bucket->min[k]);
+    json->num(bucket->count ? (float)bucket->sum[k] / bucket->count : 0, 0);
+    json->num((long)bucket->max[k]);
+  }
+  json->endArray();
+}
+
+void aggregateRecord(const event_record *record, uint8_t sensors, void *ctx) {
+  ((LogAggregator *)ctx)->add(record, sensors);
+}
+
+void lttbAverage(const event_record *record, uint8_t sensors, void *ctx) {
+  ((LogLttb *)ctx)->average(record, sensors);
+}
+
+void lttbSelect(const event_record *record, uint8_t sensors, void *ctx) {
+  ((LogLttb *)ctx)->select(record, sensors);
+}
+
+// `points` buckets of [from, to]: {"from":..,"step":..,"b":[[YYMMDDhhmm,count,on share,min0,avg0,max0,...],...]}
+// or with lttb one record of each bucket, in the format of /data?f=
+void serverSendAggregate(uint32_t from, uint32_t to, uint16_t points, bool lttb) {
+  JsonWriter json(responseBuf, sizeof(responseBuf), serverSendChunk);
+  range_output out = {&json, {}, from};
+
+  nowTime = time(nullptr);
+  packedDateReset(&out.cache);
+
+  if (lttb) {
+    LogLttb selector;
+    lttb_point *averages = (lttb_point *)malloc(sizeof(lttb_point) * points);
+
+    if (!averages) {
+      serverSendHeaders();
+      server.send(503, strContentType, "{\"err\":\"no memory\"}");
+      return;
+    }
+
+    selector.begin(from, to, points, averages);
+    scanRange(from, to, lttbAverage, &selector);
+
+    serverBeginStream();
+    json.beginArray();
+    selector.beginSelect(jsonRangeRecord, &out);
+    scanRange(from, to, lttbSelect, &selector);
+    selector.finish();
+    json.endArray();
+
+    free(averages);
+  } else {
+    LogAggregator aggregator;
+
+    aggregator.begin(from, to, points, jsonBucket, &out);
+
+    serverBeginStream();
+    json.beginObject().key("from").num((long)from).key("step").num((long)aggregator.step()).key("b").beginArray();
+    scanRange(from, to, aggregateRecord, &aggregator);
+    aggregator.finish();
+    json.endArray().endObject();
+  }
+
+  json.end();
+}
+
+// Fields found in JSON are set, the rest keep their values. Nothing is changed if JSON is malformed
+bool configFromJson(const char *json) {
+  config parsed = conf;
+
+  if (!fieldsFromJson(configFields, CONFIG_FIELDS, &parsed, json)) {
+    SERIAL_PRINTLN("Conf parse failed");
+    return false;
+  }
+  conf = parsed;
+  return true;
+}
+
+void configToFile() {
+  uint8_t buf[CONFIG_FILE_MAX];
+  size_t len = fieldsEncode(configFields, CONFIG_FIELDS, &conf, buf, sizeof(buf));
+  File file = len ? LittleFS.open(CONFIG_FILE, "w") : File();
+
+  if (file) {
+    file.write(buf, len);
+    file.close();
+  }
+}
+
+void sendInfo() {
+  JsonWriter json(responseBuf, sizeof(responseBuf), serverSendChunk);
+  packed_date_cache cache;
 
-    SERIAL_PRINT("Conf<--");
-    SERIAL_PRINT(server.arg("set"));
+  nowTime = time(nullptr);
+  packedDateReset(&cache);
+
+  if (server.arg("cur").length() > 0) {
+    unsigned long upTime = start ? nowTime - start : millis() / 1000;
+
+    if (server.arg("f").length() > 0)  // fresh readings are taken in background, reply has the previous ones and "scan":1
+      scanSensors();
+
+    serverBeginStream();
+    json.beginObject().key("up").num((long)upTime).key("rel").num((long)relayOn).key("cur");
+    jsonRecord(&json, &curSensors, &cache);
+    json.key("avg").num(curAverage / 100.0f, 2).key("scan").num((long)sensorsConverting).endObject();
+
+  } else if (server.arg("last").length() > 0) {
+    serverBeginStream();
+    json.beginObject().key("last").beginArray();
+
+    if (start != 0) {  // мы пишем лог только если знаем настоящее время.
+      for (uint16_t i = 0; i < dataLog.size(); i++) {
+        jsonRecord(&json, dataLog.peek(i), &cache);
+      }
+    }
+
+    json.endArray().endObject();
+  } else if (server.arg("jobs").length() > 0) {  // lateness in ms and run time in us of every scheduled job
+    serverBeginStream();
+    json.beginObject().key("jobs").beginArray();
+
+    for (uint8_t i = 0; i < scheduler.count(); i++) {
+      const scheduler_job *job = scheduler.job(i);
+      uint32_t runs = job->runs ? job->runs : 1;
+
+      json.beginObject().key("n").str(job->name).key("runs").num((long)job->runs)
+          .key("lateMax").num((long)job->lateMaxMs).key("lateAvg").num((long)(job->lateSumMs / runs))
+          .key("runMax").num((long)job->runMaxUs).key("runAvg").num((long)(job->runSumUs / runs))
+          .endObject();
+    }
+
+    json.endArray().endObject();
+  } else {
+    const FSInfo &fs = fsUsageInfo();
+
+    serverBeginStream();
+    json.beginObject().key("fs").beginObject()
+        .key("tot").num((long)fs.totalBytes)
+        .key("used").num((long)fs.usedBytes)
+        .key("block").num((long)fs.blockSize)
+        .key("page").num((long)fs.pageSize)
+        .endObject();
+
+    json.key("rel").num((long)relayOn).key("cur").beginArray();
+    for (int i = 0; i < sensorsCount; i++) {
+      json.num((long)curSensors.t[i]);
+    }
+    json.endArray();
+
+    json.key("conf").beginObject();
+    fieldsToJson(configFields, CONFIG_FIELDS, &conf, &json);
+    json.endObject();
+
+    json.key("sn").raw("\"");
+    for (int i = 0; i < sensorsCount; i++) {  // "a0 a1 .. a7 weight,..." - every sensor goes as one comma separated value
+      char *line = json.value(9 * 4);
+      size_t len = 0;
+
+      for (int k = 0; k < 8; k++) {
+        len += sprintf(line + len, "%u ", sensor[i].addr[k]);
+      }
+      len += sprintf(line + len, "%u", sensor[i].weight);
+      json.commit(len);
+    }
+    json.raw("\"");
+
+    json.key("dt").beginArray();
+
+    for (size_t i = 0; i < dataManifest.count(); i++) {
+      const data_file_info *info = dataManifest.at(i);
+
+      json.beginObject().key("n").str(dataFileName(info->key).c_str()).key("s").num((long)info->size).endObject();
+    }
+    json.endArray();
+
+    json.key("m").beginArray();
+    for (uint8_t i = 0; i < monthsCount; i++) {
+      json.beginObject().key("n").str(monthFileName(months[i].key).c_str())
+          .key("s").num((long)(MONTH_HEADER_SIZE + months[i].size))
+          .endObject();
+    }
+    json.endArray().endObject();
+  }
+
+  json.end();
+}
+
+void handleInfo() {
+  METRIC_SCOPE(METRIC_HTTP_US);
+
+  sendInfo();
+}
+
+// Without "set" it only replies as /info does
+void handleConfig() {
+  METRIC_SCOPE(METRIC_HTTP_US);
+    const String &set = server.arg("set");
+
+    if (set.length() > 0) {
+      if (!configFromJson(set.c_str())) {
+        serverSendHeaders();
+        server.send(400, strContentType, "{\"err\":\"bad conf\"}");
+        return;
+      }
+      sensorsApplyResolution();
+      configToFile();
+      if (conf.gz && !scheduler.started(jobArchive)) {  // sealed files wait for their archives
+        scheduler.start(jobArchive, 0);
+      }
+
+      SERIAL_PRINT("Conf<--");
+      SERIAL_PRINT(set);
+    }
 
     alignTimersToHour(true);
 
     setLedProfile( relayOn ? LED_R_ON : LED_R_OFF);
     putSensorsIntoDataLog();  // TODO - added this line to log as soon as possible after board restart. If not, first log record can be found after 'conf.log' from restart (and this period is about few hours, which is not nice is final graph)
 
-  handleInfo();
+  sendInfo();
 }
 
 void handleSensors() {
+  METRIC_SCOPE(METRIC_HTTP_US);
     String line = server.arg("sn");
-    byte sensBuff[9 * MAX_SENSORS_COUNT];
+    byte sensBuff[SENSOR_RECORD_SIZE * MAX_SENSORS_COUNT];
+    int count = sensorsParseString(&line, sensBuff);
 
-    sensorsParseString(&line, sensBuff);
-    sensorsBufferToFile(sensBuff);
-    sensorsApplyBufferOn(sensBuff);
+    for (int i = 0; i < count; i++) {
+      sensorRegistry.setWeight(sensBuff + i * SENSOR_RECORD_SIZE, sensBuff[i * SENSOR_RECORD_SIZE + SENSOR_ROM_SIZE]);
+    }
+    sensorsToFile();
+    sensorsApplyWeights();
 
     SERIAL_PRINT("SensConf<--");
     SERIAL_PRINTLN(line);
 
-  handleInfo();
+  sendInfo();
 }
 
 void handleGetData() {
-  if (server.arg("f").length() > 0) {
+  METRIC_SCOPE(METRIC_HTTP_US);
+  JsonWriter json(responseBuf, sizeof(responseBuf), serverSendChunk);
+
+  if (server.arg("f").indexOf(',') >= 0 || server.arg("f").endsWith("*")) {
+    serverSendBatch(server.arg("f"));
+  } else if (server.arg("f").length() > 0) {
     serverSendfile(server.arg("f"));
+  } else if (server.arg("since").length() > 0) {
+    serverSendSince(server.arg("since").toInt());
+  } else if (server.arg("from").length() > 0) {
+    serverSendRange(server.arg("from").toInt(), server.arg("to").length() > 0 ? server.arg("to").toInt() : time(nullptr));
+  } else if (server.arg("m").length() > 0) {
+    serverSendMonth(server.arg("m"));
   } else if (server.arg("d").length() > 0) {
-    String path = DATA_DIR_SLASH + server.arg("d");
+    bool removed = dataFileRemove(server.arg("d"));
 
-    if (LittleFS.exists(path)) {
-      LittleFS.remove(path);  // Remove it
-      serverSend("{\"d\":1}");
-    } else {
-      serverSend("{\"d\":0}");
+    serverBeginStream();
+    json.beginObject().key("d").num((long)removed).endObject().end();
+  }
+}
+
+void handleAggData() {
+  METRIC_SCOPE(METRIC_HTTP_US);
+  uint32_t to = server.arg("to").length() > 0 ? server.arg("to").toInt() : time(nullptr);
+  uint32_t from = server.arg("from").toInt();
+  long points = server.arg("points").length() > 0 ? server.arg("points").toInt() : AGG_DEFAULT_POINTS;
+
+  points = points < 1 ? 1 : (points > AGG_MAX_POINTS ? AGG_MAX_POINTS : points);
+
+  if (from == 0 || from > to) {
+    serverSendHeaders();
+    server.send(400, strContentType, "{\"err\":\"bad range\"}");
+    return;
+  }
+
+  serverSendAggregate(from, to, points, server.arg("mode") == "lttb");
+}
+
+// Server-Sent Events: "t" on every reading, "rel" on relay switch. Client is kept by events, not by server
+void handleEvents() {
+  METRIC_SCOPE(METRIC_HTTP_US);
+
+  if (!events.subscribe(server.client())) {
+    serverSendHeaders();
+    server.send(503, strContentType, "{\"err\":\"no free slot\"}");
+  }
+}
+
+// Tenths of degree, null when there is no value
+void jsonTenths(JsonWriter *json, bool has, int value) {
+  if (has) {
+    json->num((long)value);
+  } else {
+    json->null();
+  }
+}
+
+// Statistics of the last hour, day and week, see RollingStats.h. Temperatures in tenths:
+// {"up":sec,"rel":0|1,"avg":<weighted average>,"ewma":[..],"trend":[per hour..],
+//  "w":[{"s":<window sec>,"span":<sec covered>,"on":<relay on sec>,"cyc":<switched on>,"min":[..],"max":[..]},..]}
+void handleStats() {
+  METRIC_SCOPE(METRIC_HTTP_US);
+  JsonWriter json(responseBuf, sizeof(responseBuf), serverSendChunk);
+  int value = 0;
+
+  stats.update(statsNow());
+
+  serverBeginStream();
+  json.beginObject().key("up").num((long)statsNow()).key("rel").num((long)relayOn)
+      .key("avg").num(curAverage / 100.0f, 2);
+
+  json.key("ewma").beginArray();
+  for (int i = 0; i < sensorsCount; i++) {
+    jsonTenths(&json, stats.seen(i), stats.ewma(i));
+  }
+  json.endArray().key("trend").beginArray();
+  for (int i = 0; i < sensorsCount; i++) {
+    jsonTenths(&json, stats.seen(i), stats.trend(i));
+  }
+  json.endArray();
+
+  json.key("w").beginArray();
+  for (uint8_t w = 0; w < STATS_WINDOWS; w++) {
+    json.beginObject().key("s").num((long)RollingStats::windowSec(w)).key("span").num((long)stats.span(w))
+        .key("on").num((long)stats.onSec(w)).key("cyc").num((long)stats.cycles(w));
+
+    json.key("min").beginArray();
+    for (int i = 0; i < sensorsCount; i++) {
+      bool has = stats.min(w, i, &value);
+
+      jsonTenths(&json, has, value);
     }
+    json.endArray().key("max").beginArray();
+    for (int i = 0; i < sensorsCount; i++) {
+      bool has = stats.max(w, i, &value);
+
+      jsonTenths(&json, has, value);
+    }
+    json.endArray().endObject();
   }
+  json.endArray().endObject().end();
 }
 
-void handleFormat(){
-  int success = LittleFS.format();
-  serverSend("{\"formatted\":"+String(success)+"}");
+#if METRICS
+// Prometheus text format, scheduler jobs go with the job label
+void handleMetrics() {
+  JsonWriter out(responseBuf, sizeof(responseBuf), serverSendChunk);
+  char label[32];
+
+  serverBeginStream("text/plain; version=0.0.4");
+  metricsWrite(&out);
+
+  metricsWriteHead(&out, "thermo_job_runs_total", "counter", "Scheduled job runs");
+  for (uint8_t i = 0; i < scheduler.count(); i++) {
+    snprintf(label, sizeof(label), "job=\"%s\"", scheduler.job(i)->name);
+    metricsWriteLine(&out, "thermo_job_runs_total", label, scheduler.job(i)->runs);
+  }
+  metricsWriteHead(&out, "thermo_job_late_max_ms", "gauge", "Longest delay of a job start past its deadline");
+  for (uint8_t i = 0; i < scheduler.count(); i++) {
+    snprintf(label, sizeof(label), "job=\"%s\"", scheduler.job(i)->name);
+    metricsWriteLine(&out, "thermo_job_late_max_ms", label, scheduler.job(i)->lateMaxMs);
+  }
+  metricsWriteHead(&out, "thermo_job_run_max_us", "gauge", "Longest job run");
+  for (uint8_t i = 0; i < scheduler.count(); i++) {
+    snprintf(label, sizeof(label), "job=\"%s\"", scheduler.job(i)->name);
+    metricsWriteLine(&out, "thermo_job_run_max_us", label, scheduler.job(i)->runMaxUs);
+  }
+
+  out.end();
+}
+#endif
+
+void handleFormat() {
+  METRIC_SCOPE(METRIC_HTTP_US);
+  JsonWriter json(responseBuf, sizeof(responseBuf), serverSendChunk);
+  int success;
+
+  archiveAbort();
+  retentionAbort();
+  dataFileDiscard();
+  downloads.abort();
+  success = LittleFS.format();
+  dataManifest.clear();
+  monthsCount = 0;
+  fsUsageStale = true;
+
+  serverBeginStream();
+  json.beginObject().key("formatted").num((long)success).endObject().end();
 }
 
+// Config saved by older firmware as JSON is moved over to CONFIG_FILE
 void configFromFile() {
-  File file;
-  if (LittleFS.exists(CONFIG_FILE)) {
-    int fileSize = 0;
-    String json;
-    File file = LittleFS.open(CONFIG_FILE, "r");  // Open it
+  File file = LittleFS.open(CONFIG_FILE, "r");
 
-    fileSize = file.size();
+  if (file) {
+    uint8_t buf[CONFIG_FILE_MAX];
+    size_t len = file.read(buf, sizeof(buf));
 
-    SERIAL_PRINT("Conf file size ");
-    SERIAL_PRINTLN(fileSize);
+    file.close();
+    if (!fieldsDecode(configFields, CONFIG_FIELDS, &conf, buf, len)) {
+      SERIAL_PRINTLN("Conf file is broken");
+    }
+    return;
+  }
+
+  file = LittleFS.open(CONFIG_FILE_JSON, "r");
+  if (file) {
+    char json[CONFIG_JSON_MAX + 1];
+    size_t len = file.read((uint8_t *)json, CONFIG_JSON_MAX);
+
+    json[len] = 0;
+    file.close();
 
-    if (fileSize > 20 && fileSize < 150) {
-      json = file.readString();
-      parseConfJson(&json);
-      SERIAL_PRINT("Conf <-- ");
-      SERIAL_PRINTLN(json);
+    SERIAL_PRINT("Conf <-- ");
+    SERIAL_PRINTLN(json);
+    if (configFromJson(json)) {
+      configToFile();
+      LittleFS.remove(CONFIG_FILE_JSON);
     }
-    file.close();  // Then close the file again
   }
 }
 
@@ -780,7 +2488,7 @@ P.S. I, also, found that in the BasicOTA example, it uses while (WiFi.waitForCon
   //  SERIAL_PRINTLN(WiFi.status());
 
 
-    timers_aligner.once(WIFI_CHECK_PERIOD, isWiFiConnected);
+    scheduler.start(jobWifi, WIFI_CHECK_PERIOD * 1000UL);
   } else {
     settimeofday_cb(timeSyncCb);
     configTime(TZ_SEC, DST_SEC, "pool.ntp.org");
@@ -788,9 +2496,16 @@ P.S. I, also, found that in the BasicOTA example, it uses while (WiFi.waitForCon
     server.on("/conf", handleConfig);
     server.on("/sens", handleSensors);
     server.on("/data", handleGetData);
+    server.on("/data/agg", handleAggData);
     server.on("/info", handleInfo);
     server.on("/formatFS", handleFormat);
+    server.on("/events", handleEvents);
+    server.on("/stats", handleStats);
+#if METRICS
+    server.on("/metrics", handleMetrics);
+#endif
 
+    server.collectHeaders(requestHeaders, sizeof(requestHeaders) / sizeof(requestHeaders[0]));
     server.begin();
 
     SERIAL_PRINT("IP is ");
@@ -834,8 +2549,23 @@ void WiFiSetup() {
   // so webserver can not be used again in the sketch.
 }
 
+void setupJobs() {
+  jobScan = scheduler.add("scan", scanSensors);
+  jobRead = scheduler.add("read", readSensors);
+  jobLog = scheduler.add("log", putSensorsIntoDataLog);
+  jobFlush = scheduler.add("flush", flushLogIntoFile);
+  jobLed = scheduler.add("led", pwmLedManager2);
+  jobAlign = scheduler.add("align", setTimers);
+  jobWifi = scheduler.add("wifi", isWiFiConnected);
+  jobArchive = scheduler.add("archive", archiveSlice);
+  jobEvents = scheduler.add("events", eventsKeepAlive);
+  jobRetention = scheduler.add("retention", retentionSlice);
+}
+
 void setup() {
-  byte sensBuff[9 * MAX_SENSORS_COUNT];
+  FSInfo fs;
+
+  setupJobs();
 
   pinMode(PIN_LED, OUTPUT);
   pinMode(LED_PIN, OUTPUT);
@@ -850,36 +2580,63 @@ void setup() {
 
   DS18B20.begin();
   LittleFS.begin();
+  LittleFS.info(fs);
+  dataFile.setGeometry(fs.pageSize, fs.blockSize);
+  manifestLoad();
+  monthsLoad();
+  loadSeqNext();
+
+  if (LittleFS.exists(JOURNAL_FILE)) {  // boot-relative stamps of previous boot can't be restored anymore
+    SERIAL_PRINTLN("Stale journal removed");
+    LittleFS.remove(JOURNAL_FILE);
+  }
 
   WiFiSetup();
 
-  sensorsCount = DS18B20.getDeviceCount();
-  sensorsCount = MAX_SENSORS_COUNT > sensorsCount ? sensorsCount : MAX_SENSORS_COUNT;
-
   configFromFile();
 
-  sensorsPrepareAddresses();
-  sensorsBufferFromFile(sensBuff);
-  sensorsApplyBufferOn(sensBuff);
+  DS18B20.setWaitForConversion(false);
+  sensorsFromFile();
+  sensorsRescan();
 
   setLedProfile(LED_R_OFF);
 
   setTimers();
 
+  scheduler.start(jobArchive, ARCHIVE_BOOT_DELAY_MS);
+  scheduler.start(jobEvents, EVENTS_KEEPALIVE_MS, EVENTS_KEEPALIVE_MS);
+  scheduler.start(jobRetention, RETENTION_CHECK_MS, RETENTION_CHECK_MS);
+
   scanSensors();
+  delay(sensorsConversionMs);  // first record goes with real readings
+  scheduler.run();
   putSensorsIntoDataLog();
 }
 
-void loop() {
-  int i;
+void loopPass() {
+  METRIC_SCOPE(METRIC_LOOP_US);
+
   server.handleClient();
+  events.pump();
+  downloads.pump();
+  METRIC_HEAP_SAMPLE();
 
   if (ledStatus != ledStatusPrev) {
     analogWrite(LED_PIN, ledStatus ? 600 : 0);
     ledStatusPrev = ledStatus;
   }
 
-  for (i = 0; i < TICKERS; i++)
-    if (tickers[i].armed())
-      tickers[i].run();
+  scheduler.run();
+
+  if (dataLog.size() >= DATA_BUFFER_SPILL) {
+    if (start)
+      flushLogIntoFile();
+    else
+      spillLogIntoJournal();
+  }
+}
+
+void loop() {
+  loopPass();
+  delay(scheduler.idleMs(LOOP_SLEEP_MAX_MS));
 }
@@ -0,0 +1,430 @@
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+#include "ColumnArchive.h"
+
+#define ALIGN8(n) (((n) + 7) & ~(uint64_t)7)
+#define COLUMN_SCAN_STRIP 64
+
+uint32_t columnPackedToStamp(unsigned long packed, long tzOffset) {
+  struct tm tm = {};
+  time_t stamp;
+
+  tm.tm_year = 100 + (int)(packed / 100000000);
+  tm.tm_mon = (int)(packed / 1000000 % 100) - 1;
+  tm.tm_mday = (int)(packed / 10000 % 100);
+  tm.tm_hour = (int)(packed / 100 % 100);
+  tm.tm_min = (int)(packed % 100);
+  if (tm.tm_mon < 0 || tm.tm_mon > 11 || tm.tm_mday < 1 || tm.tm_mday > 31 || tm.tm_hour > 23 || tm.tm_min > 59) {
+    return 0;
+  }
+
+  stamp = timegm(&tm) - tzOffset;
+  return stamp > 0 && stamp <= (time_t)UINT32_MAX ? (uint32_t)stamp : 0;
+}
+
+size_t columnParseDump(const char *text, size_t len, long tzOffset, std::vector<dump_row> *rows) {
+  size_t found = 0;
+
+  for (size_t i = 0; i + 1 < len; i++) {
+    if (text[i] != '[' || !isdigit((unsigned char)text[i + 1])) {
+      continue;
+    }
+
+    const char *p = text + i + 1, *end = text + len;
+    char *next;
+    unsigned long stamp = strtoul(p, &next, 10);
+    dump_row row;
+
+    row.stamp = stamp >= COLUMN_PACKED_MIN ? columnPackedToStamp(stamp, tzOffset) : (uint32_t)stamp;
+    row.event = 't';
+    row.count = 0;
+    p = next;
+
+    while (p < end && *p == ',') {
+      p++;
+      while (p < end && *p == ' ')
+        p++;
+      if (p < end && *p == '"') {
+        row.event = !strncmp(p, "\"on\"", 4) ? 'n' : !strncmp(p, "\"off\"", 5) ? 'f' : 'b';
+        p = (const char *)memchr(p + 1, '"', end - p - 1);
+        if (!p)
+          break;
+        p++;
+      } else {
+        long t = strtol(p, &next, 10);
+
+        if (next == p)
+          break;
+        if (row.count < COLUMN_SENSORS_MAX)
+          row.t[row.count++] = (int16_t)(t < INT16_MIN + 1 ? INT16_MIN + 1 : t > INT16_MAX ? INT16_MAX : t);
+        p = next;
+      }
+    }
+
+    if (p < end && *p == ']' && row.stamp && (row.count || row.event != 't')) {
+      rows->push_back(row);
+      found++;
+    }
+  }
+
+  return found;
+}
+
+size_t columnParseFile(const char *path, long tzOffset, std::vector<dump_row> *rows) {
+  FILE *f = fopen(path, "rb");
+  std::string text;
+  char buf[65536];
+  size_t len;
+
+  if (!f) {
+    return 0;
+  }
+  while ((len = fread(buf, 1, sizeof(buf), f)) > 0) {
+    text.append(buf, len);
+  }
+  fclose(f);
+
+  return columnParseDump(text.data(), text.size(), tzOffset, rows);
+}
+
+static bool readingLess(const dump_row &a, const dump_row &b) {
+  if (a.stamp != b.stamp) {
+    return a.stamp < b.stamp;
+  }
+  if (a.count != b.count) {
+    return a.count < b.count;
+  }
+  return memcmp(a.t, b.t, a.count * sizeof(a.t[0])) < 0;
+}
+
+static bool sameReading(const dump_row &a, const dump_row &b) {
+  return a.stamp == b.stamp && a.count == b.count && !memcmp(a.t, b.t, a.count * sizeof(a.t[0]));
+}
+
+static bool writeAt(FILE *f, uint64_t at, const void *data, size_t len) {
+  return !fseeko(f, (off_t)at, SEEK_SET) && fwrite(data, 1, len, f) == len;
+}
+
+// Rows with readings go to the columns, their events and the bare ones to the events. Readings are sorted by
+// stamp then values, so the same reading of overlapping dumps lands next to itself. Events keep the order they
+// had in dumps within a stamp; one of a kind is kept per stamp and relay events are dropped when they do not
+// change its state (boot leaves it off)
+bool columnArchiveWrite(const char *path, std::vector<dump_row> *rows, column_write_stats *stats) {
+  std::vector<std::pair<uint32_t, char>> raw;
+  std::vector<column_event> events;
+  column_header header = {};
+  std::string tmp = std::string(path) + ".tmp";
+  size_t kept = 0;
+  uint32_t onSum = 0;
+  uint16_t sensors = 0;
+  bool relayOn = false, ok;
+  FILE *f;
+
+  memset(stats, 0, sizeof(*stats));
+
+  for (const dump_row &row : *rows) {
+    if (row.event != 't') {
+      raw.push_back(std::make_pair(row.stamp, row.event));
+    }
+  }
+  std::stable_sort(raw.begin(), raw.end(),
+                   [](const std::pair<uint32_t, char> &a, const std::pair<uint32_t, char> &b) { return a.first < b.first; });
+  for (size_t i = 0, group = 0; i < raw.size(); i++) {
+    const std::pair<uint32_t, char> &e = raw[i];
+    bool on = e.second == 'n';
+    bool seen = false;
+
+    group = raw[group].first == e.first ? group : i;
+    for (size_t j = group; j < i && !seen; j++) {
+      seen = raw[j].second == e.second;
+    }
+    if (seen || (e.second != 'b' && on == relayOn)) {
+      stats->repeated++;
+      continue;
+    }
+    if (relayOn) {
+      onSum += e.first - events.back().stamp;
+    }
+    relayOn = on;
+    events.push_back({e.first, onSum, e.second, {}});
+  }
+
+  std::sort(rows->begin(), rows->end(), readingLess);
+  for (size_t i = 0; i < rows->size(); i++) {
+    const dump_row &row = (*rows)[i];
+
+    if (!row.count) {
+      continue;
+    }
+    if (kept && sameReading((*rows)[kept - 1], row)) {
+      stats->duplicates++;
+      continue;
+    }
+    sensors = row.count > sensors ? row.count : sensors;
+    (*rows)[kept++] = row;
+  }
+  rows->resize(kept);
+
+  memcpy(header.magic, COLUMN_MAGIC, sizeof(header.magic));
+  header.version = COLUMN_FORMAT_VERSION;
+  header.sensors = sensors;
+  header.blockRows = COLUMN_BLOCK_ROWS;
+  header.blocks = (uint32_t)((kept + COLUMN_BLOCK_ROWS - 1) / COLUMN_BLOCK_ROWS);
+  header.rows = kept;
+  header.events = events.size();
+  header.stampsAt = ALIGN8(sizeof(header));
+  header.columnsAt = ALIGN8(header.stampsAt + kept * sizeof(uint32_t));
+  header.columnStride = ALIGN8(kept * sizeof(int16_t));
+  header.eventsAt = header.columnsAt + sensors * header.columnStride;
+  header.blocksAt = ALIGN8(header.eventsAt + events.size() * sizeof(column_event));
+  header.summaryAt = header.blocksAt + header.blocks * sizeof(column_block);
+
+  if (!(f = fopen(tmp.c_str(), "wb"))) {
+    return false;
+  }
+
+  {
+    std::vector<uint32_t> stamps(kept);
+    std::vector<int16_t> column(kept);
+    std::vector<column_block> blocks(header.blocks);
+    std::vector<column_summary> summary((size_t)header.blocks * sensors);
+
+    for (size_t i = 0; i < kept; i++) {
+      stamps[i] = (*rows)[i].stamp;
+    }
+    for (uint32_t b = 0; b < header.blocks; b++) {
+      blocks[b].first = stamps[(size_t)b * COLUMN_BLOCK_ROWS];
+      blocks[b].last = stamps[std::min((size_t)(b + 1) * COLUMN_BLOCK_ROWS, kept) - 1];
+    }
+    ok = writeAt(f, 0, &header, sizeof(header)) && writeAt(f, header.stampsAt, stamps.data(), kept * sizeof(uint32_t));
+
+    for (uint16_t k = 0; ok && k < sensors; k++) {
+      for (size_t i = 0; i < kept; i++) {
+        const dump_row &row = (*rows)[i];
+        int16_t v = k < row.count ? row.t[k] : COLUMN_MISSING;
+        column_summary *s = &summary[(size_t)(i / COLUMN_BLOCK_ROWS) * sensors + k];
+
+        column[i] = v;
+        if (i % COLUMN_BLOCK_ROWS == 0) {
+          *s = {INT16_MAX, INT16_MIN, 0, 0};
+        }
+        if (v != COLUMN_MISSING && v != COLUMN_DISCONNECTED) {
+          s->min = v < s->min ? v : s->min;
+          s->max = v > s->max ? v : s->max;
+          s->count++;
+          s->sum += v;
+        }
+      }
+      ok = writeAt(f, header.columnsAt + k * header.columnStride, column.data(), kept * sizeof(int16_t));
+    }
+
+    ok = ok && writeAt(f, header.eventsAt, events.data(), events.size() * sizeof(column_event)) &&
+         writeAt(f, header.blocksAt, blocks.data(), blocks.size() * sizeof(column_block)) &&
+         writeAt(f, header.summaryAt, summary.data(), summary.size() * sizeof(column_summary));
+  }
+
+  // Empty sections at the end are not written, the file still has to cover their offsets
+  stats->bytes = header.summaryAt + (size_t)header.blocks * sensors * sizeof(column_summary);
+  ok = ok && !fflush(f) && !ftruncate(fileno(f), (off_t)stats->bytes);
+  stats->rows = kept;
+  stats->events = events.size();
+  ok = !fclose(f) && ok;
+  if (!ok || rename(tmp.c_str(), path)) {
+    unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+void columnAggReset(column_agg *agg, uint16_t sensors) {
+  memset(agg, 0, sizeof(*agg));
+  agg->sensors = sensors;
+  for (uint16_t k = 0; k < COLUMN_SENSORS_MAX; k++) {
+    agg->min[k] = INT16_MAX;
+    agg->max[k] = INT16_MIN;
+  }
+}
+
+ColumnArchive::ColumnArchive() : _base(nullptr), _size(0), _header(nullptr) {}
+
+ColumnArchive::~ColumnArchive() {
+  close();
+}
+
+bool ColumnArchive::open(const char *path) {
+  struct stat st;
+  int fd = ::open(path, O_RDONLY);
+  void *base;
+
+  close();
+  if (fd < 0) {
+    return false;
+  }
+  if (fstat(fd, &st) || (size_t)st.st_size < sizeof(column_header)) {
+    ::close(fd);
+    return false;
+  }
+  base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (base == MAP_FAILED) {
+    return false;
+  }
+
+  _base = (const uint8_t *)base;
+  _size = st.st_size;
+  _header = (const column_header *)_base;
+
+  const column_header *h = _header;
+  uint64_t blocks = (h->rows + COLUMN_BLOCK_ROWS - 1) / COLUMN_BLOCK_ROWS;
+
+  if (memcmp(h->magic, COLUMN_MAGIC, sizeof(h->magic)) || h->version != COLUMN_FORMAT_VERSION ||
+      h->sensors > COLUMN_SENSORS_MAX || h->blockRows != COLUMN_BLOCK_ROWS || h->blocks != blocks ||
+      h->stampsAt + h->rows * sizeof(uint32_t) > _size || h->columnStride < h->rows * sizeof(int16_t) ||
+      h->columnsAt + h->sensors * h->columnStride > _size ||
+      h->eventsAt + h->events * sizeof(column_event) > _size || h->blocksAt + blocks * sizeof(column_block) > _size ||
+      h->summaryAt + blocks * h->sensors * sizeof(column_summary) > _size || (h->stampsAt | h->columnsAt | h->columnStride |
+      h->eventsAt | h->blocksAt | h->summaryAt) % 8) {
+    close();
+    return false;
+  }
+
+  _stamps = (const uint32_t *)(_base + h->stampsAt);
+  _events = (const column_event *)(_base + h->eventsAt);
+  _blocks = (const column_block *)(_base + h->blocksAt);
+  _summary = (const column_summary *)(_base + h->summaryAt);
+  madvise((void *)_base, _size, MADV_WILLNEED);
+  return true;
+}
+
+void ColumnArchive::close() {
+  if (_base) {
+    munmap((void *)_base, _size);
+  }
+  _base = nullptr;
+  _size = 0;
+  _header = nullptr;
+}
+
+// Block index first, so only one block of stamps is touched
+uint64_t ColumnArchive::lowerBound(uint32_t stamp) const {
+  const column_block *block = std::lower_bound(_blocks, _blocks + _header->blocks, stamp,
+                                               [](const column_block &b, uint32_t s) { return b.last < s; });
+  uint64_t from, to;
+
+  if (block == _blocks + _header->blocks) {
+    return _header->rows;
+  }
+  from = (uint64_t)(block - _blocks) * COLUMN_BLOCK_ROWS;
+  to = std::min(from + COLUMN_BLOCK_ROWS, _header->rows);
+  return std::lower_bound(_stamps + from, _stamps + to, stamp) - _stamps;
+}
+
+void ColumnArchive::aggregate(uint32_t from, uint32_t to, column_agg *out) const {
+  uint64_t rowFrom, rowTo, blockFrom, blockTo;
+
+  columnAggReset(out, _header->sensors);
+  if (from > to) {
+    return;
+  }
+  rowFrom = lowerBound(from);
+  rowTo = to == UINT32_MAX ? _header->rows : lowerBound(to + 1);
+  blockFrom = (rowFrom + COLUMN_BLOCK_ROWS - 1) / COLUMN_BLOCK_ROWS;
+  blockTo = rowTo / COLUMN_BLOCK_ROWS;
+
+  if (blockFrom >= blockTo) {
+    scan(rowFrom, rowTo, out);
+  } else {
+    scan(rowFrom, blockFrom * COLUMN_BLOCK_ROWS, out);
+    for (uint64_t b = blockFrom; b < blockTo; b++) {
+      addSummary((uint32_t)b, out);
+    }
+    scan(blockTo * COLUMN_BLOCK_ROWS, rowTo, out);
+  }
+  out->on = relayOnSec(from, to);
+}
+
+// Sums and extremes of n valid values of t. Masks instead of branches and a strip of fixed length, so GCC
+// vectorizes it at -O2 as well (its cheap cost model takes no loop that needs an epilogue)
+static inline void scanStrip(const int16_t *t, size_t n, int64_t *sumOut, uint32_t *countOut, int16_t *minOut,
+                             int16_t *maxOut) {
+  int32_t sum = 0, count = 0;
+  int16_t min = *minOut, max = *maxOut;
+
+  for (size_t i = 0; i < n; i++) {
+    int16_t v = t[i];
+    int16_t mask = -(int16_t)((v != COLUMN_MISSING) & (v != COLUMN_DISCONNECTED));
+    int16_t lo = (int16_t)((v & mask) | (INT16_MAX & ~mask));
+    int16_t hi = (int16_t)((v & mask) | (INT16_MIN & ~mask));
+
+    sum += (int16_t)(v & mask);
+    count -= mask;
+    min = lo < min ? lo : min;
+    max = hi > max ? hi : max;
+  }
+  *sumOut += sum;
+  *countOut += count;
+  *minOut = min;
+  *maxOut = max;
+}
+
+void ColumnArchive::scan(uint64_t rowFrom, uint64_t rowTo, column_agg *out) const {
+  if (rowTo <= rowFrom) {
+    return;
+  }
+  out->rows += rowTo - rowFrom;
+
+  for (uint16_t k = 0; k < _header->sensors; k++) {
+    const int16_t *t = column(k);
+    uint64_t i = rowFrom;
+
+    for (; i + COLUMN_SCAN_STRIP <= rowTo; i += COLUMN_SCAN_STRIP) {
+      scanStrip(t + i, COLUMN_SCAN_STRIP, &out->sum[k], &out->count[k], &out->min[k], &out->max[k]);
+    }
+    scanStrip(t + i, rowTo - i, &out->sum[k], &out->count[k], &out->min[k], &out->max[k]);
+  }
+}
+
+void ColumnArchive::addSummary(uint32_t block, column_agg *out) const {
+  const column_summary *s = _summary + (size_t)block * _header->sensors;
+  uint64_t first = (uint64_t)block * COLUMN_BLOCK_ROWS;
+
+  out->rows += std::min((uint64_t)COLUMN_BLOCK_ROWS, _header->rows - first);
+  for (uint16_t k = 0; k < _header->sensors; k++) {
+    out->count[k] += s[k].count;
+    out->sum[k] += s[k].sum;
+    out->min[k] = s[k].min < out->min[k] ? s[k].min : out->min[k];
+    out->max[k] = s[k].max > out->max[k] ? s[k].max : out->max[k];
+  }
+}
+
+uint32_t ColumnArchive::onUntil(uint32_t stamp) const {
+  const column_event *end = _events + _header->events;
+  const column_event *e = std::upper_bound(_events, end, stamp,
+                                           [](uint32_t s, const column_event &ev) { return s < ev.stamp; });
+
+  if (e == _events) {
+    return 0;
+  }
+  e--;
+  return e->onBefore + (e->kind == 'n' ? stamp - e->stamp : 0);
+}
+
+// History ends with the last reading or event, relay state is not known after it
+uint32_t ColumnArchive::relayOnSec(uint32_t from, uint32_t to) const {
+  uint32_t last = std::max(_header->rows ? _stamps[_header->rows - 1] : 0,
+                           _header->events ? _events[_header->events - 1].stamp : 0);
+
+  to = to < last ? to : last;
+  return to > from ? onUntil(to) - onUntil(from) : 0;
+}
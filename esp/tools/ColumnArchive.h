@@ -0,0 +1,155 @@
+/*
+  ColumnArchive.h - history pulled off controllers as a columnar file, read through mmap
+
+  Dumps are JSON arrays of `[stamp,t0,..,"ev"]` fragments: text era files,
+  localStorage exports and /data?f= replies, whose stamps are packed
+  YYMMDDhhmm (see packedDateFormat()). They are merged into one file:
+
+    header  : column_header
+    stamps  : u32[rows], ascending
+    columns : i16[rows] per sensor, sensor after sensor, COLUMN_MISSING where a row has no reading of it
+    events  : column_event[events], relay switches and boots in time order
+    blocks  : column_block[blocks], first and last stamp of every COLUMN_BLOCK_ROWS rows
+    summary : column_summary[blocks][sensors], min/max/sum/count of a block column
+
+  Every section starts at a multiple of 8 bytes, values are little-endian as
+  the host has them. Readings of the same stamp and values found in several
+  dumps are kept once; relay events are kept only when they change relay
+  state, so the runs of "off" the text era logged go. Range and aggregate
+  queries read the mapping only: stamps are found by the block index, whole
+  blocks are summed from their summary and the edges are scanned, relay time
+  is the difference of the running on-time at both ends.
+
+  Disconnected readings (-1270) are kept but left out of aggregates.
+*/
+
+#ifndef COLUMN_ARCHIVE_H
+#define COLUMN_ARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "LogFormat.h"
+
+#define COLUMN_MAGIC "THCA"
+#define COLUMN_FORMAT_VERSION 1
+#define COLUMN_BLOCK_ROWS 1024
+#define COLUMN_SENSORS_MAX MAX_SENSORS_COUNT
+#define COLUMN_MISSING INT16_MIN
+#define COLUMN_DISCONNECTED -1270
+#define COLUMN_PACKED_MIN 2001010000UL  // YYMMDDhhmm of 2020 and later; Unix stamps stay below it till 2033
+
+struct column_header {
+  char magic[4];
+  uint16_t version;
+  uint16_t sensors;
+  uint32_t blockRows;
+  uint32_t blocks;
+  uint64_t rows;
+  uint64_t events;
+  uint64_t stampsAt;  // offsets from the start of file
+  uint64_t columnsAt;
+  uint64_t columnStride;  // bytes from a column to the next one
+  uint64_t eventsAt;
+  uint64_t blocksAt;
+  uint64_t summaryAt;
+};
+
+struct column_event {
+  uint32_t stamp;
+  uint32_t onBefore;  // seconds relay was on from the first event to this one
+  char kind;          // 'n' relay on, 'f' off, 'b' boot (relay is off after it)
+  uint8_t reserved[3];
+};
+
+struct column_block {
+  uint32_t first;
+  uint32_t last;
+};
+
+struct column_summary {
+  int16_t min;
+  int16_t max;
+  uint32_t count;
+  int64_t sum;
+};
+
+// Row of a dump, event 't' for a plain reading
+struct dump_row {
+  uint32_t stamp;
+  char event;
+  uint8_t count;  // readings in t
+  int16_t t[COLUMN_SENSORS_MAX];
+};
+
+struct column_agg {
+  uint64_t rows;
+  uint16_t sensors;
+  uint32_t on;  // seconds relay was on
+  uint32_t count[COLUMN_SENSORS_MAX];
+  int64_t sum[COLUMN_SENSORS_MAX];
+  int16_t min[COLUMN_SENSORS_MAX];
+  int16_t max[COLUMN_SENSORS_MAX];
+};
+
+struct column_write_stats {
+  size_t rows;
+  size_t duplicates;  // readings dropped as found already
+  size_t events;
+  size_t repeated;    // relay events dropped as they did not change the state
+  size_t bytes;
+};
+
+// Unix time of YYMMDDhhmm formatted tzOffset seconds east of UTC, 0 if it is not a date
+uint32_t columnPackedToStamp(unsigned long packed, long tzOffset);
+// Rows of `[stamp,t0,..,"ev"]` fragments in text, appended to rows. Returns rows found
+size_t columnParseDump(const char *text, size_t len, long tzOffset, std::vector<dump_row> *rows);
+// Same of a file, 0 if it cannot be read
+size_t columnParseFile(const char *path, long tzOffset, std::vector<dump_row> *rows);
+
+// Sorts and merges rows into an archive at path, false on I/O error
+bool columnArchiveWrite(const char *path, std::vector<dump_row> *rows, column_write_stats *stats);
+
+class ColumnArchive {
+ public:
+  ColumnArchive();
+  ~ColumnArchive();
+
+  // Maps the file, false if it is not an archive or is cut short
+  bool open(const char *path);
+  void close();
+
+  uint64_t rows() const { return _header->rows; }
+  uint16_t sensors() const { return _header->sensors; }
+  uint64_t eventCount() const { return _header->events; }
+  const uint32_t *stamps() const { return _stamps; }
+  const int16_t *column(uint16_t k) const { return (const int16_t *)(_base + _header->columnsAt + k * _header->columnStride); }
+  const column_event *events() const { return _events; }
+
+  // First row at or after stamp, rows() if there is none
+  uint64_t lowerBound(uint32_t stamp) const;
+  // Readings and relay time of [from, to]
+  void aggregate(uint32_t from, uint32_t to, column_agg *out) const;
+  // Readings of rows [rowFrom, rowTo) added to out, row by row
+  void scan(uint64_t rowFrom, uint64_t rowTo, column_agg *out) const;
+  uint32_t relayOnSec(uint32_t from, uint32_t to) const;
+
+ protected:
+  void addSummary(uint32_t block, column_agg *out) const;
+  // Seconds relay was on from the first event to stamp
+  uint32_t onUntil(uint32_t stamp) const;
+
+  const uint8_t *_base;
+  size_t _size;
+  const column_header *_header;
+  const uint32_t *_stamps;
+  const column_event *_events;
+  const column_block *_blocks;
+  const column_summary *_summary;
+};
+
+void columnAggReset(column_agg *agg, uint16_t sensors);
+
+#endif
@@ -0,0 +1,228 @@
+/*
+  history.cpp - merges history dumps of controllers into a column archive and queries it
+
+    history [--tz=<sec>] ingest <archive> <dump files/dirs>...
+    history info <archive>
+    history [--tz=<sec>] range <archive> [from] [to]
+    history [--tz=<sec>] agg <archive> [from] [to] [points]
+
+  Times are Unix seconds or YYMMDDhhmm, the latter taken --tz seconds east of
+  UTC like packed stamps of dumps (firmware formats them in UTC unless TZ_SEC
+  is set). range prints readings and relay events in the dump format with Unix
+  stamps, so its output can be ingested again. agg prints up to `points`
+  buckets in the format of /data/agg (empty ones are skipped the same way),
+  bucket start as Unix seconds:
+    {"from":..,"step":..,"b":[[start,count,on share,min0,avg0,max0,...],...]}
+*/
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include "ColumnArchive.h"
+
+#define AGG_DEFAULT_POINTS 200
+
+static long tzOffset = 0;
+
+static int usage() {
+  fprintf(stderr,
+          "usage: history [--tz=<sec>] ingest <archive> <dump files/dirs>...\n"
+          "       history info <archive>\n"
+          "       history [--tz=<sec>] range <archive> [from] [to]\n"
+          "       history [--tz=<sec>] agg <archive> [from] [to] [points]\n");
+  return 2;
+}
+
+static void collect(const std::string &path, std::vector<std::string> *files) {
+  struct stat st;
+
+  if (stat(path.c_str(), &st) != 0) {
+    return;
+  }
+  if (S_ISDIR(st.st_mode)) {
+    DIR *dir = opendir(path.c_str());
+    struct dirent *entry;
+
+    while (dir && (entry = readdir(dir))) {
+      if (entry->d_name[0] != '.') {
+        collect(path + "/" + entry->d_name, files);
+      }
+    }
+    if (dir)
+      closedir(dir);
+  } else if (st.st_size > 0) {
+    files->push_back(path);
+  }
+}
+
+// Unix seconds or YYMMDDhhmm, false if it is neither
+static bool parseTime(const char *arg, uint32_t *out) {
+  char *end;
+  unsigned long value = strtoul(arg, &end, 10);
+
+  if (end == arg || *end || value > UINT32_MAX) {
+    return false;
+  }
+  *out = value >= COLUMN_PACKED_MIN ? columnPackedToStamp(value, tzOffset) : (uint32_t)value;
+  return *out || !value;
+}
+
+static bool parseRange(const ColumnArchive &archive, int argc, char **argv, uint32_t *from, uint32_t *to) {
+  *from = archive.rows() ? archive.stamps()[0] : 0;
+  *to = archive.rows() ? archive.stamps()[archive.rows() - 1] : 0;
+  if (archive.eventCount()) {
+    *from = archive.events()[0].stamp < *from || !archive.rows() ? archive.events()[0].stamp : *from;
+    *to = archive.events()[archive.eventCount() - 1].stamp > *to ? archive.events()[archive.eventCount() - 1].stamp : *to;
+  }
+  return (argc < 1 || parseTime(argv[0], from)) && (argc < 2 || parseTime(argv[1], to));
+}
+
+static int ingest(const char *path, int argc, char **argv) {
+  std::vector<std::string> files;
+  std::vector<dump_row> rows;
+  column_write_stats stats;
+
+  for (int i = 0; i < argc; i++) {
+    collect(argv[i], &files);
+  }
+  for (const std::string &file : files) {
+    if (!columnParseFile(file.c_str(), tzOffset, &rows)) {
+      fprintf(stderr, "%s: no records\n", file.c_str());
+    }
+  }
+  if (!columnArchiveWrite(path, &rows, &stats)) {
+    perror(path);
+    return 1;
+  }
+
+  printf("{\"files\":%zu,\"rows\":%zu,\"dup\":%zu,\"events\":%zu,\"repeated\":%zu,\"bytes\":%zu}\n", files.size(),
+         stats.rows, stats.duplicates, stats.events, stats.repeated, stats.bytes);
+  return 0;
+}
+
+static int info(const ColumnArchive &archive) {
+  uint32_t from, to;
+
+  parseRange(archive, 0, nullptr, &from, &to);
+  printf("{\"rows\":%llu,\"sensors\":%u,\"events\":%llu,\"from\":%u,\"to\":%u}\n", (unsigned long long)archive.rows(),
+         archive.sensors(), (unsigned long long)archive.eventCount(), from, to);
+  return 0;
+}
+
+// Readings and events of [from, to] merged by stamp, an event after the reading of its stamp
+static int range(const ColumnArchive &archive, uint32_t from, uint32_t to) {
+  const column_event *e = archive.events(), *end = e + archive.eventCount();
+  uint64_t row = archive.lowerBound(from);
+  bool first = true;
+
+  while (e < end && e->stamp < from) {
+    e++;
+  }
+
+  putchar('[');
+  while (true) {
+    bool hasRow = row < archive.rows() && archive.stamps()[row] <= to;
+    bool hasEvent = e < end && e->stamp <= to;
+
+    if (!hasRow && !hasEvent) {
+      break;
+    }
+    fputs(first ? "\n" : ",\n", stdout);
+    first = false;
+
+    if (hasRow && (!hasEvent || archive.stamps()[row] <= e->stamp)) {
+      printf("[%u", archive.stamps()[row]);
+      for (uint16_t k = 0; k < archive.sensors() && archive.column(k)[row] != COLUMN_MISSING; k++) {
+        printf(",%d", archive.column(k)[row]);
+      }
+      putchar(']');
+      row++;
+    } else {
+      printf("[%u,\"%s\"]", e->stamp, e->kind == 'n' ? "on" : e->kind == 'f' ? "off" : "st");
+      e++;
+    }
+  }
+  puts("\n]");
+  return 0;
+}
+
+// Step is the one LogAggregator takes for the same range
+static int agg(const ColumnArchive &archive, uint32_t from, uint32_t to, long points) {
+  uint32_t step = (to - from) / points + 1;
+  column_agg bucket;
+  bool first = true;
+
+  printf("{\"from\":%u,\"step\":%u,\"b\":[", from, step);
+  for (uint64_t start = from; start <= to; start += step) {
+    uint32_t end = (uint32_t)(start + step - 1 < to ? start + step - 1 : to);
+
+    archive.aggregate((uint32_t)start, end, &bucket);
+    if (!bucket.rows) {
+      continue;
+    }
+    printf("%s\n[%u,%llu,%.2f", first ? "" : ",", (uint32_t)start, (unsigned long long)bucket.rows,
+           (double)bucket.on / (end - start + 1));
+    first = false;
+    for (uint16_t k = 0; k < bucket.sensors; k++) {
+      if (bucket.count[k]) {
+        printf(",%d,%.0f,%d", bucket.min[k], (double)bucket.sum[k] / bucket.count[k], bucket.max[k]);
+      } else {
+        fputs(",null,null,null", stdout);
+      }
+    }
+    putchar(']');
+  }
+  puts("\n]}");
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  ColumnArchive archive;
+  uint32_t from, to;
+  int i = 1;
+
+  for (; i < argc && !strncmp(argv[i], "--", 2); i++) {
+    if (!strncmp(argv[i], "--tz=", 5)) {
+      tzOffset = strtol(argv[i] + 5, nullptr, 10);
+    } else {
+      return usage();
+    }
+  }
+  if (argc - i < 2) {
+    return usage();
+  }
+
+  const char *command = argv[i], *path = argv[i + 1];
+
+  argc -= i + 2;
+  argv += i + 2;
+  if (!strcmp(command, "ingest")) {
+    return argc > 0 ? ingest(path, argc, argv) : usage();
+  }
+
+  if (!archive.open(path)) {
+    fprintf(stderr, "%s: not a history archive\n", path);
+    return 1;
+  }
+  if (!strcmp(command, "info")) {
+    return info(archive);
+  }
+  if (!parseRange(archive, argc, argv, &from, &to) || from > to) {
+    return usage();
+  }
+  if (!strcmp(command, "range")) {
+    return range(archive, from, to);
+  }
+  if (!strcmp(command, "agg")) {
+    long points = argc > 2 ? strtol(argv[2], nullptr, 10) : AGG_DEFAULT_POINTS;
+
+    return points > 0 ? agg(archive, from, to, points) : usage();
+  }
+  return usage();
+}
@@ -8,7 +8,7 @@ import * as duration                                    from "dayjs/plugin/durat
 import * as utc                                         from "dayjs/plugin/utc"
 import * as customParseFormat                           from "dayjs/plugin/customParseFormat"
 import { StatDonut }                                    from "./parts/DonutChart"
-import { FileSystem, FileModel, FilesList }             from "./parts/Files"
+import { FileSystem, FileModel, FilesList, loadFiles }  from "./parts/Files"
 import {
     onServerIpChange, getServerIp, ESPfetch,
     myHumanizer, downloadFile,
@@ -558,7 +558,7 @@ class Application extends React.Component {
             const lastLocalDataRecord = this.state.localData.last();
             const latestStampInLs     = lastLocalDataRecord ? lastLocalDataRecord.stamp : 0;
 
-            this.loadFileData( null, latestStampInLs );
+            this.loadNewFiles( latestStampInLs );
         } )
     };
 
@@ -589,6 +589,34 @@ class Application extends React.Component {
         alert( msg );
     }
 
+    // Files which may have records newer than local ones, in one request. The newest file which starts
+    // before them is the last one needed. Files of old names, or more than the controller batches (64), go one by one
+    loadNewFiles = latestStampInLs => {
+        const files = this.state.files.models;
+        const since = latestStampInLs ? parseInt( dayjs( latestStampInLs * 1000 ).format( "YYMMDD" ) ) : 0;
+        let first   = files.length - 1;
+
+        while( first > 0 && !(parseInt( files[ first ].n ) <= since) ) {
+            first--;
+        }
+
+        const batch = files.slice( first );
+
+        if( batch.length < 2 || batch.length > 64 || !_.every( batch, file => /^\d{6}(_\d+)?$/.test( file.n ) ) ) {
+            this.loadFileData( null, latestStampInLs );
+            return;
+        }
+
+        this.state.loadingTxt = batch.length + " files from controller...";
+
+        loadFiles( batch ).then( data => {
+            this.state.localData.add( _.map( _.flatten( data, true ), item => new FileLogRawLine( item, { parse : true } ) ) );
+            this.setChartExtremes();
+            this.chartFillWithData();
+            this.state.loadingTxt = "";
+        } ).catch( () => this.loadFileData( null, latestStampInLs ) );
+    };
+
     loadFileData = ( file = null, latestStampInLs ) => {
         const fileToLoad   = file || this.state.files.last();
         const onDataLoaded = () => {
@@ -66,6 +66,17 @@ export class FileModel extends Record {
     }
 }
 
+// Files in one /data?f=a,b,c reply, data of each in the same order. Rejects when the controller
+// does not batch files, they are loaded one by one then
+export const loadFiles = files =>
+    fetchAttempts( () => ESPfetch( "/data", { f : files.map( file => file.n ).join( "," ) } ), 5 )
+        .then( frames => {
+            if( !_.isArray( frames ) || frames.length !== files.length || !_.every( frames, frame => frame && frame.d ) ) {
+                throw new Error( "Files are not batched" );
+            }
+            return frames.map( frame => frame.d );
+        } );
+
 export const FilesList = ( { files } ) => <div className='files-list-box'>{
     files.map( file => {
             const sizeKb = Math.round( file.s * 10 / 1024 ) / 10 + "Kb";